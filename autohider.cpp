@@ -0,0 +1,65 @@
+#include "autohider.h"
+#include "fadecontroller.h"
+#include "foregroundwatcher.h"
+#include "metrics.h"
+
+#include <QDebug>
+
+AutoHider::AutoHider(ForegroundWatcher *watcher, FadeController *fader, std::function<bool()> canRestore,
+                     QObject *parent)
+    : QObject(parent)
+    , watcher(watcher)
+    , fader(fader)
+    , canRestore(std::move(canRestore))
+{
+    connect(watcher, &ForegroundWatcher::presentationChanged, this, &AutoHider::onPresentationChanged);
+    connect(watcher, &ForegroundWatcher::fullscreenChanged, this, &AutoHider::onFullscreenChanged);
+}
+
+void AutoHider::reset()
+{
+    hiddenByPresentation = false;
+    hiddenByFullscreen = false;
+}
+
+void AutoHider::recheck()
+{
+    onFullscreenChanged(watcher->isFullscreen());
+}
+
+// PowerPoint放映开始/结束
+void AutoHider::onPresentationChanged(bool showing)
+{
+    if (showing && fader->isShown()) {
+        // PPT正在放映，淡出后隐藏窗口
+        fader->fadeOut(1500); // 动画持续1.5秒
+        hiddenByPresentation = true;
+        Metrics::increment(Metrics::PresentationHides);
+        qDebug() << "检测到PowerPoint放映，隐藏窗口";
+    }
+    else if (!showing && hiddenByPresentation && !fader->isShown() && canRestore()) {
+        // PPT放映结束，淡入显示窗口
+        emit aboutToShow();
+        fader->fadeIn(1500); // 动画持续1.5秒
+        hiddenByPresentation = false;
+        Metrics::increment(Metrics::PresentationShows);
+        qDebug() << "PowerPoint放映结束，显示窗口";
+    }
+}
+
+void AutoHider::onFullscreenChanged(bool fullscreen)
+{
+    // 如果有全屏应用且当前窗口可见，则隐藏
+    if (fullscreen && fader->isShown()) {
+        fader->fadeOut(300);
+        hiddenByFullscreen = true;
+        Metrics::increment(Metrics::FullscreenHides);
+    }
+    // 如果没有全屏应用且之前是因为全屏被隐藏的，则显示
+    else if (!fullscreen && hiddenByFullscreen && !fader->isShown() && canRestore()) {
+        emit aboutToShow();
+        fader->fadeIn(300);
+        hiddenByFullscreen = false;
+        Metrics::increment(Metrics::FullscreenShows);
+    }
+}
@@ -0,0 +1,45 @@
+#ifndef AUTOHIDER_H
+#define AUTOHIDER_H
+
+#include <QObject>
+#include <functional>
+
+class FadeController;
+class ForegroundWatcher;
+
+// 放映和全屏时自动淡出窗口，结束后只恢复由它隐藏的窗口。
+// 主窗口和单元测试共用，测试时换成FakeForegroundWatcher
+class AutoHider : public QObject
+{
+    Q_OBJECT
+
+public:
+    // canRestore返回false时（考试模式）放映或全屏结束后不恢复显示
+    AutoHider(ForegroundWatcher *watcher, FadeController *fader, std::function<bool()> canRestore,
+              QObject *parent = nullptr);
+
+    bool isHiddenByPresentation() const { return hiddenByPresentation; }
+    bool isHiddenByFullscreen() const { return hiddenByFullscreen; }
+    bool isAutoHidden() const { return hiddenByPresentation || hiddenByFullscreen; }
+
+    // 切换考试模式或重新决定窗口是否显示后调用，之前自动隐藏的窗口不再自动恢复
+    void reset();
+    // 窗口刚显示时按监视器当前的状态处理一次
+    void recheck();
+
+signals:
+    // 即将淡入显示，窗口可以先调整位置
+    void aboutToShow();
+
+private:
+    void onPresentationChanged(bool showing);
+    void onFullscreenChanged(bool fullscreen);
+
+    ForegroundWatcher *watcher;
+    FadeController *fader;
+    std::function<bool()> canRestore;
+    bool hiddenByPresentation = false;
+    bool hiddenByFullscreen = false;
+};
+
+#endif // AUTOHIDER_H
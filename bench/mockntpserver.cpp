@@ -0,0 +1,98 @@
+#include "mockntpserver.h"
+#include "ntpclient.h"
+
+#include <QDateTime>
+#include <QTimer>
+#include <QUdpSocket>
+#include <QtEndian>
+#include <algorithm>
+
+MockNtpServer::MockNtpServer(QObject *parent)
+    : QObject(parent)
+    , random(QRandomGenerator::global()->generate())
+{
+    wallBaseUs = QDateTime::currentMSecsSinceEpoch() * 1000;
+    clock.start();
+}
+
+bool MockNtpServer::start()
+{
+    socket = new QUdpSocket(this);
+    if (!socket->bind(QHostAddress(QHostAddress::LocalHost), 0))
+        return false;
+    connect(socket, &QUdpSocket::readyRead, this, &MockNtpServer::onReadyRead);
+    return true;
+}
+
+quint16 MockNtpServer::port() const
+{
+    return socket ? socket->localPort() : 0;
+}
+
+QString MockNtpServer::address() const
+{
+    return QStringLiteral("127.0.0.1:%1").arg(port());
+}
+
+void MockNtpServer::onReadyRead()
+{
+    while (socket->hasPendingDatagrams()) {
+        QByteArray request(int(qMax<qint64>(socket->pendingDatagramSize(), 0)), '\0');
+        QHostAddress peer;
+        quint16 peerPort = 0;
+        socket->readDatagram(request.data(), request.size(), &peer, &peerPort);
+        ++requests;
+        if (random.generateDouble() < behavior.loss)
+            continue;
+
+        // 请求实际上刚到，按注入的延迟推迟“到达”和发出应答的时刻
+        const int inbound = behavior.inboundMs + (behavior.jitterMs ? int(random.bounded(behavior.jitterMs + 1)) : 0);
+        const int outbound = behavior.outboundMs + (behavior.jitterMs ? int(random.bounded(behavior.jitterMs + 1)) : 0);
+        const qint64 arrivedUs = nowUs() + qint64(inbound) * 1000;
+        QTimer::singleShot(inbound + outbound, Qt::PreciseTimer, this, [this, request, peer, peerPort, arrivedUs, outbound]() {
+            reply(request, peer, peerPort, arrivedUs, outbound);
+        });
+    }
+}
+
+void MockNtpServer::reply(const QByteArray &request, const QHostAddress &peer, quint16 peerPort, qint64 arrivedUs, int outboundMs)
+{
+    if (request.size() < 48)
+        return;
+
+    QByteArray packet(48, '\0');
+    const bool kiss = !behavior.kissCode.isEmpty();
+    packet[0] = char((behavior.leap & 0x03) << 6 | 4 << 3 | (behavior.mode & 0x07));
+    packet[1] = char(kiss ? 0 : behavior.stratum);
+    packet[2] = 4;                 // 轮询间隔 2^4 秒
+    packet[3] = char(-20);         // 精度约1微秒
+    qToBigEndian<quint32>(0x00000100, packet.data() + 4);  // 根延迟 1/256 秒
+    qToBigEndian<quint32>(0x00000100, packet.data() + 8);  // 根离散
+    if (kiss)
+        std::copy_n(behavior.kissCode.leftJustified(4, '\0', true).constData(), 4, packet.data() + 12);
+    else
+        std::copy_n("LOCL", 4, packet.data() + 12);
+
+    const qint64 offsetUs = behavior.clockOffsetMs * 1000;
+    const qint64 receiveUs = arrivedUs + offsetUs;
+    // 应答还要在路上走outboundMs，定时器晚到的时间算作服务器的处理时间
+    const qint64 transmitUs = nowUs() - qint64(outboundMs) * 1000 + offsetUs;
+    quint64 origin = qFromBigEndian<quint64>(request.constData() + 40);
+    if (behavior.wrongOrigin)
+        origin ^= 0x0000000100000000ULL;
+    qToBigEndian<quint64>(NtpClient::toNtpTimestamp(receiveUs - 1000000), packet.data() + 16);  // 参考时间
+    qToBigEndian<quint64>(origin, packet.data() + 24);
+    qToBigEndian<quint64>(NtpClient::toNtpTimestamp(receiveUs), packet.data() + 32);
+    const quint64 transmit = behavior.zeroTransmit ? 0
+                                                   : NtpClient::toNtpTimestamp(qMax(receiveUs, transmitUs) + behavior.transmitSkewMs * 1000);
+    qToBigEndian<quint64>(transmit, packet.data() + 40);
+
+    if (behavior.truncateTo > 0)
+        packet.truncate(behavior.truncateTo);
+    socket->writeDatagram(packet, peer, peerPort);
+}
+
+qint64 MockNtpServer::nowUs() const
+{
+    return wallBaseUs + clock.nsecsElapsed() / 1000;
+}
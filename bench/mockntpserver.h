@@ -0,0 +1,59 @@
+#ifndef MOCKNTPSERVER_H
+#define MOCKNTPSERVER_H
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QHostAddress>
+#include <QObject>
+#include <QRandomGenerator>
+
+class QUdpSocket;
+
+// 只监听127.0.0.1的SNTP应答器，用来在没有网络时测试NtpClient。
+// 可以模拟两个方向的网络延迟、抖动和丢包，以及截断、错误模式、错误时间戳和Kiss-o'-Death等坏应答
+class MockNtpServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Behavior {
+        int inboundMs = 1;          // 请求在路上的时间
+        int outboundMs = 1;         // 应答在路上的时间
+        int jitterMs = 0;           // 每个方向再加上0..jitterMs的随机延迟
+        double loss = 0;            // 丢弃请求的概率
+        qint64 clockOffsetMs = 0;   // 服务器时钟比本机快多少
+        int stratum = 2;
+        int leap = 0;
+        int mode = 4;
+        int truncateTo = 0;         // 大于0时只发送前这么多字节
+        QByteArray kissCode;        // 非空时以stratum 0回复这个代码
+        bool wrongOrigin = false;   // originate字段不是请求的发送时间戳
+        bool zeroTransmit = false;
+        qint64 transmitSkewMs = 0;  // 只有发送时间戳加上这个偏差，模拟时间戳错误的服务器
+    };
+
+    explicit MockNtpServer(QObject *parent = nullptr);
+
+    // 绑定到127.0.0.1的随机端口
+    bool start();
+    quint16 port() const;
+    // NtpClient::setServers可以直接使用的地址
+    QString address() const;
+
+    void setBehavior(const Behavior &behavior) { this->behavior = behavior; }
+    int requestCount() const { return requests; }
+
+private:
+    void onReadyRead();
+    void reply(const QByteArray &request, const QHostAddress &peer, quint16 peerPort, qint64 arrivedUs, int outboundMs);
+    qint64 nowUs() const;
+
+    QUdpSocket *socket = nullptr;
+    Behavior behavior;
+    QElapsedTimer clock;
+    qint64 wallBaseUs = 0;
+    QRandomGenerator random;
+    int requests = 0;
+};
+
+#endif // MOCKNTPSERVER_H
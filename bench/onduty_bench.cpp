@@ -0,0 +1,667 @@
+// 基准测试：配置读写、状态日志、轮换计算、日历、名单、NTP报文解析、任务调度、局域网同步和显示控件的更新开销，
+// 以及任务调度器合并唤醒的效果、NTP客户端在本机模拟的各种坏网络和坏服务器下的表现。
+// 默认在offscreen平台下运行，结果以JSON输出，便于在版本之间比较
+#include "configstore.h"
+#include "dutystate.h"
+#include "dutyhistory.h"
+#include "dutyplanner.h"
+#include "dutyview.h"
+#include "mockntpserver.h"
+#include "ntpclient.h"
+#include "peersync.h"
+#include "roster.h"
+#include "rotationengine.h"
+#include "statejournal.h"
+#include "taskscheduler.h"
+#include "workcalendar.h"
+
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QHBoxLayout>
+#include <QImage>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLabel>
+#include <QLoggingCategory>
+#include <QRandomGenerator>
+#include <QTemporaryDir>
+#include <QVBoxLayout>
+#include <QtEndian>
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+
+namespace {
+volatile qint64 sink = 0;  // 防止被测代码被优化掉
+
+struct Result {
+    QString name;
+    qint64 iterations;
+    double medianNs;
+    double minNs;
+};
+
+class Bench
+{
+public:
+    Bench(double minTimeMs, const QString &filter)
+        : minTimeNs(minTimeMs * 1e6)
+        , filter(filter)
+    {
+    }
+
+    // 准备工作比较重的测试先用它判断是否会运行
+    bool selected(const QString &name) const { return filter.isEmpty() || name.contains(filter); }
+
+    // op(i)返回任意整数，累加进sink
+    template <typename Op>
+    void run(const QString &name, Op &&op)
+    {
+        if (!selected(name))
+            return;
+
+        // 先找到一批耗时约为总时间十分之一的次数，再取7批的中位数和最小值
+        qint64 batch = 1;
+        for (;;) {
+            const qint64 ns = runBatch(op, batch);
+            if (ns >= minTimeNs / 10 || batch >= (qint64(1) << 30))
+                break;
+            batch *= 2;
+        }
+        QVector<double> samples;
+        for (int i = 0; i < 7; ++i)
+            samples.append(double(runBatch(op, batch)) / batch);
+        std::sort(samples.begin(), samples.end());
+
+        results.append({ name, batch * samples.size(), samples[samples.size() / 2], samples.first() });
+        std::fprintf(stderr, "%-36s %12.1f ns/op\n", qPrintable(name), samples[samples.size() / 2]);
+    }
+
+    QJsonArray toJson() const
+    {
+        QJsonArray array;
+        for (const Result &result : results) {
+            QJsonObject object;
+            object["name"] = result.name;
+            object["iterations"] = result.iterations;
+            object["nsPerOp"] = result.medianNs;
+            object["minNsPerOp"] = result.minNs;
+            array.append(object);
+        }
+        return array;
+    }
+
+private:
+    template <typename Op>
+    qint64 runBatch(Op &op, qint64 count)
+    {
+        qint64 accumulator = 0;
+        QElapsedTimer timer;
+        timer.start();
+        for (qint64 i = 0; i < count; ++i)
+            accumulator += qint64(op(i));
+        const qint64 ns = timer.nsecsElapsed();
+        sink = sink + accumulator;
+        return ns;
+    }
+
+    double minTimeNs;
+    QString filter;
+    QVector<Result> results;
+};
+
+QMap<QString, QString> sampleConfig()
+{
+    QMap<QString, QString> values;
+    values["date/lastUpdate"] = "20251009";
+    values["duty/index1"] = "12";
+    values["duty/index2"] = "13";
+    values["journal/seq"] = "1234";
+    values["rotation/anchorDate"] = "20251009";
+    values["rotation/anchorIndex1"] = "12";
+    values["rotation/anchorIndex2"] = "13";
+    values["rotation/offset"] = "-2";
+    values["rotation/originOffset"] = "0";
+    values["settings/holidayFile"] = "holidays.txt";
+    values["settings/rosterFile"] = "roster.csv";
+    values["settings/startupLaunch"] = "true";
+    values["settings/testingMode"] = "false";
+    values["settings/totalPersons"] = "47";
+    values["time/lastSync"] = "2025-10-09T07:30:00";
+    values["time/offsetMs"] = "-153";
+    values["time/resyncMinutes"] = "360";
+    return values;
+}
+
+QByteArray sampleRoster(int persons)
+{
+    static const char *const surnames[] = { "张", "王", "李", "赵", "刘", "陈", "杨", "黄" };
+    static const char *const givenNames[] = { "伟", "芳", "娜", "敏", "静", "磊", "洋", "艳", "勇", "军" };
+    QByteArray csv = "姓名,学号,分组\n";
+    for (int i = 0; i < persons; ++i) {
+        csv += surnames[i % 8];
+        csv += givenNames[(i / 8) % 10];
+        csv += givenNames[i % 10];
+        csv += ',' + QByteArray::number(20250000 + i) + ',' + QByteArray::number(i % 6 + 1) + '\n';
+    }
+    return csv;
+}
+
+// 请求的发送时间戳，sampleNtpResponse的应答与它对应
+const qint64 kSampleRequestUs = QDateTime(QDate(2025, 10, 9), QTime(7, 30), Qt::UTC).toMSecsSinceEpoch() * 1000;
+
+QByteArray sampleNtpResponse()
+{
+    QByteArray packet(48, '\0');
+    packet[0] = char(0x24);  // LI=0, VN=4, 模式4（服务器）
+    packet[1] = 2;
+    qToBigEndian(NtpClient::toNtpTimestamp(kSampleRequestUs), packet.data() + 24);
+    qToBigEndian(NtpClient::toNtpTimestamp(kSampleRequestUs + 20150), packet.data() + 32);
+    qToBigEndian(NtpClient::toNtpTimestamp(kSampleRequestUs + 20180), packet.data() + 40);
+    return packet;
+}
+
+// 处理事件直到条件满足，超时返回false
+bool waitUntil(const std::function<bool()> &done, int timeoutMs)
+{
+    QElapsedTimer timer;
+    timer.start();
+    while (!done()) {
+        if (timer.elapsed() > timeoutMs)
+            return false;
+        QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+    }
+    return true;
+}
+
+// 同一进程内的几个同步节点，各自有一份DutyState，通过组播回环通信
+void benchPeerSync(Bench &bench, const QString &interfaceName)
+{
+    if (!bench.selected("peer/"))
+        return;
+
+    PeerSync::Settings settings;
+    settings.room = QStringLiteral("bench-%1").arg(QCoreApplication::applicationPid());
+    settings.port = quint16(40000 + QRandomGenerator::global()->bounded(20000));
+    settings.interfaceName = interfaceName;
+    settings.beaconInterval = 100;
+
+    const int nodeCount = 3;
+    DutyState states[nodeCount];
+    QVector<PeerSync *> peers;
+    for (DutyState &state : states) {
+        peers.append(new PeerSync(&state, nullptr, settings));
+        if (!peers.last()->start()) {
+            std::fprintf(stderr, "peer/*: skipped, multicast is not available\n");
+            qDeleteAll(peers);
+            return;
+        }
+    }
+
+    const auto authorityCount = [&peers]() {
+        return std::count_if(peers.begin(), peers.end(), [](PeerSync *peer) { return peer->isAuthority(); });
+    };
+    const auto converged = [&states, &peers](qint64 offset) {
+        for (int i = 0; i < nodeCount; ++i) {
+            if (states[i].field(StateJournal::ManualOffset) != offset || peers[i]->stateVersion() != peers[0]->stateVersion())
+                return false;
+        }
+        return true;
+    };
+    if (!waitUntil([&]() { return authorityCount() == 1 && converged(states[0].field(StateJournal::ManualOffset)); }, 5000)) {
+        std::fprintf(stderr, "peer/*: skipped, nodes did not elect an authority\n");
+        qDeleteAll(peers);
+        return;
+    }
+    const int authority = int(std::find_if(peers.begin(), peers.end(), [](PeerSync *peer) { return peer->isAuthority(); }) - peers.begin());
+    const int follower = (authority + 1) % nodeCount;
+
+    // 每次写入一个新的步数，直到所有节点都收到为止
+    qint32 offset = 0;
+    int timeouts = 0;
+    const auto changeAndWait = [&](int node) {
+        states[node].active().manualOffset = ++offset;
+        peers[node]->publish();
+        if (!waitUntil([&]() { return converged(offset); }, 1000))
+            ++timeouts;
+        return 1;
+    };
+    bench.run("peer/authority-change-converge-3", [&](qint64) { return changeAndWait(authority); });
+    bench.run("peer/follower-change-converge-3", [&](qint64) { return changeAndWait(follower); });
+    if (timeouts)
+        std::fprintf(stderr, "peer/*: %d changes did not converge within 1s\n", timeouts);
+    qDeleteAll(peers);
+}
+
+// 几个周期不同的任务运行一段时间，比较任务运行次数和调度器的真实唤醒次数
+QJsonObject benchSchedulerCoalescing(Bench &bench, int slackMs)
+{
+    QJsonObject report;
+    if (!bench.selected("scheduler/coalescing"))
+        return report;
+
+    TaskScheduler scheduler;
+    const int periods[] = { 50, 70, 110, 130, 170 };
+    QVector<ScheduledTask *> tasks;
+    int runs = 0;
+    for (int period : periods) {
+        ScheduledTask *task = new ScheduledTask("bench", slackMs, &scheduler, &scheduler);
+        QObject::connect(task, &ScheduledTask::timeout, [&runs]() { ++runs; });
+        task->start(period);
+        tasks.append(task);
+    }
+    QElapsedTimer timer;
+    timer.start();
+    waitUntil([&timer]() { return timer.elapsed() >= 2000; }, 3000);
+    qDeleteAll(tasks);
+
+    report["name"] = QStringLiteral("scheduler/coalescing-slack-%1ms").arg(slackMs);
+    report["taskRuns"] = runs;
+    report["wakeups"] = qint64(scheduler.wakeups());
+    report["wakeupsPerHour"] = scheduler.wakeupsPerHour();
+    std::fprintf(stderr, "%-36s %5d runs, %5lld wakeups\n", qPrintable(report["name"].toString()), runs, qlonglong(scheduler.wakeups()));
+    return report;
+}
+
+// 一个NTP场景：几个本机应答器各自的行为
+struct NtpScenario {
+    const char *name;
+    QVector<MockNtpServer::Behavior> servers;
+};
+
+// 正常服务器的时钟都比本机快这么多，准确度以此为准
+const qint64 kMockClockOffsetMs = 1500;
+
+MockNtpServer::Behavior mockBehavior(int inboundMs, int outboundMs,
+                                     const std::function<void(MockNtpServer::Behavior &)> &change = {})
+{
+    MockNtpServer::Behavior behavior;
+    behavior.inboundMs = inboundMs;
+    behavior.outboundMs = outboundMs;
+    behavior.clockOffsetMs = kMockClockOffsetMs;
+    if (change)
+        change(behavior);
+    return behavior;
+}
+
+double percentile(QVector<double> values, double p)
+{
+    if (values.isEmpty())
+        return -1;
+    std::sort(values.begin(), values.end());
+    return values[qMin(int(values.size() * p), int(values.size()) - 1)];
+}
+
+// 每个场景用新的NtpClient查询runs次，记录成功时从开始查询到得到日期的时间和偏差的误差。
+// 应答器和客户端各自以毫秒精度的系统时间为基准，误差中包含不到1毫秒的基准差
+QJsonArray benchNtpScenarios(Bench &bench, int runs, int timeoutMs)
+{
+    QJsonArray report;
+    const qint64 yearMs = 365LL * 24 * 3600 * 1000;
+    const NtpScenario scenarios[] = {
+        { "clean", { mockBehavior(1, 1), mockBehavior(2, 2), mockBehavior(3, 3) } },
+        // 非对称延迟的误差是两个方向之差的一半，应选延迟最小的服务器
+        { "asymmetric-latency", { mockBehavior(5, 45), mockBehavior(10, 10), mockBehavior(30, 30) } },
+        { "jitter-loss-30", { mockBehavior(10, 10, [](MockNtpServer::Behavior &b) { b.jitterMs = 20; b.loss = 0.3; }),
+                              mockBehavior(10, 10, [](MockNtpServer::Behavior &b) { b.jitterMs = 20; b.loss = 0.3; }),
+                              mockBehavior(10, 10, [](MockNtpServer::Behavior &b) { b.jitterMs = 20; b.loss = 0.3; }) } },
+        { "truncated-wrong-mode", { mockBehavior(1, 1, [](MockNtpServer::Behavior &b) { b.truncateTo = 40; }),
+                                    mockBehavior(1, 1, [](MockNtpServer::Behavior &b) { b.mode = 5; }),
+                                    mockBehavior(15, 15) } },
+        { "kiss-of-death", { mockBehavior(1, 1, [](MockNtpServer::Behavior &b) { b.kissCode = "RATE"; }),
+                             mockBehavior(1, 1, [](MockNtpServer::Behavior &b) { b.kissCode = "DENY"; }),
+                             mockBehavior(20, 20) } },
+        { "unsynchronized", { mockBehavior(1, 1, [](MockNtpServer::Behavior &b) { b.leap = 3; }),
+                              mockBehavior(1, 1, [](MockNtpServer::Behavior &b) { b.stratum = 16; }),
+                              mockBehavior(25, 25) } },
+        // 时间戳错了一年的服务器最快，靠偏差的中位数排除
+        { "bogus-timestamps", { mockBehavior(1, 1, [yearMs](MockNtpServer::Behavior &b) { b.transmitSkewMs = yearMs; }),
+                                mockBehavior(1, 1, [](MockNtpServer::Behavior &b) { b.zeroTransmit = true; }),
+                                mockBehavior(1, 1, [](MockNtpServer::Behavior &b) { b.wrongOrigin = true; }),
+                                mockBehavior(5, 5), mockBehavior(8, 8) } },
+        { "all-lost", { mockBehavior(1, 1, [](MockNtpServer::Behavior &b) { b.loss = 1; }),
+                        mockBehavior(1, 1, [](MockNtpServer::Behavior &b) { b.loss = 1; }) } },
+    };
+
+    for (const NtpScenario &scenario : scenarios) {
+        const QString name = QStringLiteral("ntp-scenario/") + QLatin1String(scenario.name);
+        if (!bench.selected(name))
+            continue;
+
+        QVector<MockNtpServer *> servers;
+        QStringList addresses;
+        for (const MockNtpServer::Behavior &behavior : scenario.servers) {
+            MockNtpServer *server = new MockNtpServer;
+            servers.append(server);
+            if (!server->start())
+                break;
+            server->setBehavior(behavior);
+            addresses.append(server->address());
+        }
+        if (addresses.size() != servers.size()) {
+            std::fprintf(stderr, "%s: skipped, cannot bind to 127.0.0.1\n", qPrintable(name));
+            qDeleteAll(servers);
+            continue;
+        }
+
+        QVector<double> firstDateMs;
+        QVector<double> errorMs;
+        for (int run = 0; run < runs; ++run) {
+            NtpClient client;
+            client.setServers(addresses);
+            bool done = false;
+            bool succeeded = false;
+            QObject::connect(&client, &NtpClient::finished, [&]() { done = succeeded = true; });
+            QObject::connect(&client, &NtpClient::failed, [&]() { done = true; });
+            QElapsedTimer timer;
+            timer.start();
+            client.query(timeoutMs);
+            waitUntil([&]() { return done; }, timeoutMs + 1000);
+            if (!succeeded)
+                continue;
+            firstDateMs.append(timer.nsecsElapsed() / 1e6);
+            errorMs.append(qAbs(client.lastSample().offsetUs - kMockClockOffsetMs * 1000) / 1000.0);
+        }
+        qDeleteAll(servers);
+
+        QJsonObject object;
+        object["name"] = name;
+        object["servers"] = int(addresses.size());
+        object["runs"] = runs;
+        object["successes"] = int(errorMs.size());
+        object["firstDateMsMedian"] = percentile(firstDateMs, 0.5);
+        object["firstDateMsP90"] = percentile(firstDateMs, 0.9);
+        object["errorMsMedian"] = percentile(errorMs, 0.5);
+        object["errorMsMax"] = percentile(errorMs, 1.0);
+        report.append(object);
+        std::fprintf(stderr, "%-36s %3lld/%-3d ok, first date %7.1f ms, error %6.2f ms (max %6.2f)\n", qPrintable(name),
+                     qlonglong(errorMs.size()), runs, percentile(firstDateMs, 0.5), percentile(errorMs, 0.5), percentile(errorMs, 1.0));
+    }
+    return report;
+}
+
+// 原来的显示控件：样式表背景加三个QLabel和嵌套布局
+QWidget *createLegacyWidget(QLabel **first, QLabel **second)
+{
+    QWidget *window = new QWidget;
+    window->setAttribute(Qt::WA_TranslucentBackground);
+    QWidget *mainWidget = new QWidget(window);
+    mainWidget->setStyleSheet("background-color: rgba(255, 255, 255, 200); border-radius: 10px; border: 2px solid #dddddd;");
+    QVBoxLayout *mainLayout = new QVBoxLayout(mainWidget);
+    QVBoxLayout *outerLayout = new QVBoxLayout(window);
+    outerLayout->addWidget(mainWidget);
+    outerLayout->setContentsMargins(5, 5, 5, 5);
+
+    QHBoxLayout *titleLayout = new QHBoxLayout();
+    QLabel *titleLabel = new QLabel("值日安排");
+    titleLabel->setStyleSheet("min-width: 60px;border: none;font-size: 14pt;background: none;");
+    titleLayout->addWidget(titleLabel);
+    titleLayout->addStretch();
+    mainLayout->addLayout(titleLayout);
+
+    QHBoxLayout *dutyLayout = new QHBoxLayout();
+    *first = new QLabel();
+    *second = new QLabel();
+    QFont dutyFont = (*first)->font();
+    dutyFont.setPointSize(18);
+    dutyFont.setBold(true);
+    (*first)->setFont(dutyFont);
+    (*second)->setFont(dutyFont);
+    (*first)->setAlignment(Qt::AlignCenter);
+    (*second)->setAlignment(Qt::AlignCenter);
+    QLabel *andLabel = new QLabel("&");
+    andLabel->setStyleSheet("max-width: 15px;border: none;font-size: 12pt;font-weight: bold;background: none;");
+    dutyLayout->addWidget(*first);
+    dutyLayout->addWidget(andLabel);
+    dutyLayout->addWidget(*second);
+    mainLayout->addLayout(dutyLayout);
+
+    window->setFixedSize(240, 140);
+    window->ensurePolished();
+    outerLayout->activate();
+    return window;
+}
+}
+
+int main(int argc, char *argv[])
+{
+    // 没有指定平台时使用offscreen，不需要显示器
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    QApplication app(argc, argv);
+    app.setApplicationName("onduty_bench");
+    QLoggingCategory::setFilterRules(QStringLiteral("default.debug=false\nonduty.*.debug=false"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("onduty 基准测试，结果以JSON输出到标准输出");
+    parser.addHelpOption();
+    const QCommandLineOption filterOption("filter", "只运行名称包含该字符串的测试", "text");
+    const QCommandLineOption minTimeOption("min-time", "每个测试大约运行的毫秒数（默认300）", "ms", "300");
+    const QCommandLineOption outputOption("output", "把JSON写入文件而不是标准输出", "file");
+    const QCommandLineOption peerInterfaceOption("peer-interface", "局域网同步测试使用的网卡，例如lo（默认由系统选择）", "name");
+    const QCommandLineOption ntpRunsOption("ntp-runs", "每个NTP场景查询的次数（默认10）", "count", "10");
+    const QCommandLineOption ntpTimeoutOption("ntp-timeout", "NTP场景中一次查询的超时毫秒数（默认1000）", "ms", "1000");
+    parser.addOptions({ filterOption, minTimeOption, outputOption, peerInterfaceOption, ntpRunsOption, ntpTimeoutOption });
+    parser.process(app);
+
+    Bench bench(qMax(10.0, parser.value(minTimeOption).toDouble()), parser.value(filterOption));
+    QTemporaryDir tempDir;
+
+    // 配置
+    const QMap<QString, QString> config = sampleConfig();
+    const QByteArray configData = ConfigStore::serialize(config, QStringLiteral("; bench\n"));
+    bench.run("config/serialize", [&](qint64) { return ConfigStore::serialize(config, QString()).size(); });
+    bench.run("config/parse", [&](qint64) { return ConfigStore::parse(configData).size(); });
+    {
+        ConfigStore store(tempDir.filePath("bench_config.ini"));
+        for (auto it = config.constBegin(); it != config.constEnd(); ++it)
+            store.setValue(it.key(), it.value());
+        bench.run("config/setValue-flush", [&](qint64 i) {
+            store.setValue("rotation/offset", i);
+            return store.flush() ? 1 : 0;
+        });
+        bench.run("config/load", [&](qint64) { return store.load() ? 1 : 0; });
+    }
+    {
+        StateJournal journal(tempDir.filePath("bench_state.journal"));
+        journal.replay(0);
+        bench.run("journal/append-fsync", [&](qint64 i) {
+            return journal.append(StateJournal::ManualOffset, i) ? 1 : 0;
+        });
+        bench.run("journal/replay", [&](qint64) { return journal.replay(0).size(); });
+    }
+    {
+        // 十年、三个名单，每天一条换日记录，约一成的日子还有一次手动调整
+        DutyHistory history(tempDir.filePath("bench_history.dat"));
+        history.open();
+        const QDate firstDate(2015, 9, 1);
+        QRandomGenerator historyRandom(20251021);
+        for (int day = 0; day < 3650; ++day) {
+            for (int roster = 0; roster < 3; ++roster) {
+                history.append({ firstDate.addDays(day), roster, { day % 47, (day + 1) % 47 }, DutyHistory::Auto, 0 });
+                if (historyRandom.bounded(10) == 0)
+                    history.append({ firstDate.addDays(day), roster, { (day + 2) % 47, (day + 3) % 47 }, DutyHistory::Next, 0 });
+            }
+        }
+        bench.run("history/entriesOn", [&](qint64 i) {
+            return history.entriesOn(firstDate.addDays((i * 7919) % 3650), int(i % 3)).size();
+        });
+        bench.run("history/entriesBetween-month", [&](qint64 i) {
+            const QDate from = firstDate.addDays((i * 7919) % 3620);
+            return history.entriesBetween(from, from.addDays(30)).size();
+        });
+        bench.run("history/latest", [&](qint64 i) { return history.latest(int(i % 3)).pair.first; });
+        bench.run("history/append", [&](qint64 i) {
+            return history.append({ firstDate.addDays(3650 + int(i)), 0, { 0, 1 }, DutyHistory::Auto, 0 }) ? 1 : 0;
+        });
+        bench.run("history/open", [&](qint64) { return history.open() ? history.size() : 0; });
+    }
+
+    // 轮换和日历
+    WorkCalendar calendar;
+    RotationEngine rotation;
+    rotation.setCalendar(&calendar);
+    rotation.setTotalPersons(47);
+    rotation.setAnchor(QDate(2025, 9, 1), { 0, 1 });
+    QVector<QDate> dates;
+    QRandomGenerator random(20251009);
+    const qint64 firstDay = QDate(2000, 1, 1).toJulianDay();
+    for (int i = 0; i < 4096; ++i)
+        dates.append(QDate::fromJulianDay(firstDay + random.bounded(36525)));
+
+    bench.run("rotation/pairAt", [&](qint64 i) { return rotation.pairAt(i).second; });
+    bench.run("rotation/pairFor-2000-2099", [&](qint64 i) { return rotation.pairFor(dates[i & 4095]).first; });
+    bench.run("calendar/isWorkday", [&](qint64 i) { return calendar.isWorkday(dates[i & 4095]) ? 1 : 0; });
+    bench.run("calendar/rank", [&](qint64 i) { return calendar.rank(dates[i & 4095]); });
+    bench.run("calendar/select", [&](qint64 i) { return calendar.select(calendar.rank(dates[i & 4095])).day(); });
+    bench.run("calendar/reset", [&](qint64) {
+        calendar.reset();
+        return 1;
+    });
+    {
+        // 60人的学期约100个工作日，带一些请假、换班和不排在一起的人
+        DutyPlanner::Constraints constraints;
+        constraints.termStart = QDate(2025, 9, 1);
+        constraints.termEnd = QDate(2026, 1, 23);
+        QRandomGenerator planRandom(20251022);
+        for (int i = 0; i < 30; ++i) {
+            const QDate from = constraints.termStart.addDays(planRandom.bounded(140));
+            constraints.absences.append({ int(planRandom.bounded(60)), from, from.addDays(planRandom.bounded(3)) });
+        }
+        for (int i = 0; i < 10; ++i)
+            constraints.swaps.append({ constraints.termStart.addDays(planRandom.bounded(140)), i, 59 - i });
+        for (int i = 0; i < 5; ++i)
+            constraints.exclusions.append({ 2 * i, 2 * i + 1 });
+
+        bench.run("planner/solve-60x100", [&](qint64) {
+            DutyPlanner planner;
+            planner.setCalendar(&calendar);
+            planner.setPersons(60);
+            planner.setConstraints(constraints);
+            return planner.update();
+        });
+        DutyPlanner planner;
+        planner.setCalendar(&calendar);
+        planner.setPersons(60);
+        planner.setConstraints(constraints);
+        planner.update();
+        // 每次加一个请假再去掉，只重排受影响的几天
+        bench.run("planner/replan-absence", [&](qint64 i) {
+            DutyPlanner::Constraints changed = constraints;
+            const QDate date = constraints.termStart.addDays(int(i % 140));
+            changed.absences.append({ int(i % 60), date, date });
+            planner.setConstraints(changed);
+            int replanned = planner.update();
+            planner.setConstraints(constraints);
+            replanned += planner.update();
+            return replanned;
+        });
+        const QByteArray planData = "term 2025-09-01 2026-01-23\nstart 1\nabsent 12 2025-10-08~2025-10-10\n"
+                                    "swap 2025-10-15 5 17\napart 3 9\n";
+        bench.run("planner/parse", [&](qint64) { return DutyPlanner::parse(planData, nullptr).absences.size(); });
+    }
+
+    // 名单
+    const QByteArray rosterData = sampleRoster(50);
+    Roster roster;
+    bench.run("roster/parse-50", [&](qint64) { return roster.parse(rosterData.constData(), rosterData.size()) ? 1 : 0; });
+    // 一万行、每行不到16字节的名单（如“张伟,1”），预留的条目数要按行数算
+    QByteArray largeRosterData;
+    for (int i = 0; i < 10000; ++i)
+        largeRosterData += QByteArray("张伟,") + QByteArray::number(i % 6 + 1) + '\n';
+    bench.run("roster/parse-10k", [&](qint64) { return roster.parse(largeRosterData.constData(), largeRosterData.size()) ? 1 : 0; });
+    roster.parse(rosterData.constData(), rosterData.size());
+    const QString lookupName = roster.name(37);
+    bench.run("roster/indexOfName", [&](qint64) { return roster.indexOfName(lookupName); });
+
+    // NTP
+    const QByteArray ntpResponse = sampleNtpResponse();
+    const quint64 ntpOrigin = NtpClient::toNtpTimestamp(kSampleRequestUs);
+    bench.run("ntp/parseResponse", [&](qint64) {
+        NtpClient::Sample sample;
+        return NtpClient::parseResponse(ntpResponse, ntpOrigin, kSampleRequestUs, kSampleRequestUs + 40300, &sample) ? sample.offsetUs : 0;
+    });
+    // 调度器：ConfigStore每次修改都会重新启动延迟写入任务
+    QJsonArray schedulerCoalescing;
+    {
+        TaskScheduler scheduler;
+        QVector<ScheduledTask *> tasks;
+        for (int i = 0; i < 20; ++i) {
+            tasks.append(new ScheduledTask("bench", 100, &scheduler, &scheduler));
+            tasks.last()->start(60000 + i * 1000);
+        }
+        bench.run("scheduler/restart-20-tasks", [&](qint64 i) {
+            tasks[i % 20]->start();
+            return 1;
+        });
+        qDeleteAll(tasks);
+    }
+    for (int slackMs : { 0, 40 }) {
+        const QJsonObject result = benchSchedulerCoalescing(bench, slackMs);
+        if (!result.isEmpty())
+            schedulerCoalescing.append(result);
+    }
+
+    const QJsonArray ntpScenarios = benchNtpScenarios(bench, qMax(1, parser.value(ntpRunsOption).toInt()),
+                                                      qMax(100, parser.value(ntpTimeoutOption).toInt()));
+
+    // 局域网同步
+    benchPeerSync(bench, parser.value(peerInterfaceOption));
+
+    // 显示控件：每次换一组名字再绘制一帧
+    const QString names[] = { roster.name(0), roster.name(1), roster.name(2), roster.name(3) };
+    QImage frame(240, 140, QImage::Format_ARGB32_Premultiplied);
+    {
+        DutyView view;
+        view.resize(240, 140);
+        bench.run("widget/dutyview-update", [&](qint64 i) {
+            view.setNames(names[i & 1], names[(i & 1) + 2]);
+            frame.fill(Qt::transparent);
+            view.render(&frame, QPoint(), QRegion(), QWidget::DrawWindowBackground);
+            return 1;
+        });
+        bench.run("widget/dutyview-unchanged", [&](qint64) {
+            view.setNames(names[0], names[2]);
+            frame.fill(Qt::transparent);
+            view.render(&frame, QPoint(), QRegion(), QWidget::DrawWindowBackground);
+            return 1;
+        });
+    }
+    {
+        QLabel *first = nullptr;
+        QLabel *second = nullptr;
+        QWidget *legacy = createLegacyWidget(&first, &second);
+        bench.run("widget/legacy-labels-update", [&](qint64 i) {
+            first->setText(names[i & 1]);
+            second->setText(names[(i & 1) + 2]);
+            frame.fill(Qt::transparent);
+            legacy->render(&frame, QPoint(), QRegion(), QWidget::DrawWindowBackground | QWidget::DrawChildren);
+            return 1;
+        });
+        delete legacy;
+    }
+
+    QJsonObject report;
+    report["benchmark"] = "onduty";
+    report["qt"] = QString::fromLatin1(qVersion());
+    report["platform"] = QGuiApplication::platformName();
+    report["results"] = bench.toJson();
+    report["schedulerCoalescing"] = schedulerCoalescing;
+    report["ntpScenarios"] = ntpScenarios;
+    const QByteArray json = QJsonDocument(report).toJson(QJsonDocument::Indented);
+
+    if (parser.isSet(outputOption)) {
+        QFile file(parser.value(outputOption));
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(json) != json.size()) {
+            std::fprintf(stderr, "Failed to write %s\n", qPrintable(parser.value(outputOption)));
+            return 1;
+        }
+    } else {
+        std::fwrite(json.constData(), 1, size_t(json.size()), stdout);
+    }
+    return 0;
+}
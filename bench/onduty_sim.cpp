@@ -0,0 +1,963 @@
+// 长期运行的加速模拟：虚拟时钟驱动任务调度器，按场景脚本开关机、断电、放映、切换考试模式和手动调整，
+// 十年的使用在几秒内跑完。换日、校时、状态日志、配置快照和值日历史都是程序本身的代码，
+// 只有窗口和托盘换成了可见标志（淡入淡出立即完成）。
+// 每次换日和手动调整后都与开机时的状态独立推算出的组合比较，结束时输出JSON：
+// 最终状态（按磁盘上的文件恢复，与重启后看到的一致）、不一致的日子、每年的内存采样和写入的字节数
+#include "configstore.h"
+#include "dutyhistory.h"
+#include "dutystate.h"
+#include "foregroundwatcher.h"
+#include "metrics.h"
+#include "rolloverscheduler.h"
+#include "statejournal.h"
+#include "taskscheduler.h"
+#include "timeservice.h"
+#include "virtualclock.h"
+
+#include <QCommandLineParser>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QGuiApplication>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLoggingCategory>
+#include <QRegularExpression>
+#include <QTemporaryDir>
+#include <array>
+#include <cstdio>
+#include <functional>
+
+namespace {
+const qint64 kDayMs = 24LL * 60 * 60 * 1000;
+
+// 没有指定场景文件时运行的十年：上课日早上开机、傍晚关机，上午两节课放映PPT；
+// 每学期19周正常上课，第20周有一天断电、一天手动换下一组，然后考试一周（考试模式），放假5周不开机
+const char kDefaultScenario[] = R"(
+start 2025-09-01 06:00
+repeat 20
+  repeat 19
+    repeat 5
+      until 07:30
+      boot
+      run 1h
+      present 45m
+      run 1h15m
+      present 40m
+      until 17:30
+      shutdown
+    end
+    run 2d
+  end
+
+  repeat 3
+    until 07:30
+    boot
+    run 1h
+    present 45m
+    until 17:30
+    shutdown
+  end
+  until 07:30
+  boot
+  run 2h
+  present 30m
+  crash
+  until 07:30
+  boot
+  run 1h
+  next
+  until 17:30
+  shutdown
+  run 2d
+
+  until 07:30
+  boot
+  exam on
+  until 17:30
+  shutdown
+  repeat 3
+    until 07:30
+    boot
+    until 17:30
+    shutdown
+  end
+  until 07:30
+  boot
+  run 4h
+  exam off
+  until 17:30
+  shutdown
+  run 2d
+
+  run 5w
+end
+)";
+
+// 场景脚本的一条命令，见main()中的说明
+struct Step {
+    enum Kind { Boot, Shutdown, Crash, Run, Until, Present, Fullscreen, Exam, Next, Previous, Set, Repeat, End };
+    Kind kind = Run;
+    int line = 0;
+    qint64 duration = 0;  // Run、Present、Fullscreen
+    QTime time;           // Until
+    bool on = false;      // Exam
+    int count = 0;        // Repeat
+    QString key;          // Set
+    QString value;
+};
+
+struct Scenario {
+    QDateTime start;
+    QVector<Step> steps;
+};
+
+// 1w2d3h4m5s的任意组合，返回毫秒；格式不对时为-1
+qint64 parseDuration(const QString &text)
+{
+    static const QRegularExpression part(QStringLiteral("(\\d+)([wdhms])"));
+    qint64 total = 0;
+    qsizetype position = 0;
+    QRegularExpressionMatchIterator it = part.globalMatch(text);
+    while (it.hasNext()) {
+        const QRegularExpressionMatch match = it.next();
+        if (match.capturedStart() != position)
+            return -1;
+        position = match.capturedEnd();
+        const qint64 value = match.captured(1).toLongLong();
+        switch (match.captured(2).at(0).toLatin1()) {
+        case 'w': total += value * 7 * kDayMs; break;
+        case 'd': total += value * kDayMs; break;
+        case 'h': total += value * 3600000; break;
+        case 'm': total += value * 60000; break;
+        default: total += value * 1000; break;
+        }
+    }
+    return position > 0 && position == text.size() ? total : -1;
+}
+
+bool parseScenario(const QByteArray &data, Scenario *scenario, QStringList *errors)
+{
+    static const QRegularExpression whitespace(QStringLiteral("\\s+"));
+    static const QHash<QString, Step::Kind> simpleKinds = {
+        { "boot", Step::Boot }, { "shutdown", Step::Shutdown }, { "crash", Step::Crash },
+        { "next", Step::Next }, { "previous", Step::Previous }, { "end", Step::End },
+    };
+
+    int depth = 0;
+    bool valid = true;
+    const QStringList lines = QString::fromUtf8(data).split('\n');
+    for (int lineNumber = 0; lineNumber < lines.size(); ++lineNumber) {
+        const QString line = lines[lineNumber].section('#', 0, 0).trimmed();
+        if (line.isEmpty())
+            continue;
+        const QStringList fields = line.split(whitespace);
+        const QString &keyword = fields.first();
+        Step step;
+        step.line = lineNumber + 1;
+        bool ok = false;
+        if (keyword == "start" && (fields.size() == 2 || fields.size() == 3)) {
+            const QDate date = QDate::fromString(fields[1], "yyyy-MM-dd");
+            const QTime time = fields.size() == 3 ? QTime::fromString(fields[2], "HH:mm") : QTime(0, 0);
+            // 只能是第一条命令
+            ok = date.isValid() && time.isValid() && scenario->steps.isEmpty() && !scenario->start.isValid();
+            if (ok)
+                scenario->start = QDateTime(date, time);
+            else
+                valid = false;
+            if (!ok && errors)
+                errors->append(QStringLiteral("第%1行：%2").arg(lineNumber + 1).arg(line));
+            continue;
+        }
+        if (simpleKinds.contains(keyword) && fields.size() == 1) {
+            step.kind = simpleKinds.value(keyword);
+            ok = step.kind != Step::End || depth > 0;
+            if (ok && step.kind == Step::End)
+                --depth;
+        } else if ((keyword == "run" || keyword == "present" || keyword == "fullscreen") && fields.size() == 2) {
+            step.kind = keyword == "run" ? Step::Run : keyword == "present" ? Step::Present : Step::Fullscreen;
+            step.duration = parseDuration(fields[1]);
+            ok = step.duration >= 0;
+        } else if (keyword == "until" && fields.size() == 2) {
+            step.kind = Step::Until;
+            step.time = QTime::fromString(fields[1], "HH:mm");
+            ok = step.time.isValid();
+        } else if (keyword == "exam" && fields.size() == 2) {
+            step.kind = Step::Exam;
+            step.on = fields[1] == "on";
+            ok = step.on || fields[1] == "off";
+        } else if (keyword == "repeat" && fields.size() == 2) {
+            step.kind = Step::Repeat;
+            step.count = fields[1].toInt(&ok);
+            ok = ok && step.count >= 1;
+            if (ok)
+                ++depth;
+        } else if (keyword == "set" && fields.size() >= 3) {
+            step.kind = Step::Set;
+            step.key = fields[1];
+            step.value = line.section(whitespace, 2);
+            ok = step.key.contains('/');
+        }
+        if (ok)
+            scenario->steps.append(step);
+        else
+            valid = false;
+        if (!ok && errors)
+            errors->append(QStringLiteral("第%1行：%2").arg(lineNumber + 1).arg(line));
+    }
+    if (depth > 0) {
+        valid = false;
+        if (errors)
+            errors->append(QStringLiteral("repeat 缺少 end"));
+    }
+    if (!scenario->start.isValid()) {
+        valid = false;
+        if (errors)
+            errors->append(QStringLiteral("缺少 start"));
+    }
+    return valid;
+}
+
+// 窗口程序中与界面无关的部分，按DutyRosterApp的顺序启动、换日、记日志、写快照和响应放映；
+// 窗口只剩visible标志，淡入淡出立即完成
+class SimulatedApp : public QObject
+{
+public:
+    SimulatedApp(const QString &dir, const Clock *clock)
+        : baseDir(dir)
+        , stateJournal(dir + "/duty_state.journal")
+        , dutyHistory(dir + "/duty_history.dat")
+    {
+        configStore = new ConfigStore(dir + "/duty_config.ini", this);
+        configStore->setHeader(DutyState::configHeader());
+        timeService = new TimeService(this, clock);
+
+        foregroundWatcher = new FakeForegroundWatcher(this);
+        connect(foregroundWatcher, &ForegroundWatcher::presentationChanged, this, &SimulatedApp::onPresentationChanged);
+        connect(foregroundWatcher, &ForegroundWatcher::fullscreenChanged, this, &SimulatedApp::handleFullscreenState);
+
+        loadConfig();
+        dutyHistory.open();
+        visible = !state.isTestingMode;
+    }
+
+    // 对应第一帧之后的finishStartup
+    void start()
+    {
+        configStore->setWatched(true);
+        if (!state.isTestingMode)
+            timeService->requestDate([this](const QDate &today) { checkAndUpdateDuty(today); });
+        connect(timeService, &TimeService::synced, this, [this]() {
+            saveSettings();
+            if (!state.isTestingMode)
+                checkAndUpdateDuty(timeService->currentDate());
+        });
+        timeService->sync();
+
+        rolloverScheduler = new RolloverScheduler(timeService, [this](const QDate &date) { return state.calendar.isWorkday(date); }, this);
+        connect(rolloverScheduler, &RolloverScheduler::rollover, this, [this](const QDate &today) {
+            ++rollovers;
+            refreshPair();
+            checkAndUpdateDuty(today);
+        });
+        updateSuspension();
+    }
+
+    // 正常退出
+    void quit() { compactJournal(); }
+
+    void setPresentation(bool showing) { foregroundWatcher->setPresentationShowing(showing); }
+    void setFullscreen(bool fullscreen) { foregroundWatcher->setFullscreen(fullscreen); }
+
+    void setTestingMode(bool on)
+    {
+        if (state.isTestingMode == on)
+            return;
+        state.setTestingMode(on, timeService->currentDate());
+        wasHiddenByFullscreen = false;
+        wasHiddenByPPT = false;
+        visible = !on;
+        if (visible)
+            refreshPair();
+        commitState();
+        updateSuspension();
+    }
+
+    // 与转发的next/previous命令相同，考试模式下不可用
+    bool stepDuty(int steps)
+    {
+        if (state.isTestingMode)
+            return false;
+        const QDate today = timeService->currentDate();
+        state.stepDuty(steps, today);
+        commitState();
+        recordHistory(steps > 0 ? DutyHistory::Next : DutyHistory::Previous, today);
+        refreshPair();
+        return true;
+    }
+
+    DutyState state;
+    std::function<void(const QDate &)> onAdvanced;
+    int rollovers = 0;
+    int presentationHides = 0;
+
+private:
+    void onPresentationChanged(bool isPPTShowing)
+    {
+        if (isPPTShowing && visible) {
+            visible = false;
+            wasHiddenByPPT = true;
+            ++presentationHides;
+            Metrics::increment(Metrics::PresentationHides);
+        } else if (!isPPTShowing && wasHiddenByPPT && !visible && !state.isTestingMode) {
+            show();
+            wasHiddenByPPT = false;
+            Metrics::increment(Metrics::PresentationShows);
+        }
+        updateSuspension();
+    }
+
+    void handleFullscreenState(bool hasFullscreen)
+    {
+        if (hasFullscreen && visible) {
+            visible = false;
+            wasHiddenByFullscreen = true;
+            Metrics::increment(Metrics::FullscreenHides);
+        } else if (!hasFullscreen && wasHiddenByFullscreen && !visible) {
+            show();
+            wasHiddenByFullscreen = false;
+            Metrics::increment(Metrics::FullscreenShows);
+        }
+        updateSuspension();
+    }
+
+    // showEvent
+    void show()
+    {
+        visible = true;
+        refreshPair();
+        if (foregroundWatcher->isFullscreen())
+            handleFullscreenState(true);
+    }
+
+    void updateSuspension()
+    {
+        TaskScheduler::global()->setSuspended(state.isTestingMode && !visible);
+    }
+
+    void refreshPair()
+    {
+        displayed = state.pairFor(timeService->currentDate());
+    }
+
+    bool checkAndUpdateDuty(const QDate &today)
+    {
+        if (state.calendar.isWorkday(today) && !state.isTestingMode && state.advance(today)) {
+            commitState();
+            recordHistory(DutyHistory::Auto, today);
+            refreshPair();
+            if (onAdvanced)
+                onAdvanced(today);
+            return true;
+        }
+        return false;
+    }
+
+    void loadConfig()
+    {
+        const bool exists = configStore->load();
+        const ConfigStore &config = *configStore;
+
+        isStartupLaunch = config.value("settings/startupLaunch", false).toBool();
+        state.readSettings(config, baseDir);
+        state.loadCalendar();
+
+        timeService->setResyncInterval(config.value("time/resyncMinutes", 360).toInt());
+        timeService->restoreOffset(config.value("time/offsetMs", 0).toLongLong(),
+                                   QDateTime::fromString(config.value("time/lastSync").toString(), Qt::ISODate));
+
+        cycleRosters = config.value("settings/cycleRosters", false).toBool();
+        cycleSeconds = qMax(3, config.value("settings/cycleSeconds", 20).toInt());
+
+        if (state.loadRosters())
+            saveSettings();
+
+        const bool snapshotStale = state.restore(config, stateJournal, timeService->currentDate());
+        journaledState.resize(state.rosterCount());
+        for (int i = 0; i < state.rosterCount(); ++i) {
+            for (StateJournal::Field field : DutyState::liveFields)
+                journaledState[i][field] = state.field(field, i);
+        }
+        if (!exists || snapshotStale)
+            compactJournal();
+    }
+
+    void commitState()
+    {
+        for (int i = 0; i < state.rosterCount(); ++i) {
+            for (StateJournal::Field field : DutyState::liveFields) {
+                const qint64 value = state.field(field, i);
+                if (journaledState[i][field] != value && stateJournal.append(field, value, i))
+                    journaledState[i][field] = value;
+            }
+        }
+        if (stateJournal.pendingRecords() >= 64)
+            compactJournal();
+    }
+
+    void recordHistory(DutyHistory::Reason reason, const QDate &today)
+    {
+        const qint64 recordedAt = timeService->currentMSecsSinceEpoch() / 1000;
+        for (int i = 0; i < state.rosterCount(); ++i) {
+            const RotationEngine::Pair pair = state.pairFor(today, i);
+            const DutyHistory::Entry last = dutyHistory.latest(i);
+            if (last.date == today && last.pair == pair)
+                continue;
+            dutyHistory.append({ today, i, pair, reason, recordedAt });
+        }
+    }
+
+    void compactJournal()
+    {
+        ConfigStore &config = *configStore;
+        state.writeSnapshot(config, timeService->currentDate());
+        config.setValue("journal/seq", stateJournal.lastSeq());
+        saveSettings();
+        if (configStore->flush())
+            stateJournal.truncate();
+    }
+
+    // 局域网同步的设置原样留在配置中
+    void saveSettings()
+    {
+        ConfigStore &config = *configStore;
+        config.setValue("settings/startupLaunch", isStartupLaunch);
+        config.setValue("settings/cycleRosters", cycleRosters);
+        config.setValue("settings/cycleSeconds", cycleSeconds);
+        state.writeSettings(config);
+        config.setValue("time/resyncMinutes", timeService->resyncInterval());
+        if (timeService->hasOffset()) {
+            config.setValue("time/offsetMs", timeService->offsetMs());
+            config.setValue("time/lastSync", timeService->lastSyncTime().toString(Qt::ISODate));
+        }
+    }
+
+    QString baseDir;
+    StateJournal stateJournal;
+    DutyHistory dutyHistory;
+    ConfigStore *configStore;
+    TimeService *timeService;
+    FakeForegroundWatcher *foregroundWatcher;
+    RolloverScheduler *rolloverScheduler = nullptr;
+    QVector<std::array<qint64, StateJournal::FieldCount>> journaledState;
+    RotationEngine::Pair displayed;
+    bool visible = true;
+    bool wasHiddenByFullscreen = false;
+    bool wasHiddenByPPT = false;
+    bool isStartupLaunch = false;
+    bool cycleRosters = false;
+    int cycleSeconds = 20;
+};
+
+class Simulator
+{
+public:
+    Simulator(const QString &dir, const Scenario &scenario)
+        : dir(dir)
+        , scenario(scenario)
+        , clock(scenario.start.toMSecsSinceEpoch())
+        , nextSampleMs(clock.msecsSinceEpoch() + 365 * kDayMs)
+    {
+        // 之后创建的所有任务都按虚拟时间调度
+        TaskScheduler::global()->setClock(&clock);
+    }
+
+    ~Simulator()
+    {
+        delete app;
+        TaskScheduler::global()->setClock(nullptr);
+    }
+
+    void run()
+    {
+        QElapsedTimer timer;
+        timer.start();
+
+        struct Frame {
+            int first;
+            int remaining;
+        };
+        QVector<Frame> frames;
+        for (int pc = 0; pc < scenario.steps.size(); ++pc) {
+            const Step &step = scenario.steps[pc];
+            if (step.kind == Step::Repeat) {
+                frames.append({ pc + 1, step.count });
+            } else if (step.kind == Step::End) {
+                if (--frames.last().remaining > 0)
+                    pc = frames.last().first - 1;
+                else
+                    frames.removeLast();
+            } else {
+                execute(step);
+            }
+        }
+        // 场景结束时程序还在运行就正常退出
+        if (app)
+            shutdown(false);
+        sample();
+        elapsedMs = timer.elapsed();
+    }
+
+    QJsonObject report()
+    {
+        const qint64 simulatedMs = clock.msecsSinceEpoch() - scenario.start.toMSecsSinceEpoch();
+        QJsonObject report;
+        report["simulator"] = "onduty";
+        report["qt"] = QString::fromLatin1(qVersion());
+        report["start"] = scenario.start.toString(Qt::ISODate);
+        report["end"] = now().toString(Qt::ISODate);
+        report["simulatedDays"] = double(simulatedMs) / kDayMs;
+        report["elapsedMs"] = double(elapsedMs);
+        report["speedup"] = double(simulatedMs) / qMax<qint64>(elapsedMs, 1);
+
+        QJsonObject events;
+        events["boots"] = boots;
+        events["crashes"] = crashes;
+        events["presentations"] = presentations;
+        events["presentationHides"] = presentationHides;
+        events["examToggles"] = examToggles;
+        events["manualSteps"] = manualSteps;
+        events["ignoredSteps"] = ignoredSteps;
+        events["advances"] = advances;
+        events["rollovers"] = rollovers;
+        report["events"] = events;
+
+        // 放在检查之前：按文件恢复时还会再比较一次
+        report["finalState"] = finalState();
+
+        QJsonObject drift;
+        drift["checks"] = checks;
+        drift["mismatches"] = mismatches;
+        drift["samples"] = mismatchSamples;
+        report["drift"] = drift;
+
+        QJsonObject memory;
+        memory["samples"] = memorySamples;
+        if (memorySamples.size() >= 2) {
+            const QJsonObject first = memorySamples.first().toObject();
+            const QJsonObject last = memorySamples.last().toObject();
+            memory["residentGrowthBytes"] = last["residentBytes"].toDouble() - first["residentBytes"].toDouble();
+        }
+        report["memory"] = memory;
+
+        QJsonObject writes;
+        writes["configWrites"] = double(Metrics::counter(Metrics::ConfigWrites));
+        writes["configBytes"] = double(Metrics::counter(Metrics::ConfigBytesWritten));
+        writes["journalAppends"] = double(Metrics::counter(Metrics::JournalAppends));
+        writes["journalBytes"] = double(Metrics::counter(Metrics::JournalBytesWritten));
+        writes["historyBytes"] = double(Metrics::counter(Metrics::HistoryBytesWritten));
+        const double totalBytes = writes["configBytes"].toDouble() + writes["journalBytes"].toDouble() + writes["historyBytes"].toDouble();
+        writes["totalBytes"] = totalBytes;
+        writes["bytesPerDay"] = simulatedMs > 0 ? totalBytes * kDayMs / simulatedMs : 0.0;
+        QJsonObject files;
+        for (const char *name : { "duty_config.ini", "duty_state.journal", "duty_history.dat" })
+            files[name] = double(QFileInfo(dir + '/' + name).size());
+        writes["fileSizes"] = files;
+        report["writes"] = writes;
+
+        QJsonObject scheduler;
+        scheduler["wakeups"] = double(TaskScheduler::global()->wakeups());
+        scheduler["wakeupsPerDay"] = simulatedMs > 0 ? double(TaskScheduler::global()->wakeups()) * kDayMs / simulatedMs : 0.0;
+        report["scheduler"] = scheduler;
+
+        report["metrics"] = Metrics::snapshot();
+        return report;
+    }
+
+private:
+    QDateTime now() const { return QDateTime::fromMSecsSinceEpoch(clock.msecsSinceEpoch()); }
+
+    void execute(const Step &step)
+    {
+        switch (step.kind) {
+        case Step::Boot:
+            if (app)
+                ignore(step, "程序已在运行");
+            else
+                boot();
+            break;
+        case Step::Shutdown:
+        case Step::Crash:
+            if (!app)
+                ignore(step, "程序没有运行");
+            else
+                shutdown(step.kind == Step::Crash);
+            break;
+        case Step::Run:
+            advanceTo(clock.msecsSinceEpoch() + step.duration);
+            break;
+        case Step::Until: {
+            QDateTime target(now().date(), step.time);
+            if (target <= now())
+                target = QDateTime(now().date().addDays(1), step.time);
+            advanceTo(target.toMSecsSinceEpoch());
+            break;
+        }
+        case Step::Present:
+        case Step::Fullscreen: {
+            // 没有运行程序时只经过这段时间
+            const auto setShowing = [this, &step](bool showing) {
+                if (!app)
+                    return;
+                if (step.kind == Step::Present)
+                    app->setPresentation(showing);
+                else
+                    app->setFullscreen(showing);
+            };
+            if (app)
+                ++presentations;
+            setShowing(true);
+            advanceTo(clock.msecsSinceEpoch() + step.duration);
+            setShowing(false);
+            pump();
+            break;
+        }
+        case Step::Exam:
+            if (!app) {
+                ignore(step, "程序没有运行");
+                break;
+            }
+            if (app->state.isTestingMode != step.on) {
+                ++examToggles;
+                freeze(app->state, now().date(), step.on);
+            }
+            app->setTestingMode(step.on);
+            pump();
+            check(app->state, now().date());
+            break;
+        case Step::Next:
+        case Step::Previous: {
+            const int steps = step.kind == Step::Next ? 1 : -1;
+            if (!app) {
+                ignore(step, "程序没有运行");
+            } else if (!app->stepDuty(steps)) {
+                ignore(step, "考试模式下不可用");
+            } else {
+                ++manualSteps;
+                // 学期内的调整记在计划中，不改变学期之后的轮换
+                const int roster = app->state.currentRoster();
+                if (roster < offsets.size() && app->state.planner(roster).indexOf(now().date()) < 0)
+                    offsets[roster] += steps;
+                pump();
+                check(app->state, now().date());
+            }
+            break;
+        }
+        case Step::Set: {
+            if (app) {
+                ignore(step, "只能在关机时修改配置");
+                break;
+            }
+            ConfigStore config(dir + "/duty_config.ini");
+            config.setHeader(DutyState::configHeader());
+            config.load();
+            config.setValue(step.key, step.value);
+            config.flush();
+            // 人数、节假日等可能改变，下次开机时重新推算
+            rebase = true;
+            break;
+        }
+        case Step::Repeat:
+        case Step::End:
+            break;
+        }
+    }
+
+    void ignore(const Step &step, const char *reason)
+    {
+        ++ignoredSteps;
+        qWarning().noquote() << QStringLiteral("第%1行被忽略：").arg(step.line) + QString::fromUtf8(reason);
+    }
+
+    void boot()
+    {
+        ++boots;
+        app = new SimulatedApp(dir, &clock);
+        // 换日之前记下轮换状态，之后每次换日和调整都与它推算的组合比较
+        if (rebase)
+            capture(app->state);
+        app->onAdvanced = [this](const QDate &today) {
+            ++advances;
+            check(app->state, today);
+        };
+        app->start();
+        pump();
+        check(app->state, now().date());
+        if (memorySamples.isEmpty())
+            sample();
+    }
+
+    void shutdown(bool crash)
+    {
+        rollovers += app->rollovers;
+        presentationHides += app->presentationHides;
+        if (crash) {
+            // 断电时还没写入的配置修改丢失：析构时的写入之后恢复原来的文件
+            ++crashes;
+            QFile file(dir + "/duty_config.ini");
+            const bool existed = file.exists();
+            const QByteArray before = file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray();
+            file.close();
+            delete app;
+            app = nullptr;
+            if (!existed) {
+                file.remove();
+            } else if (file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+                file.write(before);
+                file.close();
+            }
+        } else {
+            app->quit();
+            delete app;
+            app = nullptr;
+        }
+        // 下次启动的进程中调度器是新的
+        TaskScheduler::global()->setSuspended(false);
+        pump();
+    }
+
+    // 推进虚拟时间，途中按时运行到期的任务；每经过一年采样一次内存
+    void advanceTo(qint64 target)
+    {
+        TaskScheduler *scheduler = TaskScheduler::global();
+        while (clock.msecsSinceEpoch() < target) {
+            qint64 step = target - clock.msecsSinceEpoch();
+            const qint64 wake = scheduler->nextWakeup();
+            if (app && wake >= 0)
+                step = qBound<qint64>(1, wake - scheduler->now(), step);
+            clock.advance(step);
+            pump();
+            if (clock.msecsSinceEpoch() >= nextSampleMs) {
+                sample();
+                nextSampleMs += 365 * kDayMs;
+            }
+        }
+    }
+
+    // 到期的任务、排队的事件（校时结果、文件监视）和延迟删除
+    void pump()
+    {
+        TaskScheduler::global()->runDue();
+        QCoreApplication::processEvents();
+        QCoreApplication::sendPostedEvents(nullptr, QEvent::DeferredDelete);
+    }
+
+    void capture(const DutyState &state)
+    {
+        rebase = false;
+        expectedCalendar = state.calendar;
+        expected.clear();
+        offsets.clear();
+        frozenDays.clear();
+        for (int i = 0; i < state.rosterCount(); ++i) {
+            RotationEngine rotation = state.rotation(i);
+            rotation.setCalendar(&expectedCalendar);
+            expected.append(rotation);
+            offsets.append(state.field(StateJournal::ManualOffset, i));
+            // 考试中启动时锚点就是停住的那一天
+            frozenDays.append(state.isTestingMode ? rotation.anchorDate() : QDate());
+        }
+    }
+
+    // 考试期间的工作日不轮换：开始时记下最后一个换过日的日子，结束时推算的锚点移到结束的日子，组合接着停住的那一组
+    void freeze(const DutyState &state, const QDate &today, bool on)
+    {
+        const qint64 stamp = today.toString("yyyyMMdd").toLongLong();
+        for (int i = 0; i < qMin(state.rosterCount(), int(expected.size())); ++i) {
+            const QDate lastRolled = state.field(StateJournal::LastUpdate, i) == stamp ? today : today.addDays(-1);
+            if (on) {
+                frozenDays[i] = lastRolled;
+            } else if (frozenDays[i].isValid()) {
+                expected[i].setAnchor(lastRolled, expected[i].pairFor(frozenDays[i]));
+                frozenDays[i] = QDate();
+            }
+        }
+    }
+
+    // 学期计划按约束排，不按轮换推算，不比较
+    void check(const DutyState &state, const QDate &today)
+    {
+        for (int i = 0; i < qMin(state.rosterCount(), int(expected.size())); ++i) {
+            if (state.planner(i).indexOf(today) >= 0)
+                continue;
+            ++checks;
+            const RotationEngine::Pair actual = state.pairFor(today, i);
+            const QDate day = frozenDays[i].isValid() && today > frozenDays[i] ? frozenDays[i] : today;
+            const RotationEngine::Pair wanted = expected[i].pairFor(day, offsets[i]);
+            if (actual == wanted)
+                continue;
+            ++mismatches;
+            if (mismatchSamples.size() < 10) {
+                QJsonObject sample;
+                sample["date"] = today.toString(Qt::ISODate);
+                sample["roster"] = i;
+                sample["expected"] = QJsonArray{ wanted.first, wanted.second };
+                sample["actual"] = QJsonArray{ actual.first, actual.second };
+                mismatchSamples.append(sample);
+            }
+        }
+    }
+
+    void sample()
+    {
+        QJsonObject sample;
+        sample["day"] = double((clock.msecsSinceEpoch() - scenario.start.toMSecsSinceEpoch()) / kDayMs);
+        sample["residentBytes"] = double(Metrics::residentBytes());
+        sample["objects"] = app ? int(app->findChildren<QObject *>().size()) : 0;
+        sample["tasks"] = TaskScheduler::global()->taskCount();
+        memorySamples.append(sample);
+    }
+
+    // 与无界面查询相同，只读地按文件恢复
+    QJsonObject finalState()
+    {
+        const QDate today = now().date();
+        ConfigStore config(dir + "/duty_config.ini");
+        config.load();
+        DutyState state;
+        state.readSettings(config, dir);
+        state.loadCalendar();
+        state.loadRosters();
+        StateJournal journal(dir + "/duty_state.journal");
+        state.restore(config, journal, today, false);
+        check(state, today);
+
+        DutyHistory history(dir + "/duty_history.dat");
+        history.open();
+
+        QJsonObject result;
+        result["date"] = today.toString(Qt::ISODate);
+        result["testingMode"] = state.isTestingMode;
+        result["historyEntries"] = history.size();
+        QJsonArray rosters;
+        for (int i = 0; i < state.rosterCount(); ++i) {
+            const RotationEngine::Pair pair = state.pairFor(today, i);
+            QJsonObject roster;
+            roster["pair"] = QJsonArray{ pair.first, pair.second };
+            roster["lastUpdate"] = double(state.field(StateJournal::LastUpdate, i));
+            roster["anchorDate"] = QDate::fromJulianDay(state.field(StateJournal::AnchorDate, i)).toString(Qt::ISODate);
+            roster["manualOffset"] = double(state.field(StateJournal::ManualOffset, i));
+            rosters.append(roster);
+        }
+        result["rosters"] = rosters;
+        return result;
+    }
+
+    QString dir;
+    const Scenario &scenario;
+    VirtualClock clock;
+    SimulatedApp *app = nullptr;
+    qint64 nextSampleMs;
+    qint64 elapsedMs = 0;
+
+    bool rebase = true;
+    WorkCalendar expectedCalendar;
+    QVector<RotationEngine> expected;  // 每个名单一项
+    QVector<qint64> offsets;
+    QVector<QDate> frozenDays;  // 考试中停住的日子，不在考试中时无效
+
+    int boots = 0;
+    int crashes = 0;
+    int presentations = 0;
+    int presentationHides = 0;
+    int examToggles = 0;
+    int manualSteps = 0;
+    int ignoredSteps = 0;
+    int advances = 0;
+    int rollovers = 0;
+    int checks = 0;
+    int mismatches = 0;
+    QJsonArray mismatchSamples;
+    QJsonArray memorySamples;
+};
+}
+
+int main(int argc, char *argv[])
+{
+    // 换日调度器在Windows上需要隐藏窗口，没有指定平台时使用offscreen
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    QGuiApplication app(argc, argv);
+    app.setApplicationName("onduty_sim");
+    QLoggingCategory::setFilterRules(QStringLiteral("default.debug=false\nonduty.*.debug=false"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(
+        "onduty 加速模拟，结果以JSON输出到标准输出。场景脚本每行一条命令，#之后为注释：\n"
+        "  start 2025-09-01 [07:00]  虚拟时间的起点（本地时间），必须是第一条\n"
+        "  boot / shutdown / crash   启动、正常退出、断电（未写入的配置丢失）\n"
+        "  run 1h30m                 经过一段时间（w d h m s）\n"
+        "  until 07:30               经过到下一次这个时刻\n"
+        "  present 45m / fullscreen 45m  放映PPT或全屏一段时间\n"
+        "  exam on|off               切换考试模式\n"
+        "  next / previous           手动换下一组/上一组\n"
+        "  set 分组/键 值            关机时修改配置文件\n"
+        "  repeat 次数 ... end       重复，可以嵌套\n"
+        "没有指定场景时模拟十年的日常使用");
+    parser.addHelpOption();
+    parser.addPositionalArgument("scenario", "场景脚本");
+    const QCommandLineOption dirOption("dir", "配置、日志和历史文件所在的目录（默认为临时目录）；已有文件时在其上继续", "path");
+    const QCommandLineOption outputOption("output", "把JSON写入文件而不是标准输出", "file");
+    parser.addOptions({ dirOption, outputOption });
+    parser.process(app);
+
+    QByteArray scenarioData(kDefaultScenario);
+    const QStringList positional = parser.positionalArguments();
+    if (!positional.isEmpty()) {
+        QFile file(positional.first());
+        if (!file.open(QIODevice::ReadOnly)) {
+            std::fprintf(stderr, "Failed to read %s\n", qPrintable(positional.first()));
+            return 2;
+        }
+        scenarioData = file.readAll();
+    }
+    Scenario scenario;
+    QStringList errors;
+    if (!parseScenario(scenarioData, &scenario, &errors)) {
+        for (const QString &error : std::as_const(errors))
+            std::fprintf(stderr, "%s\n", qPrintable(error));
+        return 2;
+    }
+
+    QTemporaryDir tempDir;
+    const QString dir = parser.isSet(dirOption) ? parser.value(dirOption) : tempDir.path();
+    if (!QDir().mkpath(dir)) {
+        std::fprintf(stderr, "Failed to create %s\n", qPrintable(dir));
+        return 2;
+    }
+
+    QJsonObject report;
+    {
+        Simulator simulator(QDir(dir).absolutePath(), scenario);
+        simulator.run();
+        report = simulator.report();
+    }
+    report["scenario"] = positional.isEmpty() ? QStringLiteral("default") : positional.first();
+    const QByteArray json = QJsonDocument(report).toJson(QJsonDocument::Indented);
+
+    if (parser.isSet(outputOption)) {
+        QFile file(parser.value(outputOption));
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(json) != json.size()) {
+            std::fprintf(stderr, "Failed to write %s\n", qPrintable(parser.value(outputOption)));
+            return 1;
+        }
+    } else {
+        std::fwrite(json.constData(), 1, size_t(json.size()), stdout);
+    }
+    // 推算的组合与实际不一致时以非零值退出，便于在脚本中使用
+    return report.value("drift").toObject().value("mismatches").toInt() > 0 ? 3 : 0;
+}
@@ -0,0 +1,72 @@
+# 记录程序的大小，RUN=ON时再启动一次测量常驻内存和启动时间。
+# 结果追加到OUTPUT（每次一行JSON），与同一配置的上一条记录相比增长超过5%时给出警告。
+#   cmake -DEXE=<onduty> -DPROFILE=<full|lean> -DOUTPUT=<footprint.jsonl> [-DRUN=ON] -P footprint.cmake
+
+if(NOT EXISTS "${EXE}")
+    message(FATAL_ERROR "footprint: ${EXE} not found")
+endif()
+
+file(SIZE "${EXE}" binary_bytes)
+set(resident_bytes -1)
+set(startup_ms -1)
+
+if(RUN)
+    # 没有显示器的构建机上用offscreen平台；程序启动完成后输出一行JSON并退出
+    execute_process(
+        COMMAND ${CMAKE_COMMAND} -E env QT_QPA_PLATFORM=offscreen "${EXE}" --footprint
+        OUTPUT_VARIABLE run_output
+        ERROR_QUIET
+        RESULT_VARIABLE run_result
+        TIMEOUT 60
+    )
+    string(REGEX MATCH "{[^\n]*\"residentBytes\"[^\n]*}" run_json "${run_output}")
+    if(NOT run_result EQUAL 0 OR run_json STREQUAL "")
+        message(WARNING "footprint: ${EXE} --footprint failed (${run_result})")
+    else()
+        string(JSON resident_bytes GET "${run_json}" residentBytes)
+        string(JSON startup_ms GET "${run_json}" startupMs)
+    endif()
+endif()
+
+# 同一配置最近一次的记录，只比较测量过的项
+set(previous_binary "")
+set(previous_resident "")
+if(EXISTS "${OUTPUT}")
+    file(STRINGS "${OUTPUT}" records)
+    foreach(record IN LISTS records)
+        string(JSON record_profile ERROR_VARIABLE json_error GET "${record}" profile)
+        if(json_error OR NOT record_profile STREQUAL PROFILE)
+            continue()
+        endif()
+        string(JSON previous_binary GET "${record}" binaryBytes)
+        string(JSON record_resident GET "${record}" residentBytes)
+        if(record_resident GREATER 0)
+            set(previous_resident ${record_resident})
+        endif()
+    endforeach()
+endif()
+
+string(TIMESTAMP now "%Y-%m-%dT%H:%M:%SZ" UTC)
+file(APPEND "${OUTPUT}"
+    "{\"time\":\"${now}\",\"profile\":\"${PROFILE}\",\"binaryBytes\":${binary_bytes},\"residentBytes\":${resident_bytes},\"startupMs\":${startup_ms}}\n")
+
+math(EXPR binary_kib "${binary_bytes} / 1024")
+if(resident_bytes GREATER 0)
+    math(EXPR resident_kib "${resident_bytes} / 1024")
+    message(STATUS "onduty footprint [${PROFILE}]: binary ${binary_kib} KiB, resident ${resident_kib} KiB, startup ${startup_ms} ms")
+else()
+    message(STATUS "onduty footprint [${PROFILE}]: binary ${binary_kib} KiB")
+endif()
+
+function(check_growth name current previous)
+    if(previous STREQUAL "" OR previous LESS_EQUAL 0 OR current LESS_EQUAL 0)
+        return()
+    endif()
+    math(EXPR limit "${previous} + ${previous} / 20")
+    if(current GREATER limit)
+        message(WARNING "onduty footprint [${PROFILE}]: ${name} grew from ${previous} to ${current} bytes")
+    endif()
+endfunction()
+
+check_growth("binary size" "${binary_bytes}" "${previous_binary}")
+check_growth("resident memory" "${resident_bytes}" "${previous_resident}")
@@ -0,0 +1,282 @@
+#include "configstore.h"
+#include "metrics.h"
+#include "taskscheduler.h"
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QSaveFile>
+#include <QDebug>
+
+namespace {
+QString toText(const QVariant &value)
+{
+    if (value.userType() == QMetaType::Bool)
+        return value.toBool() ? QStringLiteral("true") : QStringLiteral("false");
+    return value.toString();
+}
+
+bool needsQuotes(const QString &text)
+{
+    if (text.isEmpty())
+        return false;
+    if (text.front().isSpace() || text.back().isSpace())
+        return true;
+    for (QChar c : text) {
+        if (c == ';' || c == '#' || c == '"' || c == '=' || c == '\\' || c == ',')
+            return true;
+    }
+    return false;
+}
+
+QString quote(const QString &text)
+{
+    QString escaped = text;
+    escaped.replace('\\', QStringLiteral("\\\\")).replace('"', QStringLiteral("\\\""));
+    return '"' + escaped + '"';
+}
+
+QString unquote(const QString &text)
+{
+    if (text.size() < 2 || !text.startsWith('"') || !text.endsWith('"'))
+        return text;
+    QString result;
+    result.reserve(text.size() - 2);
+    for (int i = 1; i < text.size() - 1; ++i) {
+        if (text[i] == '\\' && i + 1 < text.size() - 1)
+            ++i;
+        result.append(text[i]);
+    }
+    return result;
+}
+}
+
+ConfigStore::ConfigStore(const QString &filePath, QObject *parent)
+    : QObject(parent)
+    , path(filePath)
+{
+    // 延迟写入可以再推迟半秒和其他任务一起唤醒；与显示无关，考试模式下同样要写
+    writeTask = new ScheduledTask("configWrite", 500, this);
+    writeTask->setSingleShot(true);
+    writeTask->setInterval(500);
+    writeTask->setRunWhileSuspended(true);
+    connect(writeTask, &ScheduledTask::timeout, this, []() { Metrics::increment(Metrics::ConfigTimerWakeups); });
+    connect(writeTask, &ScheduledTask::timeout, this, &ConfigStore::flush);
+}
+
+ConfigStore::~ConfigStore()
+{
+    flush();
+}
+
+bool ConfigStore::load()
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    const QByteArray data = file.readAll();
+    values = parse(data);
+    dirtyKeys.clear();
+    setBaseline(data);
+    return true;
+}
+
+QVariant ConfigStore::value(const QString &key, const QVariant &defaultValue) const
+{
+    auto it = values.constFind(key);
+    return it != values.constEnd() ? QVariant(*it) : defaultValue;
+}
+
+void ConfigStore::setValue(const QString &key, const QVariant &value)
+{
+    const QString text = toText(value);
+    auto it = values.find(key);
+    if (it != values.end() && *it == text)
+        return;
+
+    values.insert(key, text);
+    dirtyKeys.insert(key);
+    if (!writeTask->isActive())
+        writeTask->start();
+}
+
+void ConfigStore::remove(const QString &key)
+{
+    if (!values.remove(key))
+        return;
+
+    dirtyKeys.insert(key);
+    if (!writeTask->isActive())
+        writeTask->start();
+}
+
+void ConfigStore::setWriteDelay(int msec)
+{
+    writeTask->setInterval(msec);
+}
+
+bool ConfigStore::flush()
+{
+    writeTask->stop();
+    if (dirtyKeys.isEmpty())
+        return true;
+
+    QElapsedTimer timer;
+    timer.start();
+    const QByteArray data = serialize(values, headerText);
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size() || !file.commit()) {
+        qWarning() << "Failed to write config file:" << path << file.errorString();
+        Metrics::increment(Metrics::ConfigWriteFailures);
+        return false;
+    }
+    Metrics::increment(Metrics::ConfigWrites);
+    Metrics::increment(Metrics::ConfigBytesWritten, quint64(data.size()));
+    Metrics::record(Metrics::ConfigWriteTime, timer.nsecsElapsed() / 1000);
+
+    dirtyKeys.clear();
+    setBaseline(data);
+    emit written(data.size());
+    return true;
+}
+
+void ConfigStore::setWatched(bool watched)
+{
+    if (!watched) {
+        delete watcher;
+        watcher = nullptr;
+        if (reloadTask)
+            reloadTask->stop();
+        return;
+    }
+    if (watcher)
+        return;
+
+    // 编辑器保存时可能先清空再写入、或写临时文件再改名，等一会儿再读
+    if (!reloadTask) {
+        reloadTask = new ScheduledTask("configReload", 200, this);
+        reloadTask->setSingleShot(true);
+        reloadTask->setInterval(300);
+        reloadTask->setRunWhileSuspended(true);
+        connect(reloadTask, &ScheduledTask::timeout, this, &ConfigStore::reloadIfChanged);
+    }
+    // 原子替换后文件本身的监视会失效，同时监视目录以便重新加上
+    watcher = new QFileSystemWatcher(this);
+    watcher->addPath(QFileInfo(path).absolutePath());
+    if (QFileInfo::exists(path))
+        watcher->addPath(path);
+    connect(watcher, &QFileSystemWatcher::fileChanged, reloadTask, qOverload<>(&ScheduledTask::start));
+    connect(watcher, &QFileSystemWatcher::directoryChanged, this, [this]() {
+        // 目录中其他文件的变化很多（日志、历史记录），只在配置文件的时间变化时才读取
+        const QFileInfo info(path);
+        if (info.exists() && !watcher->files().contains(path))
+            watcher->addPath(path);
+        if (info.exists() && info.lastModified() != baselineModified)
+            reloadTask->start();
+    });
+}
+
+void ConfigStore::reloadIfChanged()
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return;
+    const QByteArray data = file.readAll();
+    file.close();
+    // 自己写入的内容，或者编辑器保存到一半的空文件
+    if (data == baselineData || (data.trimmed().isEmpty() && !baselineData.isEmpty())) {
+        baselineModified = QFileInfo(path).lastModified();
+        return;
+    }
+
+    const QMap<QString, QString> loaded = parse(data);
+    QStringList changed;
+    for (auto it = loaded.constBegin(); it != loaded.constEnd(); ++it) {
+        const auto old = baseline.constFind(it.key());
+        if (old == baseline.constEnd() || *old != it.value())
+            changed.append(it.key());
+    }
+    for (auto it = baseline.constBegin(); it != baseline.constEnd(); ++it) {
+        if (!loaded.contains(it.key()))
+            changed.append(it.key());
+    }
+    setBaseline(data);
+    Metrics::increment(Metrics::ConfigReloads);
+    // 只改了注释或格式
+    if (changed.isEmpty())
+        return;
+
+    // 用户改过的键以文件为准
+    for (const QString &key : std::as_const(changed)) {
+        const auto it = loaded.constFind(key);
+        if (it != loaded.constEnd())
+            values.insert(key, *it);
+        else
+            values.remove(key);
+        dirtyKeys.remove(key);
+    }
+    qDebug() << "Config file changed externally:" << changed;
+    emit externallyChanged(changed);
+}
+
+void ConfigStore::setBaseline(const QByteArray &data)
+{
+    baselineData = data;
+    baseline = parse(data);
+    baselineModified = QFileInfo(path).lastModified();
+}
+
+QByteArray ConfigStore::serialize(const QMap<QString, QString> &values, const QString &header)
+{
+    QString text = header;
+    QString currentGroup;
+    bool firstGroup = true;
+
+    // QMap按键排序，同组的键自然相邻
+    for (auto it = values.constBegin(); it != values.constEnd(); ++it) {
+        const int slash = it.key().indexOf('/');
+        const QString group = slash < 0 ? QStringLiteral("General") : it.key().left(slash);
+        const QString name = slash < 0 ? it.key() : it.key().mid(slash + 1);
+
+        if (firstGroup || group != currentGroup) {
+            if (!firstGroup)
+                text += '\n';
+            text += '[' + group + "]\n";
+            currentGroup = group;
+            firstGroup = false;
+        }
+        text += name + '=' + (needsQuotes(it.value()) ? quote(it.value()) : it.value()) + '\n';
+    }
+    return text.toUtf8();
+}
+
+QMap<QString, QString> ConfigStore::parse(const QByteArray &data)
+{
+    QMap<QString, QString> result;
+    QString group;
+
+    QString text = QString::fromUtf8(data);
+    if (text.startsWith(QChar(0xFEFF)))
+        text.remove(0, 1);
+
+    const QStringList lines = text.split('\n');
+    for (QString line : lines) {
+        line = line.trimmed();
+        if (line.isEmpty() || line.startsWith(';') || line.startsWith('#'))
+            continue;
+        if (line.startsWith('[') && line.endsWith(']')) {
+            group = line.mid(1, line.size() - 2).trimmed();
+            if (group.compare("General", Qt::CaseInsensitive) == 0)
+                group.clear();
+            continue;
+        }
+        const int equals = line.indexOf('=');
+        if (equals <= 0)
+            continue;
+        const QString name = line.left(equals).trimmed();
+        const QString key = group.isEmpty() ? name : group + '/' + name;
+        result.insert(key, unquote(line.mid(equals + 1).trimmed()));
+    }
+    return result;
+}
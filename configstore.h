@@ -0,0 +1,73 @@
+#ifndef CONFIGSTORE_H
+#define CONFIGSTORE_H
+
+#include <QObject>
+#include <QDateTime>
+#include <QMap>
+#include <QSet>
+#include <QStringList>
+#include <QVariant>
+
+class QFileSystemWatcher;
+class ScheduledTask;
+
+// INI配置的延迟写入：只记录真正改变的键，短时间内的多次修改合并成一次，
+// 用QSaveFile原子替换文件，注释头和内容一次写完
+class ConfigStore : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ConfigStore(const QString &filePath, QObject *parent = nullptr);
+    ~ConfigStore() override;
+
+    QString filePath() const { return path; }
+
+    // 读取文件，返回文件是否存在
+    bool load();
+
+    // 键的格式为“分组/名称”，与QSettings一致
+    QVariant value(const QString &key, const QVariant &defaultValue = QVariant()) const;
+    void setValue(const QString &key, const QVariant &value);
+    void remove(const QString &key);
+    bool contains(const QString &key) const { return values.contains(key); }
+
+    bool isDirty() const { return !dirtyKeys.isEmpty(); }
+    void setHeader(const QString &header) { headerText = header; }
+    void setWriteDelay(int msec);
+
+    // 监视文件被其他程序修改：一连串保存合并成一次读取，与上次读写的内容比较，
+    // 只把用户改动的键更新到内存（覆盖尚未写入的同名修改）并发出externallyChanged。
+    // 自己写入引起的变化内容相同，直接忽略，不会再写回去
+    void setWatched(bool watched);
+
+    static QByteArray serialize(const QMap<QString, QString> &values, const QString &header);
+    static QMap<QString, QString> parse(const QByteArray &data);
+
+public slots:
+    // 立即写入未保存的修改
+    bool flush();
+
+signals:
+    void written(qint64 bytes);
+    void externallyChanged(const QStringList &keys);
+
+private:
+    void reloadIfChanged();
+    void setBaseline(const QByteArray &data);
+
+    QString path;
+    QString headerText;
+    QMap<QString, QString> values;
+    QSet<QString> dirtyKeys;
+    ScheduledTask *writeTask;
+
+    // 上次读取或写入时文件的内容，用来区分用户的修改和自己的写入
+    QByteArray baselineData;
+    QMap<QString, QString> baseline;
+    QDateTime baselineModified;
+    QFileSystemWatcher *watcher = nullptr;
+    ScheduledTask *reloadTask = nullptr;
+};
+
+#endif // CONFIGSTORE_H
@@ -0,0 +1,228 @@
+#include "dutyhistory.h"
+#include "metrics.h"
+
+#include <QDebug>
+#include <QSaveFile>
+#include <QtEndian>
+#include <algorithm>
+
+namespace {
+// 文件头（小端）：magic "ODH1"(4) version(2) recordSize(2) 保留(8)
+// 记录（小端）：儒略日(4) index1(2) index2(2) roster(1) reason(1) 保留(2) 记录时的UTC秒数(4)
+const char kMagic[4] = { 'O', 'D', 'H', '1' };
+const quint16 kVersion = 1;
+const int kHeaderSize = 16;
+const int kRecordSize = 16;
+
+QByteArray header()
+{
+    QByteArray data(kHeaderSize, '\0');
+    std::copy_n(kMagic, 4, data.data());
+    qToLittleEndian<quint16>(kVersion, data.data() + 4);
+    qToLittleEndian<quint16>(kRecordSize, data.data() + 6);
+    return data;
+}
+
+QByteArray encode(const DutyHistory::Entry &entry)
+{
+    QByteArray data(kRecordSize, '\0');
+    char *record = data.data();
+    qToLittleEndian<qint32>(qint32(entry.date.toJulianDay()), record);
+    qToLittleEndian<qint16>(qint16(entry.pair.first), record + 4);
+    qToLittleEndian<qint16>(qint16(entry.pair.second), record + 6);
+    record[8] = char(entry.roster);
+    record[9] = char(entry.reason);
+    qToLittleEndian<quint32>(quint32(qMax<qint64>(entry.recordedAt, 0)), record + 12);
+    return data;
+}
+
+DutyHistory::Entry decode(const uchar *record)
+{
+    DutyHistory::Entry entry;
+    entry.date = QDate::fromJulianDay(qFromLittleEndian<qint32>(record));
+    entry.pair = { qFromLittleEndian<qint16>(record + 4), qFromLittleEndian<qint16>(record + 6) };
+    entry.roster = record[8];
+    entry.reason = DutyHistory::Reason(record[9]);
+    entry.recordedAt = qFromLittleEndian<quint32>(record + 12);
+    return entry;
+}
+}
+
+DutyHistory::DutyHistory(const QString &filePath)
+    : path(filePath)
+    , file(filePath)
+{
+}
+
+DutyHistory::~DutyHistory()
+{
+    unmap();
+}
+
+bool DutyHistory::open()
+{
+    unmap();
+    valid = true;
+    if (!file.exists())
+        return true;
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    const qint64 size = file.size();
+    if (size < kHeaderSize) {
+        // 空文件或写文件头时中断，追加时重写
+        file.close();
+        return true;
+    }
+    mapped = file.map(0, size);
+    if (!mapped) {
+        file.close();
+        return false;
+    }
+    if (!std::equal(kMagic, kMagic + 4, reinterpret_cast<const char *>(mapped))
+        || qFromLittleEndian<quint16>(mapped + 6) != kRecordSize) {
+        qWarning() << "Unrecognized duty history file" << path;
+        valid = false;
+        unmap();
+        return false;
+    }
+    // 异常退出可能留下半条记录，读取时忽略
+    records = mapped + kHeaderSize;
+    count = int((size - kHeaderSize) / kRecordSize);
+    return true;
+}
+
+bool DutyHistory::append(const Entry &entry)
+{
+    if (!valid || !entry.date.isValid() || entry.roster < 0 || entry.roster > 0xFF)
+        return false;
+
+    // 按日期有序才能二分查找；只有系统时间被调回时才需要整份重写
+    const qint32 day = qint32(entry.date.toJulianDay());
+    if (count > 0 && dayAt(count - 1) > day)
+        return rewriteWith(entry);
+
+    unmap();
+    QFile out(path);
+    bool ok = out.open(QIODevice::ReadWrite);
+    if (ok) {
+        const qint64 size = out.size();
+        if (size < kHeaderSize)
+            ok = out.resize(0) && out.write(header()) == kHeaderSize;
+        else if ((size - kHeaderSize) % kRecordSize)
+            ok = out.resize(size - (size - kHeaderSize) % kRecordSize);
+        ok = ok && out.seek(out.size()) && out.write(encode(entry)) == kRecordSize && out.flush();
+        out.close();
+    }
+    if (ok)
+        Metrics::increment(Metrics::HistoryBytesWritten, kRecordSize);
+    else
+        qWarning() << "Failed to append duty history" << path << out.errorString();
+    open();
+    return ok;
+}
+
+DutyHistory::Entry DutyHistory::at(int index) const
+{
+    return decode(records + qint64(index) * kRecordSize);
+}
+
+DutyHistory::Entry DutyHistory::latest(int roster) const
+{
+    for (int i = count - 1; i >= 0; --i) {
+        if (records[qint64(i) * kRecordSize + 8] == roster)
+            return at(i);
+    }
+    return Entry();
+}
+
+QVector<DutyHistory::Entry> DutyHistory::entriesOn(const QDate &date, int roster) const
+{
+    return entriesBetween(date, date, roster);
+}
+
+QVector<DutyHistory::Entry> DutyHistory::entriesBetween(const QDate &from, const QDate &to, int roster) const
+{
+    QVector<Entry> entries;
+    if (!from.isValid() || !to.isValid() || to < from)
+        return entries;
+    const int end = lowerBound(qint32(to.toJulianDay()) + 1);
+    for (int i = lowerBound(qint32(from.toJulianDay())); i < end; ++i) {
+        if (roster < 0 || records[qint64(i) * kRecordSize + 8] == roster)
+            entries.append(at(i));
+    }
+    return entries;
+}
+
+const char *DutyHistory::reasonKey(Reason reason)
+{
+    switch (reason) {
+    case Auto: return "auto";
+    case Next: return "next";
+    case Previous: return "previous";
+    case Restore: return "restore";
+    case Sync: return "sync";
+    }
+    return "unknown";
+}
+
+QString DutyHistory::reasonLabel(Reason reason)
+{
+    switch (reason) {
+    case Auto: return QStringLiteral("换日");
+    case Next: return QStringLiteral("下一组");
+    case Previous: return QStringLiteral("上一组");
+    case Restore: return QStringLiteral("恢复");
+    case Sync: return QStringLiteral("同步");
+    }
+    return QStringLiteral("未知");
+}
+
+qint32 DutyHistory::dayAt(int index) const
+{
+    return qFromLittleEndian<qint32>(records + qint64(index) * kRecordSize);
+}
+
+int DutyHistory::lowerBound(qint32 day) const
+{
+    int low = 0;
+    int high = count;
+    while (low < high) {
+        const int middle = low + (high - low) / 2;
+        if (dayAt(middle) < day)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+bool DutyHistory::rewriteWith(const Entry &entry)
+{
+    const int position = lowerBound(qint32(entry.date.toJulianDay()) + 1);
+    QByteArray data = header();
+    data.reserve(kHeaderSize + (count + 1) * kRecordSize);
+    data.append(reinterpret_cast<const char *>(records), position * kRecordSize);
+    data.append(encode(entry));
+    data.append(reinterpret_cast<const char *>(records) + qint64(position) * kRecordSize, (count - position) * kRecordSize);
+
+    unmap();
+    QSaveFile out(path);
+    const bool ok = out.open(QIODevice::WriteOnly) && out.write(data) == data.size() && out.commit();
+    if (ok)
+        Metrics::increment(Metrics::HistoryBytesWritten, quint64(data.size()));
+    else
+        qWarning() << "Failed to rewrite duty history" << path;
+    open();
+    return ok;
+}
+
+void DutyHistory::unmap()
+{
+    if (mapped)
+        file.unmap(mapped);
+    mapped = nullptr;
+    records = nullptr;
+    count = 0;
+    file.close();
+}
@@ -0,0 +1,67 @@
+#ifndef DUTYHISTORY_H
+#define DUTYHISTORY_H
+
+#include "rotationengine.h"
+
+#include <QDate>
+#include <QFile>
+#include <QString>
+#include <QVector>
+
+// 值日历史：每次换日和手动调整追加一条定长记录，文件按日期有序，
+// 读取时整份映射到内存，按日期二分查找，几年的记录也只需几微秒
+class DutyHistory
+{
+public:
+    enum Reason : quint8 {
+        Auto = 1,  // 工作日换日
+        Next,      // 下一组
+        Previous,  // 上一组
+        Restore,   // 恢复到当天换日时的组合
+        Sync,      // 局域网内的权威节点同步来的组合
+    };
+
+    struct Entry {
+        QDate date;
+        int roster = 0;
+        RotationEngine::Pair pair;
+        Reason reason = Auto;
+        qint64 recordedAt = 0;  // 记录时的UTC秒数
+    };
+
+    explicit DutyHistory(const QString &filePath);
+    ~DutyHistory();
+    DutyHistory(const DutyHistory &) = delete;
+    DutyHistory &operator=(const DutyHistory &) = delete;
+
+    // 映射文件；文件不存在时为空，第一次追加时创建。格式不对时返回false，之后也不会写入
+    bool open();
+    bool append(const Entry &entry);
+
+    int size() const { return count; }
+    Entry at(int index) const;
+    // 某个名单最近的一条记录，没有时date无效
+    Entry latest(int roster) const;
+    // roster为-1时包括所有名单；结果按日期排序，同一天按记录的先后，最后一条是当天最终的组合
+    QVector<Entry> entriesOn(const QDate &date, int roster = -1) const;
+    QVector<Entry> entriesBetween(const QDate &from, const QDate &to, int roster = -1) const;
+
+    // JSON/CSV中的英文名和界面上显示的中文名
+    static const char *reasonKey(Reason reason);
+    static QString reasonLabel(Reason reason);
+
+private:
+    qint32 dayAt(int index) const;
+    int lowerBound(qint32 day) const;
+    bool rewriteWith(const Entry &entry);
+    void unmap();
+
+    QString path;
+    QFile file;
+    uchar *mapped = nullptr;
+    const uchar *records = nullptr;  // 文件头之后的第一条记录
+    int count = 0;
+    bool valid = true;
+};
+
+#endif // DUTYHISTORY_H
@@ -0,0 +1,401 @@
+#include "dutyplanner.h"
+#include "metrics.h"
+#include "roster.h"
+#include "workcalendar.h"
+
+#include <QRegularExpression>
+#include <algorithm>
+
+namespace {
+QDate parseDate(const QString &text)
+{
+    QDate date = QDate::fromString(text, "yyyy-MM-dd");
+    if (!date.isValid())
+        date = QDate::fromString(text, "yyyyMMdd");
+    return date;
+}
+
+int parsePerson(const QString &text, const Roster *roster)
+{
+    bool ok = false;
+    const int number = text.toInt(&ok);
+    if (ok)
+        return number >= 1 ? number - 1 : -1;
+    return roster ? roster->indexOfName(text) : -1;
+}
+}
+
+DutyPlanner::Constraints DutyPlanner::parse(const QByteArray &data, const Roster *roster, QStringList *errors)
+{
+    Constraints constraints;
+    QString text = QString::fromUtf8(data);
+    if (text.startsWith(QChar(0xFEFF)))
+        text.remove(0, 1);
+
+    static const QRegularExpression whitespace(QStringLiteral("\\s+"));
+    static const QRegularExpression rangeSeparator(QStringLiteral("\\.\\.|~"));
+    const QStringList lines = text.split('\n');
+    for (int lineNumber = 0; lineNumber < lines.size(); ++lineNumber) {
+        const QString line = lines[lineNumber].section('#', 0, 0).trimmed();
+        if (line.isEmpty())
+            continue;
+        const QStringList fields = line.split(whitespace);
+        const QString &keyword = fields.first();
+        bool ok = false;
+        if (keyword == "term" && fields.size() == 3) {
+            constraints.termStart = parseDate(fields[1]);
+            constraints.termEnd = parseDate(fields[2]);
+            ok = constraints.termStart.isValid() && constraints.termEnd >= constraints.termStart;
+        } else if (keyword == "start" && fields.size() == 2) {
+            constraints.startPerson = parsePerson(fields[1], roster);
+            ok = constraints.startPerson >= 0;
+            constraints.startPerson = qMax(0, constraints.startPerson);
+        } else if (keyword == "absent" && fields.size() == 3) {
+            const QStringList bounds = fields[2].split(rangeSeparator);
+            Absence absence;
+            absence.person = parsePerson(fields[1], roster);
+            absence.from = parseDate(bounds.first());
+            absence.to = bounds.size() == 2 ? parseDate(bounds.last()) : absence.from;
+            ok = absence.person >= 0 && absence.from.isValid() && absence.to >= absence.from && bounds.size() <= 2;
+            if (ok)
+                constraints.absences.append(absence);
+        } else if (keyword == "swap" && fields.size() == 4) {
+            const Swap swap{ parseDate(fields[1]), parsePerson(fields[2], roster), parsePerson(fields[3], roster) };
+            ok = swap.date.isValid() && swap.out >= 0 && swap.in >= 0 && swap.out != swap.in;
+            if (ok)
+                constraints.swaps.append(swap);
+        } else if (keyword == "apart" && fields.size() == 3) {
+            const int first = parsePerson(fields[1], roster);
+            const int second = parsePerson(fields[2], roster);
+            ok = first >= 0 && second >= 0 && first != second;
+            if (ok)
+                constraints.exclusions.append({ qMin(first, second), qMax(first, second) });
+        }
+        if (!ok && errors)
+            errors->append(QStringLiteral("第%1行：%2").arg(lineNumber + 1).arg(line));
+    }
+    return constraints;
+}
+
+void DutyPlanner::setCalendar(const WorkCalendar *calendar)
+{
+    this->calendar = calendar;
+    rebuildDays();
+}
+
+void DutyPlanner::setPersons(int persons)
+{
+    persons = qBound(0, persons, 0x7FFF);
+    if (this->persons == persons)
+        return;
+    this->persons = persons;
+    // 编号的含义变了，旧计划不能用来判断收敛
+    plan.fill({ -1, -1 });
+    rebuildConstraints();
+    markDirty(0, dayCount() - 1);
+}
+
+void DutyPlanner::setConstraints(const Constraints &constraints)
+{
+    const Constraints previous = current;
+    current = constraints;
+    if (previous.termStart != constraints.termStart || previous.termEnd != constraints.termEnd)
+        rebuildDays();
+    rebuildConstraints();
+    if (previous.startPerson != constraints.startPerson) {
+        markDirty(0, dayCount() - 1);
+        return;
+    }
+
+    // 只有增删的约束所在的日子需要重排
+    for (const Absence &absence : previous.absences) {
+        if (!constraints.absences.contains(absence))
+            markDirty(absence.from, absence.to);
+    }
+    for (const Absence &absence : constraints.absences) {
+        if (!previous.absences.contains(absence))
+            markDirty(absence.from, absence.to);
+    }
+    for (const Swap &swap : previous.swaps) {
+        if (!constraints.swaps.contains(swap))
+            markDirty(swap.date, swap.date);
+    }
+    for (const Swap &swap : constraints.swaps) {
+        if (!previous.swaps.contains(swap))
+            markDirty(swap.date, swap.date);
+    }
+    for (const Exclusion &exclusion : constraints.exclusions) {
+        if (previous.exclusions.contains(exclusion))
+            continue;
+        // 新加的限制只影响原计划中这两人同一天的日子
+        for (int day = 0; day < dayCount(); ++day) {
+            const RotationEngine::Pair &pair = plan[day];
+            if (pairKey(pair.first, pair.second) == pairKey(exclusion.first, exclusion.second))
+                markDirty(day, day);
+        }
+    }
+    for (const Exclusion &exclusion : previous.exclusions) {
+        // 去掉限制后哪天会不同无法事先知道
+        if (!constraints.exclusions.contains(exclusion))
+            markDirty(0, dayCount() - 1);
+    }
+}
+
+void DutyPlanner::setManualStep(const QDate &date, int steps)
+{
+    if (!date.isValid() || steps == 0) {
+        if (manualDay >= 0)
+            markDirty(manualDay, manualDay);
+        manualDate = QDate();
+        manualSteps = 0;
+        manualDay = -1;
+        return;
+    }
+    if (date == manualDate && steps == manualSteps)
+        return;
+    if (manualDay >= 0)
+        markDirty(manualDay, manualDay);
+    manualDate = date;
+    manualSteps = steps;
+    const int day = indexOf(date);
+    manualDay = day >= 0 && days[day] == date.toJulianDay() ? day : -1;
+    if (manualDay >= 0)
+        markDirty(manualDay, manualDay);
+}
+
+int DutyPlanner::update()
+{
+    if (dirtyFrom < 0 || days.isEmpty() || persons < 1) {
+        dirtyFrom = dirtyTo = -1;
+        return 0;
+    }
+
+    // 受影响的第一天之前的计划不变，从那里开始重排，同时沿原计划推进以判断何时重新一致
+    Tally tally;
+    initTally(tally);
+    for (int day = 0; day < dirtyFrom; ++day)
+        apply(tally, plan[day], day);
+    Tally previousTally = tally;
+    QVector<bool> differs(persons, false);
+    int mismatched = 0;
+
+    int replanned = 0;
+    for (int day = dirtyFrom; day < dayCount(); ++day) {
+        quint8 issue = 0;
+        const RotationEngine::Pair pair = choose(day, tally, &issue);
+        const RotationEngine::Pair previous = plan[day];
+        plan[day] = pair;
+        issues[day] = issue;
+        apply(tally, pair, day);
+        apply(previousTally, previous, day);
+        ++replanned;
+
+        for (int person : { pair.first, pair.second, previous.first, previous.second }) {
+            if (person < 0)
+                continue;
+            const bool differ = tally.count[person] != previousTally.count[person]
+                || tally.last[person] != previousTally.last[person];
+            if (differ != differs[person]) {
+                differs[person] = differ;
+                mismatched += differ ? 1 : -1;
+            }
+        }
+        // 之后的约束没变，状态一致时原计划就是重排的结果
+        if (day >= dirtyTo && mismatched == 0)
+            break;
+    }
+    dirtyFrom = dirtyTo = -1;
+    Metrics::increment(Metrics::PlanDaysReplanned, quint64(replanned));
+    return replanned;
+}
+
+int DutyPlanner::indexOf(const QDate &date) const
+{
+    if (days.isEmpty() || !date.isValid() || date > current.termEnd)
+        return -1;
+    const qint64 julianDay = date.toJulianDay();
+    return int(std::upper_bound(days.cbegin(), days.cend(), julianDay) - days.cbegin()) - 1;
+}
+
+int DutyPlanner::dutyCount(int person) const
+{
+    int count = 0;
+    for (const RotationEngine::Pair &pair : plan) {
+        if (pair.first == person || pair.second == person)
+            ++count;
+    }
+    return count;
+}
+
+void DutyPlanner::rebuildDays()
+{
+    QVector<qint32> workdays;
+    if (current.termStart.isValid() && current.termEnd >= current.termStart) {
+        for (QDate date = current.termStart; date <= current.termEnd; date = date.addDays(1)) {
+            if (calendar ? calendar->isWorkday(date) : date.dayOfWeek() <= 5)
+                workdays.append(qint32(date.toJulianDay()));
+        }
+    }
+    if (workdays == days)
+        return;
+    days = workdays;
+    plan.fill({ -1, -1 }, days.size());
+    issues.fill(0, days.size());
+    rebuildConstraints();
+    markDirty(0, dayCount() - 1);
+}
+
+void DutyPlanner::rebuildConstraints()
+{
+    blocked = QVector<QVector<qint16>>(days.size());
+    pinned = QVector<QVector<qint16>>(days.size());
+    apart.clear();
+    blockStamp.fill(0, persons);
+    generation = 0;
+
+    const auto inRange = [this](int person) { return person >= 0 && person < persons; };
+    for (const Absence &absence : current.absences) {
+        if (!inRange(absence.person))
+            continue;
+        const int first = indexOf(absence.from.addDays(-1)) + 1;
+        const int last = indexOf(qMin(absence.to, current.termEnd));
+        for (int day = first; day <= last; ++day)
+            blocked[day].append(qint16(absence.person));
+    }
+    for (const Swap &swap : current.swaps) {
+        const int day = indexOf(swap.date);
+        if (day < 0 || days[day] != swap.date.toJulianDay() || !inRange(swap.out) || !inRange(swap.in))
+            continue;
+        blocked[day].append(qint16(swap.out));
+        pinned[day].append(qint16(swap.in));
+    }
+    for (const Exclusion &exclusion : current.exclusions) {
+        if (inRange(exclusion.first) && inRange(exclusion.second))
+            apart.insert(pairKey(exclusion.first, exclusion.second));
+    }
+    const int day = indexOf(manualDate);
+    manualDay = manualSteps != 0 && day >= 0 && days[day] == manualDate.toJulianDay() ? day : -1;
+}
+
+void DutyPlanner::markDirty(int from, int to)
+{
+    if (from > to || to < 0)
+        return;
+    dirtyFrom = dirtyFrom < 0 ? from : qMin(dirtyFrom, from);
+    dirtyTo = qMax(dirtyTo, to);
+}
+
+void DutyPlanner::markDirty(const QDate &from, const QDate &to)
+{
+    // indexOf对休息日取之前的工作日，起点要取之后的第一个工作日
+    markDirty(indexOf(from.addDays(-1)) + 1, indexOf(qMin(to, current.termEnd)));
+}
+
+void DutyPlanner::initTally(Tally &tally) const
+{
+    tally.count.fill(0, persons);
+    tally.last.resize(persons);
+    for (int person = 0; person < persons; ++person)
+        tally.last[person] = rank(person) - persons;
+}
+
+void DutyPlanner::apply(Tally &tally, const RotationEngine::Pair &pair, int day)
+{
+    for (int person : { pair.first, pair.second }) {
+        if (person < 0)
+            continue;
+        ++tally.count[person];
+        tally.last[person] = day;
+    }
+}
+
+RotationEngine::Pair DutyPlanner::choose(int day, const Tally &tally, quint8 *issue)
+{
+    if (++generation == 0) {
+        blockStamp.fill(0);
+        generation = 1;
+    }
+    for (qint16 person : std::as_const(blocked[day]))
+        blockStamp[person] = generation;
+
+    RotationEngine::Pair pair{ -1, -1 };
+    int chosen = 0;
+    const auto take = [&pair, &chosen](int person) {
+        (chosen == 0 ? pair.first : pair.second) = person;
+        ++chosen;
+    };
+
+    // 代班的人优先
+    for (qint16 person : std::as_const(pinned[day])) {
+        if (person == pair.first)
+            continue;
+        if (blockStamp[person] == generation) {
+            *issue |= PinnedAbsent;
+        } else if (chosen == 2 || (chosen == 1 && excluded(pair.first, person))) {
+            *issue |= PinnedApart;
+        } else {
+            take(person);
+        }
+    }
+
+    // 手动调整的那天：能值日的人按公平顺序排好，跳过前面的几组；往回时从顺序末尾取
+    if (day == manualDay && chosen < 2) {
+        QVector<int> order;
+        for (int person = 0; person < persons; ++person) {
+            if (blockStamp[person] != generation && person != pair.first)
+                order.append(person);
+        }
+        std::sort(order.begin(), order.end(), [this, &tally](int a, int b) { return better(a, b, tally); });
+        const int count = int(order.size());
+        if (count > 0) {
+            const int start = int(((qint64(manualSteps) * (2 - chosen)) % count + count) % count);
+            for (int i = 0; i < count && chosen < 2; ++i) {
+                const int person = order[(start + i) % count];
+                if (chosen == 1 && excluded(pair.first, person))
+                    continue;
+                take(person);
+            }
+        }
+    }
+
+    while (chosen < 2) {
+        int best = -1;
+        for (int person = 0; person < persons; ++person) {
+            if (blockStamp[person] == generation || person == pair.first || (chosen == 1 && excluded(pair.first, person)))
+                continue;
+            if (best < 0 || better(person, best, tally))
+                best = person;
+        }
+        if (best < 0) {
+            *issue |= Understaffed;
+            break;
+        }
+        take(best);
+    }
+    return pair;
+}
+
+bool DutyPlanner::better(int a, int b, const Tally &tally) const
+{
+    if (tally.count[a] != tally.count[b])
+        return tally.count[a] < tally.count[b];
+    if (tally.last[a] != tally.last[b])
+        return tally.last[a] < tally.last[b];
+    return rank(a) < rank(b);
+}
+
+bool DutyPlanner::excluded(int a, int b) const
+{
+    return !apart.isEmpty() && apart.contains(pairKey(a, b));
+}
+
+int DutyPlanner::rank(int person) const
+{
+    const int start = current.startPerson % persons;
+    return (person - start + persons) % persons;
+}
+
+quint32 DutyPlanner::pairKey(int a, int b)
+{
+    return (quint32(quint16(qMin(a, b))) << 16) | quint16(qMax(a, b));
+}
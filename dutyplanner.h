@@ -0,0 +1,127 @@
+#ifndef DUTYPLANNER_H
+#define DUTYPLANNER_H
+
+#include "rotationengine.h"
+
+#include <QByteArray>
+#include <QDate>
+#include <QSet>
+#include <QStringList>
+#include <QVector>
+
+class Roster;
+class WorkCalendar;
+
+// 按约束排一个学期的值日：请假、换班和不排在同一天的两人。
+// 每个工作日从能值日的人中选值日次数最少的两人，次数相同时选上次值日最早的，再相同时按名单顺序，
+// 因此没有约束时与原来的轮换一致，人数为奇数时也是每人次数相差不超过1、间隔均匀。
+// 约束变化时只从受影响的第一天开始重排，排到与原计划的状态重新一致就停止
+class DutyPlanner
+{
+public:
+    struct Absence {
+        int person = 0;
+        QDate from;
+        QDate to;
+        bool operator==(const Absence &other) const { return person == other.person && from == other.from && to == other.to; }
+    };
+
+    // in代替out在date值日，out之后会因为次数少而被提前补上
+    struct Swap {
+        QDate date;
+        int out = 0;
+        int in = 0;
+        bool operator==(const Swap &other) const { return date == other.date && out == other.out && in == other.in; }
+    };
+
+    // 两人不排在同一天
+    struct Exclusion {
+        int first = 0;
+        int second = 0;
+        bool operator==(const Exclusion &other) const { return first == other.first && second == other.second; }
+    };
+
+    struct Constraints {
+        QDate termStart;
+        QDate termEnd;
+        int startPerson = 0;  // 学期第一天的第一个人
+        QVector<Absence> absences;
+        QVector<Swap> swaps;
+        QVector<Exclusion> exclusions;
+    };
+
+    // 某天无法按约束排好的原因
+    enum Issue : quint8 {
+        Understaffed = 0x01,   // 能值日的人不到两个
+        PinnedAbsent = 0x02,   // 代班的人这天请假
+        PinnedApart = 0x04,    // 两个代班的人不能排在同一天，或者超过两个
+    };
+
+    // 约束文件每行一条，#之后为注释；人员写编号（从1开始）或名单中的姓名，日期为yyyy-MM-dd：
+    //   term 2025-09-01 2026-01-16
+    //   start 1
+    //   absent 张三 2025-10-08[~2025-10-10]
+    //   swap 2025-10-15 张三 李四
+    //   apart 张三 李四
+    // roster为空时只能写编号；无法识别的行跳过并记入errors
+    static Constraints parse(const QByteArray &data, const Roster *roster, QStringList *errors = nullptr);
+
+    // 日历由调用者持有，节假日变化后需要再次调用
+    void setCalendar(const WorkCalendar *calendar);
+    void setPersons(int persons);
+    void setConstraints(const Constraints &constraints);
+    const Constraints &constraints() const { return current; }
+    // 学期内手动“上一组/下一组”：date这天按公平顺序跳过前面steps组（负数时从刚值日过的人往回取），
+    // 之后的日子随之重排。只记一天，date无效或steps为0时取消
+    void setManualStep(const QDate &date, int steps);
+    // 排好以上修改影响的日子，返回重排的天数
+    int update();
+
+    bool isEmpty() const { return days.isEmpty(); }
+    int dayCount() const { return int(days.size()); }
+    QDate dayAt(int day) const { return QDate::fromJulianDay(days[day]); }
+    // date在学期中的工作日序号，休息日取之前最近的工作日；学期之外为-1
+    int indexOf(const QDate &date) const;
+    // 没有人可排时为-1
+    RotationEngine::Pair pairAt(int day) const { return plan[day]; }
+    quint8 issuesAt(int day) const { return issues[day]; }
+    // 整个学期的值日次数
+    int dutyCount(int person) const;
+
+private:
+    struct Tally {
+        QVector<int> count;
+        QVector<int> last;  // 上次值日的序号，开始前按名单顺序为负数
+    };
+
+    void rebuildDays();
+    void rebuildConstraints();
+    void markDirty(int from, int to);
+    void markDirty(const QDate &from, const QDate &to);
+    void initTally(Tally &tally) const;
+    static void apply(Tally &tally, const RotationEngine::Pair &pair, int day);
+    RotationEngine::Pair choose(int day, const Tally &tally, quint8 *issue);
+    bool better(int a, int b, const Tally &tally) const;
+    bool excluded(int a, int b) const;
+    int rank(int person) const;
+    static quint32 pairKey(int a, int b);
+
+    const WorkCalendar *calendar = nullptr;
+    int persons = 0;
+    Constraints current;
+    QVector<qint32> days;  // 学期中每个工作日的儒略日
+    QVector<RotationEngine::Pair> plan;
+    QVector<quint8> issues;
+    QVector<QVector<qint16>> blocked;  // 每天请假或被代班的人
+    QVector<QVector<qint16>> pinned;   // 每天代班的人
+    QSet<quint32> apart;
+    QDate manualDate;
+    int manualSteps = 0;
+    int manualDay = -1;       // manualDate在学期中的序号，不是学期中的工作日时为-1
+    QVector<quint32> blockStamp;  // 排某天时标记这天不能值日的人
+    quint32 generation = 0;
+    int dirtyFrom = -1;       // 需要重排的范围，-1表示没有
+    int dirtyTo = -1;
+};
+
+#endif // DUTYPLANNER_H
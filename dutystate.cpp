@@ -0,0 +1,514 @@
+#include "dutystate.h"
+#include "configstore.h"
+
+#include <QDir>
+#include <QFile>
+#include <QDebug>
+#include <QFileInfo>
+#include <cstring>
+
+namespace {
+// 第一个名单沿用原来的键，其余名单的键放在 rosterN 分组中
+struct RosterKey {
+    const char *name;
+    const char *legacyKey;
+};
+
+const RosterKey kRosterKeys[] = {
+    { "file", "settings/rosterFile" },
+    { "planFile", "settings/planFile" },
+    { "title", "settings/rosterTitle" },
+    { "totalPersons", "settings/totalPersons" },
+    { "lastUpdate", "date/lastUpdate" },
+    { "anchorDate", "rotation/anchorDate" },
+    { "anchorIndex1", "rotation/anchorIndex1" },
+    { "anchorIndex2", "rotation/anchorIndex2" },
+    { "offset", "rotation/offset" },
+    { "originOffset", "rotation/originOffset" },
+    { "pinDate", "rotation/pinDate" },
+    { "pinSteps", "rotation/pinSteps" },
+    { "index1", "duty/index1" },
+    { "index2", "duty/index2" },
+};
+
+// 轮换字段在配置中的名称，运行中修改时逐项改入状态
+struct RotationKey {
+    const char *name;
+    StateJournal::Field field;
+};
+
+const RotationKey kRotationKeys[] = {
+    { "lastUpdate", StateJournal::LastUpdate },
+    { "anchorDate", StateJournal::AnchorDate },
+    { "anchorIndex1", StateJournal::AnchorIndex1 },
+    { "anchorIndex2", StateJournal::AnchorIndex2 },
+    { "offset", StateJournal::ManualOffset },
+    { "originOffset", StateJournal::OriginOffset },
+    { "pinDate", StateJournal::PinDate },
+    { "pinSteps", StateJournal::PinSteps },
+};
+
+// 改变后需要重新读取名单设置的键
+const char *const kRosterSettingNames[] = { "file", "title", "totalPersons", "planFile" };
+
+QString rosterKey(int index, const char *name)
+{
+    if (index == 0) {
+        for (const RosterKey &key : kRosterKeys) {
+            if (std::strcmp(key.name, name) == 0)
+                return QLatin1String(key.legacyKey);
+        }
+    }
+    return QStringLiteral("roster%1/%2").arg(index + 1).arg(QLatin1String(name));
+}
+
+qint32 dateStamp(const QDate &date)
+{
+    return date.year() * 10000 + date.month() * 100 + date.day();
+}
+}
+
+DutyState::DutyState()
+    : rosters(1)
+    , rosterFiles(1)
+    , planners(1)
+{
+}
+
+void DutyState::readSettings(const ConfigStore &config, const QString &baseDir)
+{
+    const int count = qBound(1, config.value("settings/rosterCount", 1).toInt(), int(StateJournal::MaxRosters));
+    rosters.resize(count);
+    rosterFiles.resize(count);
+    planners.resize(count);
+    for (int i = 0; i < count; ++i) {
+        RosterFile &file = rosterFiles[i];
+        file.fileName = config.value(rosterKey(i, "file"), i == 0 ? QStringLiteral("roster.csv") : QStringLiteral("roster%1.csv").arg(i + 1)).toString();
+        file.filePath = QDir(baseDir).absoluteFilePath(file.fileName);
+        file.planFileName = config.value(rosterKey(i, "planFile")).toString();
+        file.planFilePath = file.planFileName.isEmpty() ? QString() : QDir(baseDir).absoluteFilePath(file.planFileName);
+        file.title = config.value(rosterKey(i, "title"), i == 0 ? QStringLiteral("值日安排") : QFileInfo(file.fileName).completeBaseName()).toString();
+        rosters[i].totalPersons = qint16(qBound(2, config.value(rosterKey(i, "totalPersons"), 47).toInt(), 0x7FFF));
+    }
+    current = qBound(0, config.value("settings/currentRoster", 0).toInt(), count - 1);
+
+    holidayFileName = config.value("settings/holidayFile", "holidays.txt").toString();
+    holidayFilePath = QDir(baseDir).absoluteFilePath(holidayFileName);
+}
+
+void DutyState::writeSettings(ConfigStore &config) const
+{
+    config.setValue("settings/rosterCount", rosterCount());
+    config.setValue("settings/currentRoster", current);
+    for (int i = 0; i < rosterCount(); ++i) {
+        config.setValue(rosterKey(i, "file"), rosterFiles[i].fileName);
+        config.setValue(rosterKey(i, "title"), rosterFiles[i].title);
+        config.setValue(rosterKey(i, "planFile"), rosterFiles[i].planFileName);
+        config.setValue(rosterKey(i, "totalPersons"), rosters[i].totalPersons);
+    }
+    config.setValue("settings/holidayFile", holidayFileName);
+}
+
+QString DutyState::configHeader()
+{
+    return QStringLiteral(
+        "; 值日安排配置文件\n; index1 和 index2 是当前值日的编号（从0开始，由rotation字段算出，仅供查看）\n; lastUpdate 是上次更新的日期，格式为yyyyMMdd\n"
+        "; anchorDate/anchorIndex1/anchorIndex2 是轮换的锚点：该日期当天的两人，之后每个工作日前进两人\n"
+        "; offset 是学期之外手动“上一组/下一组”累计的步数，originOffset 是当天换日时的步数\n"
+        "; 值日状态的最新变化先记录在 duty_state.journal 中，seq 是已合并进本文件的日志序号\n"
+        "; testMode 指考试模式，考试期间不轮换\n; totalPersons 是总人数（有名单时以名单为准）\n; isStartupLaunch 是开机启动状态\n"
+        "; rosterFile 是名单文件（CSV或TSV：姓名,学号[,分组]），相对路径以程序目录为准，rosterTitle 是显示的标题\n"
+        "; rosterCount 是名单个数；第2个起的名单在 [roster2]、[roster3]… 中，有 file、title、totalPersons 和各自的轮换字段\n"
+        "; currentRoster 是当前显示的名单（从0开始），cycleRosters 为true时每 cycleSeconds 秒轮流显示\n"
+        "; planFile 是约束文件，设置后学期内按约束排值日：每行 term 开始 结束 / start 人 / absent 人 日期[~日期] / swap 日期 原值日人 代班人 / apart 人 人，\n"
+        ";   人写编号（从1开始）或姓名；学期内手动“上一组/下一组”记为 pinDate 这天跳过 pinSteps 组，之后的日子随之重排\n"
+        "; holidayFile 是节假日文件：ICS日历，或每行“日期[~结束日期] [天数] 休|班”的表格，覆盖内置的节假日表\n"
+        "; resyncMinutes 是NTP重新校时间隔（分钟），offsetMs 和 lastSync 是上次校时的结果\n"
+        "; [peer] 局域网同步：enabled 为true时同一 room 的电脑选出一台权威节点，由它校时和换日，其余电脑跟随它的时间和状态；\n"
+        ";   group/port 是组播地址和端口，priority 大的优先成为权威节点，interface 为空时使用默认网卡\n"
+        "; 程序运行时也可以修改本文件，保存后只应用改动的项，不需要重启\n"
+        "; 检查系统中是否开启Deepfreeze，如有，请使用MeltdownDFC工具关闭后再使用本程序！\n");
+}
+
+bool DutyState::restore(const ConfigStore &config, StateJournal &journal, const QDate &today, bool repairJournal)
+{
+    // 旧版本保存的是当前编号和当天的原始编号，只用于迁移第一个名单
+    RotationEngine::Pair legacyCurrent{ config.value("duty/index1", 0).toInt(), config.value("duty/index2", 1).toInt() };
+    RotationEngine::Pair legacyOrigin{ config.value("origin/index1", legacyCurrent.first).toInt(),
+                                       config.value("origin/index2", legacyCurrent.second).toInt() };
+    isTestingMode = config.value("settings/testingMode", false).toBool();
+
+    for (int i = 0; i < rosterCount(); ++i)
+        readRotation(config, i);
+
+    // 在快照之上重放日志中更新的状态；已经删掉的名单的记录忽略
+    const QList<StateJournal::Record> records = journal.replay(config.value("journal/seq", 0).toUInt(), repairJournal);
+    for (const StateJournal::Record &record : records) {
+        if (record.roster >= rosterCount())
+            continue;
+        switch (record.field) {
+        case StateJournal::DutyIndex1: legacyCurrent.first = int(record.value); break;
+        case StateJournal::DutyIndex2: legacyCurrent.second = int(record.value); break;
+        case StateJournal::OriginIndex1: legacyOrigin.first = int(record.value); break;
+        case StateJournal::OriginIndex2: legacyOrigin.second = int(record.value); break;
+        default: applyField(record.field, record.value, record.roster); break;
+        }
+    }
+
+    bool migrated = false;
+    for (int i = 0; i < rosterCount(); ++i) {
+        RosterState &state = rosters[i];
+        if (state.anchorDay)
+            continue;
+        migrated = true;
+        if (i > 0) {
+            // 新加的名单从今天的第1、2号开始
+            state.anchorDay = qint32(today.toJulianDay());
+            state.anchorIndex1 = 0;
+            state.anchorIndex2 = 1;
+            continue;
+        }
+        // 旧配置：以上次更新日期和当天的原始组合为锚点，手动调整换算成步数
+        QDate anchorDate = QDate::fromString(QString::number(state.lastUpdate), "yyyyMMdd");
+        if (!anchorDate.isValid())
+            anchorDate = today;
+        state.anchorDay = qint32(anchorDate.toJulianDay());
+        state.anchorIndex1 = qint16(legacyOrigin.first);
+        state.anchorIndex2 = qint16(legacyOrigin.second);
+        state.originOffset = 0;
+        if (const std::optional<qint64> steps = rotation(i).stepsToPair(legacyCurrent)) {
+            state.manualOffset = qint32(*steps);
+            continue;
+        }
+        // 当前组合不在从原始组合出发的轮换上（如奇数人数或手动改过编号）：以当前组合为锚点，不再有手动步数
+        qWarning() << "Legacy pair" << legacyCurrent.first << legacyCurrent.second
+                   << "is not reachable from" << legacyOrigin.first << legacyOrigin.second << ", anchoring on it";
+        state.anchorIndex1 = qint16(legacyCurrent.first);
+        state.anchorIndex2 = qint16(legacyCurrent.second);
+        state.manualOffset = 0;
+    }
+
+    return migrated || !records.isEmpty();
+}
+
+int DutyState::applyChangedKeys(const ConfigStore &config, const QStringList &keys, const QString &baseDir, const QDate &today)
+{
+    int scope = ReloadNone;
+    for (const QString &key : keys) {
+        if (key == QLatin1String("settings/testingMode")) {
+            setTestingMode(config.value(key, false).toBool(), today);
+            scope |= ReloadState;
+            continue;
+        }
+        if (key == QLatin1String("settings/holidayFile")) {
+            scope |= ReloadRosters | ReloadCalendar;
+            continue;
+        }
+        if (key == QLatin1String("settings/rosterCount") || key == QLatin1String("settings/currentRoster")) {
+            scope |= ReloadRosters;
+            continue;
+        }
+        for (int i = 0; i < int(StateJournal::MaxRosters); ++i) {
+            for (const char *name : kRosterSettingNames) {
+                if (key == rosterKey(i, name))
+                    scope |= ReloadRosters;
+            }
+            if (i >= rosterCount())
+                continue;
+            for (const RotationKey &rotationKey : kRotationKeys) {
+                if (key != rosterKey(i, rotationKey.name))
+                    continue;
+                const QString text = config.value(key).toString();
+                qint64 value = text.toLongLong();
+                if (rotationKey.field == StateJournal::AnchorDate || rotationKey.field == StateJournal::PinDate) {
+                    const QDate date = QDate::fromString(text, "yyyyMMdd");
+                    value = date.isValid() ? date.toJulianDay() : 0;
+                }
+                applyField(rotationKey.field, value, i);
+                scope |= ReloadState;
+            }
+        }
+    }
+
+    if (scope & ReloadRosters) {
+        const int previousCount = rosterCount();
+        readSettings(config, baseDir);
+        for (int i = previousCount; i < rosterCount(); ++i) {
+            readRotation(config, i);
+            if (!rosters[i].anchorDay) {
+                rosters[i].anchorDay = qint32(today.toJulianDay());
+                rosters[i].anchorIndex1 = 0;
+                rosters[i].anchorIndex2 = 1;
+            }
+        }
+        if (rosterCount() != previousCount)
+            scope |= ReloadState;
+    }
+    return scope;
+}
+
+void DutyState::writeSnapshot(ConfigStore &config, const QDate &today) const
+{
+    config.setValue("settings/testingMode", isTestingMode);
+
+    for (int i = 0; i < rosterCount(); ++i) {
+        const RosterState &state = rosters[i];
+        config.setValue(rosterKey(i, "lastUpdate"), state.lastUpdate ? QString::number(state.lastUpdate) : QString());
+        config.setValue(rosterKey(i, "anchorDate"), state.anchorDay ? QDate::fromJulianDay(state.anchorDay).toString("yyyyMMdd") : QString());
+        config.setValue(rosterKey(i, "anchorIndex1"), state.anchorIndex1);
+        config.setValue(rosterKey(i, "anchorIndex2"), state.anchorIndex2);
+        config.setValue(rosterKey(i, "offset"), state.manualOffset);
+        config.setValue(rosterKey(i, "originOffset"), state.originOffset);
+        config.setValue(rosterKey(i, "pinDate"), state.pinDay ? QDate::fromJulianDay(state.pinDay).toString("yyyyMMdd") : QString());
+        config.setValue(rosterKey(i, "pinSteps"), state.pinSteps);
+
+        // 当前编号只供查看，由轮换字段算出
+        const RotationEngine::Pair pair = pairFor(today, i);
+        config.setValue(rosterKey(i, "index1"), pair.first);
+        config.setValue(rosterKey(i, "index2"), pair.second);
+    }
+    config.remove("origin/index1");
+    config.remove("origin/index2");
+}
+
+bool DutyState::advance(const QDate &today)
+{
+    const qint32 stamp = dateStamp(today);
+    bool changed = false;
+    for (int i = 0; i < rosterCount(); ++i) {
+        RosterState &state = rosters[i];
+        if (state.lastUpdate == stamp)
+            continue;
+        // 组合由日期直接算出，这里只记下当天的原始组合（供“恢复”使用）
+        const RotationEngine::Pair pair = rotation(i).pairFor(today);
+        state.lastUpdate = stamp;
+        state.originOffset = state.manualOffset;
+        state.anchorDay = qint32(today.toJulianDay());
+        state.anchorIndex1 = qint16(pair.first);
+        state.anchorIndex2 = qint16(pair.second);
+        changed = true;
+    }
+    return changed;
+}
+
+void DutyState::setTestingMode(bool on, const QDate &today)
+{
+    if (isTestingMode == on)
+        return;
+    const qint32 stamp = dateStamp(today);
+    for (int i = 0; i < rosterCount(); ++i) {
+        RosterState &state = rosters[i];
+        if (!state.anchorDay)
+            continue;
+        // 今天还没换日时，今天不算进轮换
+        const QDate lastRolled = state.lastUpdate == stamp ? today : today.addDays(-1);
+        if (on) {
+            const RotationEngine::Pair pair = rotation(i).pairFor(lastRolled);
+            state.anchorIndex1 = qint16(pair.first);
+            state.anchorIndex2 = qint16(pair.second);
+        }
+        // 退出时组合不变，只把锚点移过考试期间的日子
+        state.anchorDay = qint32(lastRolled.toJulianDay());
+    }
+    isTestingMode = on;
+}
+
+void DutyState::stepDuty(int steps, const QDate &today)
+{
+    RosterState &state = rosters[current];
+    const DutyPlanner &planner = planners[current];
+    const int day = planner.indexOf(today);
+    if (day < 0) {
+        state.manualOffset += steps;
+        return;
+    }
+    const qint32 pinDay = qint32(planner.dayAt(day).toJulianDay());
+    state.pinSteps = state.pinDay == pinDay ? state.pinSteps + steps : steps;
+    state.pinDay = state.pinSteps ? pinDay : 0;
+    applyPin(current);
+}
+
+void DutyState::restoreDuty(const QDate &today)
+{
+    RosterState &state = rosters[current];
+    const DutyPlanner &planner = planners[current];
+    const int day = planner.indexOf(today);
+    if (day >= 0 && state.pinDay == planner.dayAt(day).toJulianDay()) {
+        state.pinDay = 0;
+        state.pinSteps = 0;
+        applyPin(current);
+    }
+    state.manualOffset = state.originOffset;
+}
+
+bool DutyState::loadRoster(int index)
+{
+    Roster loaded;
+    Roster &target = index == current ? roster : loaded;
+    const QString &filePath = rosterFiles[index].filePath;
+    if (!target.load(filePath) || target.size() < 2) {
+        target.clear();
+        loadPlan(index, &target);
+        return false;
+    }
+    qDebug() << "Loaded roster" << filePath << "with" << target.size() << "persons";
+
+    const qint16 persons = qint16(qMin(target.size(), 0x7FFF));
+    const bool changed = rosters[index].totalPersons != persons;
+    rosters[index].totalPersons = persons;
+    loadPlan(index, &target);
+    return changed;
+}
+
+void DutyState::loadCalendar()
+{
+    calendar.load(holidayFilePath);
+    for (DutyPlanner &planner : planners) {
+        planner.setCalendar(&calendar);
+        planner.update();
+    }
+}
+
+int DutyState::loadPlan(int index, const Roster *names)
+{
+    DutyPlanner::Constraints constraints;
+    const QString &filePath = rosterFiles[index].planFilePath;
+    QFile file(filePath);
+    if (!filePath.isEmpty() && file.open(QIODevice::ReadOnly)) {
+        Roster loaded;
+        if (!names)
+            names = index == current ? &roster : (loaded.load(rosterFiles[index].filePath) ? &loaded : nullptr);
+        QStringList errors;
+        constraints = DutyPlanner::parse(file.readAll(), names, &errors);
+        for (const QString &error : std::as_const(errors))
+            qWarning() << "Ignored plan line in" << filePath << error;
+    }
+
+    DutyPlanner &planner = planners[index];
+    planner.setCalendar(&calendar);
+    planner.setPersons(rosters[index].totalPersons);
+    planner.setConstraints(constraints);
+    planner.setManualStep(rosters[index].pinDay ? QDate::fromJulianDay(rosters[index].pinDay) : QDate(), rosters[index].pinSteps);
+    const int replanned = planner.update();
+    if (replanned)
+        qDebug() << "Replanned" << replanned << "days of roster" << index + 1;
+    return replanned;
+}
+
+bool DutyState::loadRosters()
+{
+    bool changed = false;
+    for (int i = 0; i < rosterCount(); ++i)
+        changed = loadRoster(i) || changed;
+    return changed;
+}
+
+bool DutyState::selectRoster(int index)
+{
+    if (index < 0 || index >= rosterCount())
+        return false;
+    current = index;
+    roster.clear();
+    return loadRoster(index);
+}
+
+qint64 DutyState::field(StateJournal::Field field, int index) const
+{
+    const RosterState &state = rosters[index];
+    switch (field) {
+    case StateJournal::LastUpdate: return state.lastUpdate;
+    case StateJournal::TestingMode: return index == 0 && isTestingMode ? 1 : 0;
+    case StateJournal::AnchorDate: return state.anchorDay;
+    case StateJournal::AnchorIndex1: return state.anchorIndex1;
+    case StateJournal::AnchorIndex2: return state.anchorIndex2;
+    case StateJournal::ManualOffset: return state.manualOffset;
+    case StateJournal::OriginOffset: return state.originOffset;
+    case StateJournal::PinDate: return state.pinDay;
+    case StateJournal::PinSteps: return state.pinSteps;
+    default: return 0;
+    }
+}
+
+void DutyState::applyField(StateJournal::Field field, qint64 value, int index)
+{
+    RosterState &state = rosters[index];
+    switch (field) {
+    case StateJournal::LastUpdate: state.lastUpdate = qint32(value); break;
+    case StateJournal::TestingMode:
+        if (index == 0)
+            isTestingMode = value != 0;
+        break;
+    case StateJournal::AnchorDate: state.anchorDay = QDate::fromJulianDay(value).isValid() ? qint32(value) : 0; break;
+    case StateJournal::AnchorIndex1: state.anchorIndex1 = qint16(value); break;
+    case StateJournal::AnchorIndex2: state.anchorIndex2 = qint16(value); break;
+    case StateJournal::ManualOffset: state.manualOffset = qint32(value); break;
+    case StateJournal::OriginOffset: state.originOffset = qint32(value); break;
+    case StateJournal::PinDate:
+        state.pinDay = QDate::fromJulianDay(value).isValid() ? qint32(value) : 0;
+        applyPin(index);
+        break;
+    case StateJournal::PinSteps:
+        state.pinSteps = qint32(value);
+        applyPin(index);
+        break;
+    default: break;
+    }
+}
+
+void DutyState::readRotation(const ConfigStore &config, int index)
+{
+    RosterState &state = rosters[index];
+    const QDate anchorDate = QDate::fromString(config.value(rosterKey(index, "anchorDate")).toString(), "yyyyMMdd");
+    state.anchorDay = anchorDate.isValid() ? qint32(anchorDate.toJulianDay()) : 0;
+    state.anchorIndex1 = qint16(config.value(rosterKey(index, "anchorIndex1"), 0).toInt());
+    state.anchorIndex2 = qint16(config.value(rosterKey(index, "anchorIndex2"), 1).toInt());
+    state.manualOffset = config.value(rosterKey(index, "offset"), 0).toInt();
+    state.originOffset = config.value(rosterKey(index, "originOffset"), 0).toInt();
+    state.lastUpdate = config.value(rosterKey(index, "lastUpdate")).toString().toInt();
+    const QDate pinDate = QDate::fromString(config.value(rosterKey(index, "pinDate")).toString(), "yyyyMMdd");
+    state.pinDay = pinDate.isValid() ? qint32(pinDate.toJulianDay()) : 0;
+    state.pinSteps = config.value(rosterKey(index, "pinSteps"), 0).toInt();
+    applyPin(index);
+}
+
+void DutyState::applyPin(int index)
+{
+    const RosterState &state = rosters[index];
+    DutyPlanner &planner = planners[index];
+    planner.setManualStep(state.pinDay ? QDate::fromJulianDay(state.pinDay) : QDate(), state.pinSteps);
+    planner.update();
+}
+
+RotationEngine DutyState::rotation(int index) const
+{
+    const RosterState &state = rosters[index];
+    RotationEngine engine;
+    engine.setCalendar(&calendar);
+    engine.setTotalPersons(state.totalPersons);
+    engine.setAnchor(state.anchorDay ? QDate::fromJulianDay(state.anchorDay) : QDate(),
+                     { state.anchorIndex1, state.anchorIndex2 });
+    return engine;
+}
+
+RotationEngine::Pair DutyState::pairFor(const QDate &date, int index) const
+{
+    const RosterState &state = rosters[index];
+    const DutyPlanner &planner = planners[index];
+    const int day = planner.indexOf(date);
+    if (day >= 0) {
+        const RotationEngine::Pair pair = planner.pairAt(day);
+        if (pair.first >= 0 && pair.second >= 0)
+            return pair;
+    }
+    const RotationEngine engine = rotation(index);
+    // 考试期间不轮换
+    if (isTestingMode && state.anchorDay && date.toJulianDay() >= state.anchorDay)
+        return engine.pairAt(state.manualOffset);
+    return engine.pairFor(date, state.manualOffset);
+}
+
+QString DutyState::label(int index) const
+{
+    const QString name = roster.name(index);
+    return name.isEmpty() ? QString::number(index + 1) : name;
+}
@@ -0,0 +1,141 @@
+#ifndef DUTYSTATE_H
+#define DUTYSTATE_H
+
+#include "dutyplanner.h"
+#include "roster.h"
+#include "rotationengine.h"
+#include "statejournal.h"
+#include "workcalendar.h"
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+class ConfigStore;
+
+// 值日状态：配置快照加状态日志恢复出的轮换状态，以及名单和节假日。
+// 一个进程可以管理多个名单，每个名单只占rosters中的一项，日历、考试模式和时间共用；
+// 只有当前显示的名单的姓名常驻内存。窗口程序和无界面查询共用；什么时候写文件由调用者决定
+class DutyState
+{
+public:
+    // 会写进日志的字段，其余字段只在迁移旧配置时读取。考试模式是共用的，只记在第0个名单下
+    static constexpr StateJournal::Field liveFields[] = {
+        StateJournal::LastUpdate, StateJournal::TestingMode, StateJournal::AnchorDate,
+        StateJournal::AnchorIndex1, StateJournal::AnchorIndex2, StateJournal::ManualOffset, StateJournal::OriginOffset,
+        StateJournal::PinDate, StateJournal::PinSteps,
+    };
+
+    // 一个名单的轮换状态，组合由这些字段和共用的日历直接算出
+    struct RosterState {
+        qint32 anchorDay = 0;     // 锚点日期的儒略日，0表示没有锚点
+        qint32 lastUpdate = 0;    // 上次换日的日期，yyyyMMdd
+        qint32 manualOffset = 0;  // 手动“上一组/下一组”累计的步数
+        qint32 originOffset = 0;  // 当天换日时的步数，“恢复”回到这里
+        qint32 pinDay = 0;        // 学期内手动调整的工作日（儒略日），0表示没有；只记最近的一天
+        qint32 pinSteps = 0;      // 这天在计划中跳过的组数
+        qint16 anchorIndex1 = 0;
+        qint16 anchorIndex2 = 1;
+        qint16 totalPersons = 47;
+    };
+
+    // 名单的标题和文件，只在显示和重新加载时用到
+    struct RosterFile {
+        QString title;
+        QString fileName;
+        QString filePath;
+        QString planFileName;  // 约束文件，为空时按原来的轮换
+        QString planFilePath;
+    };
+
+    DutyState();
+    DutyState(const DutyState &) = delete;
+    DutyState &operator=(const DutyState &) = delete;
+
+    // 读取名单个数、各名单的人数和文件、节假日文件名，相对路径以baseDir为准
+    void readSettings(const ConfigStore &config, const QString &baseDir);
+    void writeSettings(ConfigStore &config) const;
+    // 配置文件开头的说明
+    static QString configHeader();
+
+    // 在快照之上重放日志，必要时迁移旧配置；today用于没有任何日期记录的旧配置和新加的名单。
+    // 迁移要用名单的实际人数，须在loadRosters()之后调用。
+    // 返回true表示快照需要更新（迁移了旧配置或日志中有未合并的记录）
+    bool restore(const ConfigStore &config, StateJournal &journal, const QDate &today, bool repairJournal = true);
+
+    // 配置文件在运行中被修改后调用，keys是改变的键，返回需要调用者重新加载的部分
+    enum ReloadScope {
+        ReloadNone = 0,
+        ReloadState = 0x01,     // 轮换字段或考试模式已改入状态，需要记入日志
+        ReloadRosters = 0x02,   // 名单个数、文件、标题或约束文件已重新读取，需要重新加载名单
+        ReloadCalendar = 0x04,  // 节假日文件改变
+    };
+    // 轮换字段只改动对应的那一项，不会用快照中的旧值覆盖日志中更新的其他字段；新加的名单以today为锚点
+    int applyChangedKeys(const ConfigStore &config, const QStringList &keys, const QString &baseDir, const QDate &today);
+
+    // 写入所有名单的轮换状态；duty/index只供查看，按today算出
+    void writeSnapshot(ConfigStore &config, const QDate &today) const;
+
+    // 工作日第一次换日：每个名单以today为新锚点并记下当天的步数，之后修改节假日只影响以后的日期。
+    // 返回是否有名单改变
+    bool advance(const QDate &today);
+
+    // 开关考试模式。考试期间不轮换：进入时以最后一个已换日的日子为锚点，组合停在那一天；
+    // 退出时锚点移到退出前一天（当天已换日时为当天），停住的组合从下一次换日继续。
+    // 重放日志和同步只改isTestingMode，锚点由随后的锚点字段恢复
+    void setTestingMode(bool on, const QDate &today);
+
+    // 当前名单的“上一组/下一组”。学期内记为today（休息日为之前最近的工作日）在计划中的调整，之后的日子随之重排；
+    // 学期之外累计轮换的步数
+    void stepDuty(int steps, const QDate &today);
+    // “恢复”：回到today换日时的组合
+    void restoreDuty(const QDate &today);
+
+    // 人数以名单文件为准，返回人数是否因此改变；只有当前名单保留姓名。约束文件随名单一起重新读取
+    bool loadRoster(int index);
+    bool loadRosters();
+    // 节假日变化后学期中的工作日也会变，所有计划随之重排
+    void loadCalendar();
+    // 读取约束文件并只重排受影响的日子，names用于解析约束中的姓名；返回重排的天数
+    int loadPlan(int index, const Roster *names = nullptr);
+    const DutyPlanner &planner(int index) const { return planners[index]; }
+
+    int rosterCount() const { return int(rosters.size()); }
+    int currentRoster() const { return current; }
+    // 切换当前名单并加载它的姓名，返回人数是否改变
+    bool selectRoster(int index);
+    RosterState &active() { return rosters[current]; }
+    const RosterFile &rosterFile(int index) const { return rosterFiles[index]; }
+    QString title() const { return rosterFiles[current].title; }
+
+    qint64 field(StateJournal::Field field, int index = 0) const;
+    void applyField(StateJournal::Field field, qint64 value, int index = 0);
+
+    // 由紧凑状态临时构造轮换计算
+    RotationEngine rotation(int index) const;
+    // 学期内的工作日按约束计划（包括手动调整）；其余日子按轮换计算，
+    // 考试期间锚点之后的日子都是锚点的组合
+    RotationEngine::Pair pairFor(const QDate &date, int index) const;
+    RotationEngine::Pair pairFor(const QDate &date) const { return pairFor(date, current); }
+    // 当前名单中的姓名，没有名单时为从1开始的编号
+    QString label(int index) const;
+
+    Roster roster;  // 当前名单的姓名
+    WorkCalendar calendar;
+    bool isTestingMode = false;  // 考试模式，所有名单共用
+
+    QString holidayFileName;
+    QString holidayFilePath;
+
+private:
+    void readRotation(const ConfigStore &config, int index);
+    // 把学期内的手动调整交给计划，只重排受影响的日子
+    void applyPin(int index);
+
+    QVector<RosterState> rosters;
+    QVector<RosterFile> rosterFiles;
+    QVector<DutyPlanner> planners;
+    int current = 0;
+};
+
+#endif // DUTYSTATE_H
@@ -0,0 +1,162 @@
+#include "dutyview.h"
+
+#include <QEvent>
+#include <QFontMetricsF>
+#include <QPainter>
+
+namespace {
+const int kMargin = 5;       // 窗口边缘到背景的透明边距
+const qreal kBorder = 2;
+const qreal kRadius = 10;
+const qreal kPadding = 11;   // 背景边缘到文字
+const qreal kAndWidth = 15;  // 两个名字之间“&”所占的宽度
+const qreal kMinNameSize = 10;
+
+// 名字比一栏宽时逐步缩小字号
+QFont fitFont(const QFont &base, const QString &text, qreal width)
+{
+    QFont font = base;
+    while (font.pointSizeF() > kMinNameSize && QFontMetricsF(font).horizontalAdvance(text) > width)
+        font.setPointSizeF(font.pointSizeF() - 1);
+    return font;
+}
+
+void prepareText(QStaticText &text, const QFont &font)
+{
+    text.setTextFormat(Qt::PlainText);
+    text.setPerformanceHint(QStaticText::AggressiveCaching);
+    text.prepare(QTransform(), font);
+}
+}
+
+DutyView::DutyView(QWidget *parent)
+    : QWidget(parent)
+    , titleText(QStringLiteral("值日安排"))
+    , andText(QStringLiteral("&"))
+{
+    setAttribute(Qt::WA_TransparentForMouseEvents, true);
+    resetFonts();
+}
+
+void DutyView::setTitle(const QString &title)
+{
+    if (titleText.text() == title)
+        return;
+    titleText.setText(title);
+    layoutDirty = true;
+    update();
+}
+
+void DutyView::setNames(const QString &first, const QString &second)
+{
+    if (firstText.text() == first && secondText.text() == second)
+        return;
+    firstText.setText(first);
+    secondText.setText(second);
+    layoutDirty = true;
+    update();
+}
+
+void DutyView::paintEvent(QPaintEvent *)
+{
+    const qreal ratio = devicePixelRatioF();
+    if (background.isNull() || !qFuzzyCompare(background.devicePixelRatio(), ratio)) {
+        rebuildBackground(ratio);
+        layoutDirty = true;
+    }
+    if (layoutDirty)
+        layoutText();
+
+    QPainter painter(this);
+    painter.drawPixmap(0, 0, background);
+    painter.setPen(palette().color(QPalette::WindowText));
+    painter.setFont(titleFont);
+    painter.drawStaticText(titlePos, titleText);
+    painter.setFont(firstFont);
+    painter.drawStaticText(firstPos, firstText);
+    painter.setFont(andFont);
+    painter.drawStaticText(andPos, andText);
+    painter.setFont(secondFont);
+    painter.drawStaticText(secondPos, secondText);
+}
+
+void DutyView::resizeEvent(QResizeEvent *event)
+{
+    QWidget::resizeEvent(event);
+    background = QPixmap();
+    layoutDirty = true;
+}
+
+void DutyView::changeEvent(QEvent *event)
+{
+    QWidget::changeEvent(event);
+    if (event->type() == QEvent::FontChange) {
+        resetFonts();
+        update();
+    } else if (event->type() == QEvent::PaletteChange) {
+        update();
+    }
+}
+
+void DutyView::resetFonts()
+{
+    titleFont = font();
+    titleFont.setPointSize(14);
+    titleFont.setBold(true);
+    nameFont = font();
+    nameFont.setPointSize(18);
+    nameFont.setBold(true);
+    andFont = font();
+    andFont.setPointSize(12);
+    andFont.setBold(true);
+    layoutDirty = true;
+}
+
+void DutyView::rebuildBackground(qreal pixelRatio)
+{
+    background = QPixmap((QSizeF(size()) * pixelRatio).toSize());
+    background.setDevicePixelRatio(pixelRatio);
+    background.fill(Qt::transparent);
+
+    QPainter painter(&background);
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.setPen(QPen(QColor(0xdd, 0xdd, 0xdd), kBorder));
+    painter.setBrush(QColor(255, 255, 255, 200));
+    const qreal inset = kMargin + kBorder / 2;
+    painter.drawRoundedRect(QRectF(rect()).adjusted(inset, inset, -inset, -inset), kRadius, kRadius);
+}
+
+void DutyView::layoutText()
+{
+    const QRectF content = contentRect();
+
+    prepareText(titleText, titleFont);
+    titlePos = content.topLeft();
+
+    // 标题下方的区域分成左右两栏，中间是“&”
+    const qreal rowTop = titlePos.y() + titleText.size().height();
+    const QRectF row(content.left(), rowTop, content.width(), content.bottom() - rowTop);
+    const qreal columnWidth = (row.width() - kAndWidth) / 2;
+
+    firstFont = fitFont(nameFont, firstText.text(), columnWidth);
+    secondFont = fitFont(nameFont, secondText.text(), columnWidth);
+    prepareText(firstText, firstFont);
+    prepareText(secondText, secondFont);
+    prepareText(andText, andFont);
+
+    const auto centeredIn = [&row](const QStaticText &text, qreal left, qreal width) {
+        const QSizeF size = text.size();
+        return QPointF(left + (width - size.width()) / 2, row.center().y() - size.height() / 2);
+    };
+    firstPos = centeredIn(firstText, row.left(), columnWidth);
+    andPos = centeredIn(andText, row.left() + columnWidth, kAndWidth);
+    secondPos = centeredIn(secondText, row.left() + columnWidth + kAndWidth, columnWidth);
+
+    layoutDirty = false;
+}
+
+QRectF DutyView::contentRect() const
+{
+    const qreal inset = kMargin + kBorder + kPadding;
+    return QRectF(rect()).adjusted(inset, inset, -inset, -inset);
+}
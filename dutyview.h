@@ -0,0 +1,52 @@
+#ifndef DUTYVIEW_H
+#define DUTYVIEW_H
+
+#include <QWidget>
+#include <QPixmap>
+#include <QStaticText>
+
+// 值日显示：一个控件自己绘制圆角背景、标题和两个名字。
+// 背景缓存为位图，文字用QStaticText，只有文字、字体、尺寸或缩放比例变化时才重新排版
+class DutyView : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit DutyView(QWidget *parent = nullptr);
+
+    void setTitle(const QString &title);
+    // 名字没有变化时不会触发重绘
+    void setNames(const QString &first, const QString &second);
+
+    QString firstName() const { return firstText.text(); }
+    QString secondName() const { return secondText.text(); }
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+    void changeEvent(QEvent *event) override;
+
+private:
+    void resetFonts();
+    void rebuildBackground(qreal pixelRatio);
+    void layoutText();
+    QRectF contentRect() const;
+
+    QPixmap background;
+    QStaticText titleText;
+    QStaticText andText;
+    QStaticText firstText;
+    QStaticText secondText;
+    QFont nameFont;  // 名字的基准字体，名字太长时缩小
+    QFont titleFont;
+    QFont andFont;
+    QFont firstFont;
+    QFont secondFont;
+    QPointF titlePos;
+    QPointF andPos;
+    QPointF firstPos;
+    QPointF secondPos;
+    bool layoutDirty = true;
+};
+
+#endif // DUTYVIEW_H
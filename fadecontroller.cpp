@@ -0,0 +1,96 @@
+#include "fadecontroller.h"
+
+#include <QWidget>
+#include <QEvent>
+#include <QPropertyAnimation>
+
+FadeController::FadeController(QWidget *widget, qreal visibleOpacity)
+    : QObject(widget)
+    , widget(widget)
+    , opacity(visibleOpacity)
+{
+    animation = new QPropertyAnimation(widget, "windowOpacity", this);
+    animation->setEasingCurve(QEasingCurve::InOutQuad);
+    connect(animation, &QPropertyAnimation::finished, this, [this]() {
+        if (hideWhenDone) {
+            hideWhenDone = false;
+            this->widget->hide();
+        }
+    });
+
+    widget->setWindowOpacity(opacity);
+    widget->installEventFilter(this);
+}
+
+bool FadeController::isShown() const
+{
+    return widget->isVisible() && !hideWhenDone;
+}
+
+bool FadeController::isAnimating() const
+{
+    return animation->state() == QAbstractAnimation::Running;
+}
+
+void FadeController::fadeIn(int duration)
+{
+    hideWhenDone = false;
+    if (!widget->isVisible()) {
+        widget->setWindowOpacity(0.0);
+        showingFromFade = true;
+        widget->show();
+        showingFromFade = false;
+    }
+    animateTo(opacity, duration);
+}
+
+void FadeController::fadeOut(int duration)
+{
+    if (!widget->isVisible())
+        return;
+    hideWhenDone = true;
+    animateTo(0.0, duration);
+}
+
+void FadeController::fadeTo(qreal targetOpacity, int duration)
+{
+    opacity = targetOpacity;
+    if (!widget->isVisible()) {
+        widget->setWindowOpacity(opacity);
+        return;
+    }
+    // 淡出中途同样从当前透明度平滑反向，不再隐藏
+    hideWhenDone = false;
+    animateTo(opacity, duration);
+}
+
+bool FadeController::eventFilter(QObject *watched, QEvent *event)
+{
+    if (watched == widget) {
+        if (event->type() == QEvent::Show && !showingFromFade) {
+            // 外部直接show()时取消未完成的淡出，恢复正常透明度
+            hideWhenDone = false;
+            animation->stop();
+            widget->setWindowOpacity(opacity);
+        } else if (event->type() == QEvent::Hide) {
+            hideWhenDone = false;
+            animation->stop();
+        }
+    }
+    return QObject::eventFilter(watched, event);
+}
+
+void FadeController::animateTo(qreal targetOpacity, int duration)
+{
+    const qreal current = widget->windowOpacity();
+    animation->stop();
+
+    // 被打断时只走剩下的距离，速度保持一致
+    const qreal distance = qAbs(targetOpacity - current);
+    const int scaled = opacity > 0 ? int(duration * qMin<qreal>(1.0, distance / opacity)) : 0;
+
+    animation->setDuration(qMax(1, scaled));
+    animation->setStartValue(current);
+    animation->setEndValue(targetOpacity);
+    animation->start();
+}
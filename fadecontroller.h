@@ -0,0 +1,43 @@
+#ifndef FADECONTROLLER_H
+#define FADECONTROLLER_H
+
+#include <QObject>
+
+class QWidget;
+class QPropertyAnimation;
+
+// 窗口淡入淡出：复用同一个动画对象，直接改变原生windowOpacity，
+// 中途反向时从当前透明度继续
+class FadeController : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit FadeController(QWidget *widget, qreal visibleOpacity = 0.8);
+
+    qreal visibleOpacity() const { return opacity; }
+
+    // 窗口可见且没有正在淡出
+    bool isShown() const;
+    bool isAnimating() const;
+
+public slots:
+    void fadeIn(int duration = 300);
+    void fadeOut(int duration = 300);
+    // 只改变透明度，不显示隐藏的窗口；正在淡出时取消隐藏，从当前透明度过渡到新的透明度
+    void fadeTo(qreal targetOpacity, int duration = 300);
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
+private:
+    void animateTo(qreal targetOpacity, int duration);
+
+    QWidget *widget;
+    QPropertyAnimation *animation;
+    qreal opacity;
+    bool hideWhenDone = false;
+    bool showingFromFade = false;
+};
+
+#endif // FADECONTROLLER_H
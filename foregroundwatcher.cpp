@@ -0,0 +1,40 @@
+#include "foregroundwatcher.h"
+
+#include <QDebug>
+
+ForegroundWatcher::ForegroundWatcher(QObject *parent)
+    : QObject(parent)
+{
+}
+
+ForegroundWatcher *ForegroundWatcher::create(QObject *parent)
+{
+#ifdef Q_OS_WIN
+    return new WinEventForegroundWatcher(parent);
+#else
+#ifdef ONDUTY_HAVE_XCB
+    XcbForegroundWatcher *xcbWatcher = new XcbForegroundWatcher(parent);
+    if (xcbWatcher->isValid())
+        return xcbWatcher;
+    delete xcbWatcher;
+#endif
+    qDebug() << "No foreground watcher backend available on this platform";
+    return new ForegroundWatcher(parent);
+#endif
+}
+
+void ForegroundWatcher::setPresentationShowing(bool showing)
+{
+    if (presentationShowing == showing)
+        return;
+    presentationShowing = showing;
+    emit presentationChanged(showing);
+}
+
+void ForegroundWatcher::setFullscreen(bool fullscreen)
+{
+    if (this->fullscreen == fullscreen)
+        return;
+    this->fullscreen = fullscreen;
+    emit fullscreenChanged(fullscreen);
+}
@@ -0,0 +1,95 @@
+#ifndef FOREGROUNDWATCHER_H
+#define FOREGROUNDWATCHER_H
+
+#include <QObject>
+#include <QList>
+
+// 前台窗口监视器：由各平台后端推送“正在放映/有全屏应用”的变化，不再轮询。
+// 基类本身是空后端，用于不支持的平台
+class ForegroundWatcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ForegroundWatcher(QObject *parent = nullptr);
+
+    // 为当前平台选择可用的后端
+    static ForegroundWatcher *create(QObject *parent = nullptr);
+
+    bool isPresentationShowing() const { return presentationShowing; }
+    bool isFullscreen() const { return fullscreen; }
+
+signals:
+    void presentationChanged(bool showing);
+    void fullscreenChanged(bool fullscreen);
+
+protected:
+    // 后端调用，状态真正变化时才发出信号
+    void setPresentationShowing(bool showing);
+    void setFullscreen(bool fullscreen);
+
+private:
+    bool presentationShowing = false;
+    bool fullscreen = false;
+};
+
+// 手动驱动的后端，用于测试
+class FakeForegroundWatcher : public ForegroundWatcher
+{
+    Q_OBJECT
+
+public:
+    using ForegroundWatcher::ForegroundWatcher;
+
+    void setPresentationShowing(bool showing) { ForegroundWatcher::setPresentationShowing(showing); }
+    void setFullscreen(bool fullscreen) { ForegroundWatcher::setFullscreen(fullscreen); }
+};
+
+#ifdef Q_OS_WIN
+// 基于SetWinEventHook的后端
+class WinEventForegroundWatcher : public ForegroundWatcher
+{
+    Q_OBJECT
+
+public:
+    explicit WinEventForegroundWatcher(QObject *parent = nullptr);
+    ~WinEventForegroundWatcher() override;
+
+    void refresh();
+
+private:
+    QList<void *> hooks;
+};
+#endif
+
+#ifdef ONDUTY_HAVE_XCB
+class QSocketNotifier;
+struct xcb_connection_t;
+
+// 基于X11 _NET_ACTIVE_WINDOW / _NET_WM_STATE 属性通知的后端
+class XcbForegroundWatcher : public ForegroundWatcher
+{
+    Q_OBJECT
+
+public:
+    explicit XcbForegroundWatcher(QObject *parent = nullptr);
+    ~XcbForegroundWatcher() override;
+
+    bool isValid() const { return connection != nullptr; }
+
+private:
+    void processEvents();
+    void updateActiveWindow();
+    void updateState();
+
+    xcb_connection_t *connection = nullptr;
+    QSocketNotifier *notifier = nullptr;
+    quint32 root = 0;
+    quint32 activeWindow = 0;
+    quint32 activeWindowAtom = 0;
+    quint32 wmStateAtom = 0;
+    quint32 fullscreenAtom = 0;
+};
+#endif
+
+#endif // FOREGROUNDWATCHER_H
@@ -0,0 +1,114 @@
+#include "foregroundwatcher.h"
+
+#include <windows.h>
+
+namespace {
+WinEventForegroundWatcher *activeWatcher = nullptr;
+
+bool isScreenClass(HWND hwnd)
+{
+    wchar_t className[64];
+    return GetClassNameW(hwnd, className, 64) && wcscmp(className, L"screenClass") == 0;
+}
+
+// 查找PowerPoint幻灯片放映窗口，只在收到窗口事件时调用
+bool findPresentationWindow()
+{
+    // 方法1: 按标题查找
+    HWND hwnd = FindWindowW(L"screenClass", L"PowerPoint 幻灯片放映");
+    if (hwnd && IsWindowVisible(hwnd)) {
+        return true;
+    }
+
+    // 方法2: 通过窗口类名查找
+    hwnd = FindWindowW(L"screenClass", nullptr);
+    while (hwnd) {
+        if (IsWindowVisible(hwnd)) {
+            wchar_t windowTitle[256];
+            GetWindowTextW(hwnd, windowTitle, 256);
+            if (wcsstr(windowTitle, L"PowerPoint") != nullptr ||
+                wcsstr(windowTitle, L"幻灯片放映") != nullptr) {
+                return true;
+            }
+        }
+        hwnd = FindWindowExW(nullptr, hwnd, L"screenClass", nullptr);
+    }
+    return false;
+}
+
+// 前台窗口是否覆盖了它所在的整个显示器（排除桌面和本程序自己的窗口）
+bool isFullscreenWindow(HWND hwnd)
+{
+    if (!hwnd || !IsWindowVisible(hwnd) || IsIconic(hwnd))
+        return false;
+
+    DWORD processId = 0;
+    GetWindowThreadProcessId(hwnd, &processId);
+    if (processId == GetCurrentProcessId())
+        return false;
+
+    wchar_t className[64];
+    if (GetClassNameW(hwnd, className, 64)
+        && (wcscmp(className, L"Progman") == 0 || wcscmp(className, L"WorkerW") == 0
+            || wcscmp(className, L"Shell_TrayWnd") == 0)) {
+        return false;
+    }
+
+    RECT windowRect;
+    MONITORINFO monitorInfo = {};
+    monitorInfo.cbSize = sizeof(monitorInfo);
+    if (!GetWindowRect(hwnd, &windowRect)
+        || !GetMonitorInfoW(MonitorFromWindow(hwnd, MONITOR_DEFAULTTONEAREST), &monitorInfo)) {
+        return false;
+    }
+    return windowRect.left <= monitorInfo.rcMonitor.left && windowRect.top <= monitorInfo.rcMonitor.top
+        && windowRect.right >= monitorInfo.rcMonitor.right && windowRect.bottom >= monitorInfo.rcMonitor.bottom;
+}
+
+void CALLBACK winEventProc(HWINEVENTHOOK, DWORD event, HWND hwnd, LONG idObject, LONG, DWORD, DWORD)
+{
+    if (!activeWatcher || idObject != OBJID_WINDOW || !hwnd)
+        return;
+    // 只关心前台窗口的位置变化和放映窗口的显示/隐藏
+    if (event == EVENT_OBJECT_LOCATIONCHANGE && hwnd != GetForegroundWindow())
+        return;
+    if ((event == EVENT_OBJECT_SHOW || event == EVENT_OBJECT_HIDE) && !isScreenClass(hwnd))
+        return;
+    activeWatcher->refresh();
+}
+}
+
+WinEventForegroundWatcher::WinEventForegroundWatcher(QObject *parent)
+    : ForegroundWatcher(parent)
+{
+    activeWatcher = this;
+
+    // 回调通过本线程的消息循环投递
+    const DWORD flags = WINEVENT_OUTOFCONTEXT | WINEVENT_SKIPOWNPROCESS;
+    const DWORD ranges[][2] = {
+        { EVENT_SYSTEM_FOREGROUND, EVENT_SYSTEM_FOREGROUND },
+        { EVENT_OBJECT_SHOW, EVENT_OBJECT_HIDE },
+        { EVENT_OBJECT_LOCATIONCHANGE, EVENT_OBJECT_LOCATIONCHANGE },
+    };
+    for (const auto &range : ranges) {
+        HWINEVENTHOOK hook = SetWinEventHook(range[0], range[1], nullptr, winEventProc, 0, 0, flags);
+        if (hook)
+            hooks.append(hook);
+    }
+
+    refresh();
+}
+
+WinEventForegroundWatcher::~WinEventForegroundWatcher()
+{
+    for (void *hook : std::as_const(hooks))
+        UnhookWinEvent(static_cast<HWINEVENTHOOK>(hook));
+    if (activeWatcher == this)
+        activeWatcher = nullptr;
+}
+
+void WinEventForegroundWatcher::refresh()
+{
+    setPresentationShowing(findPresentationWindow());
+    setFullscreen(isFullscreenWindow(GetForegroundWindow()));
+}
@@ -0,0 +1,145 @@
+#include "foregroundwatcher.h"
+
+#include <QSocketNotifier>
+#include <QByteArray>
+#include <QDebug>
+
+#include <xcb/xcb.h>
+#include <cstdlib>
+
+namespace {
+// 这些应用的全屏窗口视为正在放映
+const char *const kPresentationClasses[] = {
+    "libreoffice-impress", "soffice", "wpp", "powerpnt.exe",
+};
+
+xcb_atom_t internAtom(xcb_connection_t *connection, const char *name)
+{
+    xcb_intern_atom_cookie_t cookie = xcb_intern_atom(connection, 0, quint16(qstrlen(name)), name);
+    xcb_intern_atom_reply_t *reply = xcb_intern_atom_reply(connection, cookie, nullptr);
+    if (!reply)
+        return XCB_ATOM_NONE;
+    xcb_atom_t atom = reply->atom;
+    free(reply);
+    return atom;
+}
+
+xcb_get_property_reply_t *getProperty(xcb_connection_t *connection, xcb_window_t window,
+                                      xcb_atom_t property, xcb_atom_t type, quint32 length)
+{
+    xcb_get_property_cookie_t cookie = xcb_get_property(connection, 0, window, property, type, 0, length);
+    return xcb_get_property_reply(connection, cookie, nullptr);
+}
+}
+
+XcbForegroundWatcher::XcbForegroundWatcher(QObject *parent)
+    : ForegroundWatcher(parent)
+{
+    int screenNumber = 0;
+    connection = xcb_connect(nullptr, &screenNumber);
+    if (xcb_connection_has_error(connection)) {
+        xcb_disconnect(connection);
+        connection = nullptr;
+        return;
+    }
+
+    xcb_screen_iterator_t it = xcb_setup_roots_iterator(xcb_get_setup(connection));
+    for (int i = 0; i < screenNumber && it.rem; ++i)
+        xcb_screen_next(&it);
+    root = it.data->root;
+
+    activeWindowAtom = internAtom(connection, "_NET_ACTIVE_WINDOW");
+    wmStateAtom = internAtom(connection, "_NET_WM_STATE");
+    fullscreenAtom = internAtom(connection, "_NET_WM_STATE_FULLSCREEN");
+
+    // 根窗口的属性变化会带来_NET_ACTIVE_WINDOW的通知
+    const quint32 mask = XCB_EVENT_MASK_PROPERTY_CHANGE;
+    xcb_change_window_attributes(connection, root, XCB_CW_EVENT_MASK, &mask);
+    xcb_flush(connection);
+
+    notifier = new QSocketNotifier(xcb_get_file_descriptor(connection), QSocketNotifier::Read, this);
+    connect(notifier, &QSocketNotifier::activated, this, &XcbForegroundWatcher::processEvents);
+
+    updateActiveWindow();
+}
+
+XcbForegroundWatcher::~XcbForegroundWatcher()
+{
+    if (connection)
+        xcb_disconnect(connection);
+}
+
+void XcbForegroundWatcher::processEvents()
+{
+    // 取属性时会读入后续事件，循环直到队列和套接字都为空
+    while (xcb_generic_event_t *event = xcb_poll_for_event(connection)) {
+        if ((event->response_type & ~0x80) == XCB_PROPERTY_NOTIFY) {
+            const auto *notify = reinterpret_cast<xcb_property_notify_event_t *>(event);
+            if (notify->window == root && notify->atom == activeWindowAtom)
+                updateActiveWindow();
+            else if (notify->window == activeWindow && notify->atom == wmStateAtom)
+                updateState();
+        }
+        free(event);
+    }
+
+    if (xcb_connection_has_error(connection)) {
+        qWarning() << "X11 connection lost, foreground watcher disabled";
+        notifier->setEnabled(false);
+    }
+}
+
+void XcbForegroundWatcher::updateActiveWindow()
+{
+    xcb_window_t window = XCB_WINDOW_NONE;
+    if (xcb_get_property_reply_t *reply = getProperty(connection, root, activeWindowAtom, XCB_ATOM_WINDOW, 1)) {
+        if (xcb_get_property_value_length(reply) >= int(sizeof(xcb_window_t)))
+            window = *static_cast<xcb_window_t *>(xcb_get_property_value(reply));
+        free(reply);
+    }
+
+    if (window != activeWindow) {
+        // 只监听当前活动窗口的属性变化
+        const quint32 noEvents = XCB_EVENT_MASK_NO_EVENT;
+        const quint32 propertyEvents = XCB_EVENT_MASK_PROPERTY_CHANGE;
+        if (activeWindow != XCB_WINDOW_NONE)
+            xcb_change_window_attributes(connection, activeWindow, XCB_CW_EVENT_MASK, &noEvents);
+        if (window != XCB_WINDOW_NONE)
+            xcb_change_window_attributes(connection, window, XCB_CW_EVENT_MASK, &propertyEvents);
+        xcb_flush(connection);
+        activeWindow = window;
+    }
+
+    updateState();
+}
+
+void XcbForegroundWatcher::updateState()
+{
+    bool isFullscreen = false;
+    bool isPresentation = false;
+
+    if (activeWindow != XCB_WINDOW_NONE) {
+        if (xcb_get_property_reply_t *reply = getProperty(connection, activeWindow, wmStateAtom, XCB_ATOM_ATOM, 32)) {
+            const auto *atoms = static_cast<const xcb_atom_t *>(xcb_get_property_value(reply));
+            const int count = xcb_get_property_value_length(reply) / int(sizeof(xcb_atom_t));
+            for (int i = 0; i < count && !isFullscreen; ++i)
+                isFullscreen = atoms[i] == fullscreenAtom;
+            free(reply);
+        }
+
+        if (isFullscreen) {
+            // WM_CLASS是两个以\0分隔的字符串：实例名和类名
+            if (xcb_get_property_reply_t *reply = getProperty(connection, activeWindow, XCB_ATOM_WM_CLASS, XCB_ATOM_STRING, 64)) {
+                const QByteArray wmClass(static_cast<const char *>(xcb_get_property_value(reply)),
+                                         xcb_get_property_value_length(reply));
+                const QByteArray lowered = wmClass.toLower();
+                for (const char *name : kPresentationClasses)
+                    isPresentation = isPresentation || lowered.contains(name);
+                free(reply);
+            }
+        }
+    }
+
+    setFullscreen(isFullscreen);
+    setPresentationShowing(isPresentation);
+}
@@ -0,0 +1,273 @@
+#include "headless.h"
+#include "configstore.h"
+#include "dutystate.h"
+#include "dutyhistory.h"
+#include "statejournal.h"
+#include "timeservice.h"
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QEventLoop>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLoggingCategory>
+#include <QLocale>
+#include <QRegularExpression>
+#include <cstdio>
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#endif
+
+namespace {
+struct DutyRow {
+    QDate date;
+    bool workday;
+    RotationEngine::Pair pair;
+};
+
+QDate parseDate(const QString &text)
+{
+    QDate date = QDate::fromString(text, "yyyy-MM-dd");
+    if (!date.isValid())
+        date = QDate::fromString(text, "yyyyMMdd");
+    return date;
+}
+
+QString csvField(const QString &text)
+{
+    if (!text.contains(QRegularExpression(QStringLiteral("[\",\\r\\n]"))))
+        return text;
+    QString quoted = text;
+    quoted.replace('"', QStringLiteral("\"\""));
+    return '"' + quoted + '"';
+}
+
+QJsonObject rowToJson(const DutyState &state, const DutyRow &row)
+{
+    QJsonArray duty;
+    for (int index : { row.pair.first, row.pair.second }) {
+        QJsonObject person;
+        person["number"] = index + 1;
+        person["name"] = state.label(index);
+        duty.append(person);
+    }
+    QJsonObject object;
+    object["date"] = row.date.toString("yyyy-MM-dd");
+    object["workday"] = row.workday;
+    object["duty"] = duty;
+    return object;
+}
+
+QJsonObject entryToJson(const DutyState &state, const DutyHistory::Entry &entry)
+{
+    QJsonObject object = rowToJson(state, { entry.date, state.calendar.isWorkday(entry.date), entry.pair });
+    object["reason"] = DutyHistory::reasonKey(entry.reason);
+    object["recordedAt"] = QDateTime::fromSecsSinceEpoch(entry.recordedAt, Qt::UTC).toString(Qt::ISODate);
+    return object;
+}
+
+// 无界面模式的选项，isHeadlessCommand也从这里取选项名
+struct HeadlessOptions {
+    const QCommandLineOption today { "today", "查询今天（默认）" };
+    const QCommandLineOption date { "date", "查询指定日期，可重复", "yyyy-MM-dd" };
+    const QCommandLineOption range { "range", "查询一段日期（含两端）", "开始..结束" };
+    const QCommandLineOption json { "json", "以JSON输出" };
+    const QCommandLineOption csv { "csv", "以CSV输出" };
+    const QCommandLineOption roster { "roster", "查询第n个名单（从1开始，默认为当前显示的名单）", "n" };
+    const QCommandLineOption sync { "sync", "先通过NTP校时再计算今天（默认使用上次校时的偏移）" };
+    const QCommandLineOption history { "history", "输出这些日期实际记录的值日和调整，而不是按规则推算" };
+
+    QList<QCommandLineOption> all() const { return { today, date, range, roster, json, csv, sync, history }; }
+};
+
+void writeOut(const QByteArray &data)
+{
+    std::fwrite(data.constData(), 1, size_t(data.size()), stdout);
+    std::fflush(stdout);
+}
+
+}
+
+bool isHeadlessCommand(int argc, char *argv[])
+{
+    // 还在QApplication之前，只比较选项名；--help和-h由parser.addHelpOption()添加
+    QList<QByteArray> names = { "--help", "-h" };
+    for (const QCommandLineOption &option : HeadlessOptions().all()) {
+        for (const QString &name : option.names())
+            names.append((name.size() == 1 ? "-" : "--") + name.toLatin1());
+    }
+    for (int i = 1; i < argc; ++i) {
+        const QByteArray arg(argv[i]);
+        for (const QByteArray &name : names) {
+            if (arg == name || arg.startsWith(name + '='))
+                return true;
+        }
+    }
+    return false;
+}
+
+// 程序是GUI子系统，输出没有被重定向时才需要连接控制台
+void attachParentConsole()
+{
+#ifdef Q_OS_WIN
+    const HANDLE output = GetStdHandle(STD_OUTPUT_HANDLE);
+    if (output && output != INVALID_HANDLE_VALUE && GetFileType(output) != FILE_TYPE_UNKNOWN)
+        return;
+    if (!AttachConsole(ATTACH_PARENT_PROCESS))
+        return;
+    std::freopen("CONOUT$", "w", stdout);
+    std::freopen("CONOUT$", "w", stderr);
+    SetConsoleOutputCP(CP_UTF8);
+#endif
+}
+
+int runHeadless(int argc, char *argv[])
+{
+    attachParentConsole();
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("值日安排");
+    app.setApplicationVersion("1.1");
+    // 输出给脚本读取，调试信息不要混进来
+    QLoggingCategory::setFilterRules(QStringLiteral("default.debug=false\nonduty.*.debug=false"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("查询值日安排，不启动界面");
+    parser.addHelpOption();
+    const HeadlessOptions options;
+    parser.addOptions(options.all());
+    parser.process(app);
+
+    const QString appDir = QCoreApplication::applicationDirPath();
+    ConfigStore config(appDir + "/duty_config.ini");
+    config.load();
+
+    TimeService timeService;
+    timeService.restoreOffset(config.value("time/offsetMs", 0).toLongLong(),
+                              QDateTime::fromString(config.value("time/lastSync").toString(), Qt::ISODate));
+    if (parser.isSet(options.sync)) {
+        QEventLoop loop;
+        QObject::connect(&timeService, &TimeService::synced, &loop, &QEventLoop::quit);
+        QObject::connect(&timeService, &TimeService::syncFailed, &loop, &QEventLoop::quit);
+        timeService.sync();
+        loop.exec();
+    }
+    const QDate today = timeService.currentDate();
+
+    // 只读：不修复日志也不写配置，避免和正在运行的窗口程序冲突
+    DutyState state;
+    state.readSettings(config, appDir);
+    state.loadCalendar();
+    state.loadRosters();
+    StateJournal journal(appDir + "/duty_state.journal");
+    state.restore(config, journal, today, false);
+    int rosterIndex = state.currentRoster();
+    if (parser.isSet(options.roster)) {
+        bool ok = false;
+        rosterIndex = parser.value(options.roster).toInt(&ok) - 1;
+        if (!ok || rosterIndex < 0 || rosterIndex >= state.rosterCount()) {
+            std::fprintf(stderr, "Invalid roster: %s (1..%d)\n", qPrintable(parser.value(options.roster)), state.rosterCount());
+            return 2;
+        }
+    }
+    state.selectRoster(rosterIndex);
+
+    QList<QDate> dates;
+    for (const QString &value : parser.values(options.date)) {
+        const QDate date = parseDate(value);
+        if (!date.isValid()) {
+            std::fprintf(stderr, "Invalid date: %s\n", qPrintable(value));
+            return 2;
+        }
+        dates.append(date);
+    }
+    bool isList = dates.size() > 1;
+    if (parser.isSet(options.range)) {
+        const QStringList bounds = parser.value(options.range).split(QRegularExpression(QStringLiteral("\\.\\.|~")));
+        const QDate from = parseDate(bounds.first());
+        const QDate to = bounds.size() == 2 ? parseDate(bounds.last()) : QDate();
+        if (!from.isValid() || !to.isValid() || to < from) {
+            std::fprintf(stderr, "Invalid range: %s\n", qPrintable(parser.value(options.range)));
+            return 2;
+        }
+        for (QDate date = from; date <= to; date = date.addDays(1))
+            dates.append(date);
+        isList = true;
+    }
+    if (dates.isEmpty() || parser.isSet(options.today))
+        dates.prepend(today);
+    isList = isList || dates.size() > 1;
+
+    if (parser.isSet(options.history)) {
+        DutyHistory history(appDir + "/duty_history.dat");
+        if (!history.open()) {
+            std::fprintf(stderr, "Cannot read duty history\n");
+            return 1;
+        }
+        QJsonArray array;
+        QString text = parser.isSet(options.csv) ? QStringLiteral("date,number1,name1,number2,name2,reason,recordedAt\n") : QString();
+        const QLocale locale(QLocale::Chinese, QLocale::China);
+        for (const QDate &date : dates) {
+            const QVector<DutyHistory::Entry> entries = history.entriesOn(date, rosterIndex);
+            if (entries.isEmpty() && !parser.isSet(options.json) && !parser.isSet(options.csv))
+                text += date.toString("yyyy-MM-dd") + ' ' + locale.dayName(date.dayOfWeek(), QLocale::ShortFormat) + QStringLiteral(" 无记录\n");
+            for (const DutyHistory::Entry &entry : entries) {
+                const QString recordedAt = QDateTime::fromSecsSinceEpoch(entry.recordedAt, Qt::UTC).toString(Qt::ISODate);
+                if (parser.isSet(options.json)) {
+                    array.append(entryToJson(state, entry));
+                } else if (parser.isSet(options.csv)) {
+                    text += date.toString("yyyy-MM-dd") + ','
+                        + QString::number(entry.pair.first + 1) + ',' + csvField(state.label(entry.pair.first)) + ','
+                        + QString::number(entry.pair.second + 1) + ',' + csvField(state.label(entry.pair.second)) + ','
+                        + DutyHistory::reasonKey(entry.reason) + ',' + recordedAt + '\n';
+                } else {
+                    text += date.toString("yyyy-MM-dd") + ' ' + locale.dayName(date.dayOfWeek(), QLocale::ShortFormat)
+                        + ' ' + state.label(entry.pair.first) + ' ' + state.label(entry.pair.second)
+                        + ' ' + DutyHistory::reasonLabel(entry.reason) + ' '
+                        + QDateTime::fromSecsSinceEpoch(entry.recordedAt).toString("HH:mm") + '\n';
+                }
+            }
+        }
+        // 历史记录条数不固定，JSON总是数组
+        writeOut(parser.isSet(options.json) ? QJsonDocument(array).toJson(QJsonDocument::Compact) + '\n' : text.toUtf8());
+        return 0;
+    }
+
+    QVector<DutyRow> rows;
+    rows.reserve(dates.size());
+    for (const QDate &date : dates)
+        rows.append({ date, state.calendar.isWorkday(date), state.pairFor(date) });
+
+    QByteArray out;
+    if (parser.isSet(options.json)) {
+        if (isList) {
+            QJsonArray array;
+            for (const DutyRow &row : rows)
+                array.append(rowToJson(state, row));
+            out = QJsonDocument(array).toJson(QJsonDocument::Compact);
+        } else {
+            out = QJsonDocument(rowToJson(state, rows.first())).toJson(QJsonDocument::Compact);
+        }
+        out += '\n';
+    } else if (parser.isSet(options.csv)) {
+        QString text = QStringLiteral("date,workday,number1,name1,number2,name2\n");
+        for (const DutyRow &row : rows) {
+            text += row.date.toString("yyyy-MM-dd") + (row.workday ? ",1," : ",0,")
+                + QString::number(row.pair.first + 1) + ',' + csvField(state.label(row.pair.first)) + ','
+                + QString::number(row.pair.second + 1) + ',' + csvField(state.label(row.pair.second)) + '\n';
+        }
+        out = text.toUtf8();
+    } else {
+        const QLocale locale(QLocale::Chinese, QLocale::China);
+        QString text;
+        for (const DutyRow &row : rows) {
+            text += row.date.toString("yyyy-MM-dd") + ' ' + locale.dayName(row.date.dayOfWeek(), QLocale::ShortFormat)
+                + ' ' + state.label(row.pair.first) + ' ' + state.label(row.pair.second)
+                + (row.workday ? QString() : QStringLiteral(" (休息日)")) + '\n';
+        }
+        out = text.toUtf8();
+    }
+    writeOut(out);
+    return 0;
+}
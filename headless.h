@@ -0,0 +1,15 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+// 无界面查询：onduty --today / --date / --range [--roster n] [--history] [--json|--csv]
+// 只用QCoreApplication读取配置和状态日志，不创建窗口和托盘，默认不联网
+
+// 命令行中含有查询参数时返回true，此时不应创建QApplication
+bool isHeadlessCommand(int argc, char *argv[]);
+
+int runHeadless(int argc, char *argv[]);
+
+// Windows上的GUI程序从命令行启动时没有控制台，输出前连接到父进程的控制台；其他平台什么也不做
+void attachParentConsole();
+
+#endif // HEADLESS_H
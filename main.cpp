@@ -1,9 +1,6 @@
 #include <QApplication>
-#include <QHBoxLayout>
-#include <QLabel>
 #include <QPushButton>
 #include <QMessageBox>
-#include <QSettings>
 #include <QFont>
 #include <QGuiApplication>
 #include <QCheckBox>
@@ -17,12 +14,43 @@
 #include <QWindow>
 #include <QTimer>
 #include <QScreen>
-#include <QPropertyAnimation>
-#include <QGraphicsOpacityEffect>
-#include <QUdpSocket>
 #include <QDesktopServices>
 #include <QUrl>
 #include <QStandardPaths>
+#include <functional>
+#include "timeservice.h"
+#include "rolloverscheduler.h"
+#include "foregroundwatcher.h"
+#include "fadecontroller.h"
+#include "autohider.h"
+#include "configstore.h"
+#include "statejournal.h"
+#include "dutystate.h"
+#include "headless.h"
+#include "startuptrace.h"
+#include "dutyview.h"
+#include "metrics.h"
+#include "singleinstance.h"
+#ifdef ONDUTY_HAVE_NETWORK
+#include "peersync.h"
+#endif
+#include "taskscheduler.h"
+#include "dutyhistory.h"
+#include <QFileSystemWatcher>
+#include <QActionGroup>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QDialog>
+#include <QDialogButtonBox>
+#include <QDateEdit>
+#include <QPlainTextEdit>
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+#include <QLabel>
+#include <QLocale>
+#include <array>
+#include <cstdio>
 #ifdef Q_OS_WIN
 #include <windows.h>
 #include <objbase.h>
@@ -39,152 +67,74 @@
 //#include <AppKit/AppKit.h>
 #endif
 
+// 构建配置的名称，由CMake按是否精简构建定义
+#ifndef ONDUTY_PROFILE
+#define ONDUTY_PROFILE "full"
+#endif
+
 class DutyRosterApp : public QWidget
 {
     Q_OBJECT
 
 public:
-    bool isTestingMode = false;//考试模式
-    DutyRosterApp(QWidget *parent = nullptr) : QWidget(parent)
+    DutyState state;  // 值日状态，包括考试模式
+    bool footprintMode = false;  // --footprint：启动完成后输出内存占用并退出
+    DutyRosterApp(QWidget *parent = nullptr)
+        : QWidget(parent)
+        , stateJournal(QCoreApplication::applicationDirPath() + "/duty_state.journal")
+        , dutyHistory(QCoreApplication::applicationDirPath() + "/duty_history.dat")
     {
         // 设置配置文件路径为程序同目录
         configFilePath = QCoreApplication::applicationDirPath() + "/duty_config.ini";
+        configStore = new ConfigStore(configFilePath, this);
+        configStore->setHeader(DutyState::configHeader());
         setAttribute(Qt::WA_TransparentForMouseEvents, true);
-        loadConfig();
-        setupUI();
 
-        //检查开机启动
-        QString startupPath = QStandardPaths::writableLocation(QStandardPaths::ApplicationsLocation) + "/Startup/onduty.lnk";
-        if(QFileInfo::exists(startupPath)){
-            isStartupLaunch = true;
-        }else{
-            isStartupLaunch = false;
-        }
+        timeService = new TimeService(this);
 
-        setupTrayIcon();
-        if(!isTestingMode){
-            checkAndUpdateDuty(); // 在启动时检查并更新值日
-        }
-        updateDisplay();
-        positionToTopRight();
+        // 其他应用全屏或PPT放映时由后端推送通知
+        foregroundWatcher = ForegroundWatcher::create(this);
 
-        // 设置初始透明度
-        opacityEffect = new QGraphicsOpacityEffect(this);
-        opacityEffect->setOpacity(0.8);  // 初始透明度
-        this->setGraphicsEffect(opacityEffect);
+        StartupTrace::mark("services");
 
-        // 监听窗口状态变化
-        connect(qApp, &QGuiApplication::focusWindowChanged, this, &DutyRosterApp::onFocusWindowChanged);
+        loadConfig();
+        dutyHistory.open();
+        StartupTrace::mark("loadConfig");
+        setupUI();
+        StartupTrace::mark("setupUI");
 
-        // 设置PPT检测定时器
-        pptCheckTimer = new QTimer(this);
-        connect(pptCheckTimer, &QTimer::timeout, this, &DutyRosterApp::checkForPowerPointShow);
-        pptCheckTimer->start(1500); // 每1.5秒检测一次
+        // 设置初始透明度，所有淡入淡出都通过同一个控制器
+        fader = new FadeController(this, 0.8);
+        autoHider = new AutoHider(foregroundWatcher, fader, [this]() { return !state.isTestingMode; }, this);
+        connect(autoHider, &AutoHider::aboutToShow, this, &DutyRosterApp::positionToTopRight);
 
-        // 设置30分钟检查定时器
-        dutyCheckTimer = new QTimer(this);
-        connect(dutyCheckTimer, &QTimer::timeout, this, &DutyRosterApp::checkDutyPeriodically);
-        dutyCheckTimer->start(30 * 60 * 1000); // 每30分钟检查一次
+        // 先用缓存的时钟偏移显示当前组合，校时在第一帧之后进行
+        updateDisplay();
+        setupTrayIcon();
+        StartupTrace::mark("trayIcon");
+        positionToTopRight();
 
         // 启用鼠标跟踪
         setMouseTracking(true);
-        if(isTestingMode){
+        if(state.isTestingMode){
             this->hide();
+            // 不会绘制，直接进行剩余的初始化
+            QTimer::singleShot(0, this, &DutyRosterApp::finishStartup);
         }
     }
 
     ~DutyRosterApp()
     {
-        saveConfig();
+        compactJournal();
     }
 
 protected:
-    QDate getDateFromNtp(const QString &server = "time.google.com", int timeout = 3000)
-    {
-        QUdpSocket socket;
-    
-        // 连接到NTP服务器
-        socket.connectToHost(server, 123, QIODevice::ReadWrite);
-    
-        // 等待连接
-        if (!socket.waitForConnected(timeout)) {
-            qWarning() << "Failed to connect to NTP server:" << server;
-            return QDate();  // 返回无效日期
-        }
-    
-        // 构造NTP请求数据包（48字节）
-        QByteArray ntpRequest(48, 0);
-        // 设置NTP协议头：版本4，客户端模式
-        ntpRequest[0] = 0x1B;  // LI=0, Version=4, Mode=3 (客户端)
-    
-        // 发送请求
-        if (socket.write(ntpRequest) != ntpRequest.size()) {
-            qWarning() << "Failed to send NTP request";
-            return QDate();
-        }
-    
-        // 等待响应
-        if (!socket.waitForReadyRead(timeout)) {
-            qWarning() << "NTP response timeout";
-            return QDate();
-        }
-    
-        // 读取响应
-        QByteArray response = socket.readAll();
-        if (response.size() < 48) {
-            qWarning() << "Invalid NTP response size:" << response.size();
-            return QDate();
-        }
-    
-        // 解析NTP时间戳（第40-43字节：从1900年1月1日开始的秒数）
-        quint32 secondsSince1900 = 
-            ((quint8)response[40] << 24) |
-            ((quint8)response[41] << 16) |
-            ((quint8)response[42] << 8) |
-            (quint8)response[43];
-    
-        // NTP时间戳（1900年1月1日）到Unix时间戳（1970年1月1日）的偏移量
-        const quint64 ntpToUnixOffset = 2208988800ULL;
-    
-        // 转换为Unix时间戳
-        qint64 unixTimestamp = secondsSince1900 - ntpToUnixOffset;
-    
-        // 转换为QDateTime（UTC时间）
-        QDateTime dateTime = QDateTime::fromSecsSinceEpoch(unixTimestamp);
-    
-        // 返回QDate部分
-        return dateTime.date();
-    }
-
-    QDate getCurrentDate(int timeout = 2000)
-    {
-        // 常用NTP服务器列表（按优先级排序）
-        QStringList ntpServers = {
-            "cn.pool.ntp.org"       // 中国NTP池
-            "ntp.aliyun.com",       // 阿里云
-            "ntp1.aliyun.com",      // 阿里云备用
-            "time.google.com",      // Google时间服务器
-            "time.windows.com",     // Windows时间服务器
-            "pool.ntp.org",         // NTP池
-            "time.apple.com",       // Apple时间服务器
-            
-        };
-    
-        // 尝试每个服务器
-        for (const QString &server : ntpServers) {
-            QDate date = getDateFromNtp(server, timeout);
-            if (date.isValid()) {
-                qDebug() << "Successfully got date from" << server << ":" << date.toString("yyyy-MM-dd");
-                return date;
-            }
-            qWarning() << "Failed to get date from" << server;
-        }
-    
-        qWarning() << "All NTP servers failed";
-        return QDate::currentDate();  // 返回系统日期
+    // 获取当前日期：已有时钟偏移时直接本地计算，否则等待第一次NTP同步
+    void requestCurrentDate(std::function<void(const QDate &)> callback)
+    {
+        timeService->requestDate(std::move(callback));
     }
 
-
     void closeEvent(QCloseEvent *event) override
     {
         if (trayIcon->isVisible()) {
@@ -193,34 +143,43 @@ protected:
         }
     }
 
+    void paintEvent(QPaintEvent *event) override
+    {
+        QWidget::paintEvent(event);
+        if (!firstPaintDone) {
+            firstPaintDone = true;
+            StartupTrace::mark("firstPaint");
+            // 非关键的初始化放到第一帧之后
+            QTimer::singleShot(0, this, &DutyRosterApp::finishStartup);
+        }
+    }
+
     void showEvent(QShowEvent *event) override
     {
         QWidget::showEvent(event);
-        checkFullscreenState();
+        autoHider->recheck();
+        updateCycleTask();
+        updateSuspension();
     }
 
-    bool eventFilter(QObject *watched, QEvent *event) override
+    void hideEvent(QHideEvent *event) override
     {
-        // 监听窗口状态变化事件
-        if (event->type() == QEvent::WindowStateChange) {
-            QWindow *window = qobject_cast<QWindow*>(watched);
-            if (window) {
-                checkFullscreenState();
-            }
-        }
-        return QWidget::eventFilter(watched, event);
+        QWidget::hideEvent(event);
+        updateCycleTask();
+        updateSuspension();
     }
 
-
 private slots:
     void rotateDuty()
     {
-        if (checkAndUpdateDuty()) {
-            QMessageBox::information(this, "值日已更新",
-                QString("今天是%1，已更新值日安排。").arg(getCurrentDate().toString("yyyy-MM-dd dddd")));
-        } else {
-            QMessageBox::information(this, "提示", "今天的值日已经安排过了或今天是周末!");
-        }
+        requestCurrentDate([this](const QDate &today) {
+            if (checkAndUpdateDuty(today)) {
+                QMessageBox::information(this, "值日已更新",
+                    QString("今天是%1，已更新值日安排。").arg(today.toString("yyyy-MM-dd dddd")));
+            } else {
+                QMessageBox::information(this, "提示", "今天的值日已经安排过了或今天是周末!");
+            }
+        });
     }
 
     void toggleVisibility()
@@ -233,186 +192,145 @@ private slots:
         }
     }
 
-    void quitApplication()
+    void toggleTestingMode()
     {
-        saveConfig();
-        qApp->quit();
+        state.setTestingMode(!state.isTestingMode, timeService->currentDate());
+        autoHider->reset();
+        if (state.isTestingMode){
+            this->hide();
+        }
+        else{
+            this->show();
+            this->positionToTopRight();
+            this->updateDisplay();
+        }
+        updateTrayActions();
+        commitState();
+        updateSuspension();
     }
 
-    void iconActivated(QSystemTrayIcon::ActivationReason reason)
+    // 上一组/下一组：不改动轮换锚点，学期内记为计划中的调整
+    void stepDuty(int steps)
     {
-        if (reason == QSystemTrayIcon::DoubleClick) {
-            toggleVisibility();
-        }
+        const QDate today = timeService->currentDate();
+        state.stepDuty(steps, today);
+        commitState();
+        recordHistory(steps > 0 ? DutyHistory::Next : DutyHistory::Previous, today);
+        updateDisplay();
     }
 
-    void onFocusWindowChanged(QWindow *focusWindow)
+    // 切换显示的名单；只有当前名单的姓名留在内存中
+    void switchRoster(int index)
     {
-        if (focusWindow) {
-            // 监听焦点窗口的状态变化
-            focusWindow->installEventFilter(this);
-            checkFullscreenState();
-        }
+        if (index == state.currentRoster())
+            return;
+        state.selectRoster(index);
+        saveSettings();
+        updateDisplay();
+        updateTrayActions();
     }
 
-    void checkFullscreenState()
+    void setCycleRosters(bool enabled)
     {
-        bool hasFullscreen = false;
-
-        // 检查所有窗口
-        QList<QWindow*> windows = QGuiApplication::allWindows();
-        for (QWindow *window : windows) {
-            if (window && window->isVisible() &&
-                (window->visibility() == QWindow::FullScreen ||
-                 window->windowState() == Qt::WindowFullScreen)) {
-                hasFullscreen = true;
-                break;
-            }
-        }
-
-        // 处理窗口显示/隐藏
-        handleFullscreenState(hasFullscreen);
+        cycleRosters = enabled;
+        saveSettings();
+        updateCycleTask();
     }
 
-    void handleFullscreenState(bool hasFullscreen)
+    void quitApplication()
     {
-        // 如果有全屏应用且当前窗口可见，则隐藏
-        if (hasFullscreen && isVisible()) {
-            hide();
-            wasHiddenByFullscreen = true;
-        }
-        // 如果没有全屏应用且之前是因为全屏被隐藏的，则显示
-        else if (!hasFullscreen && wasHiddenByFullscreen && !isVisible()) {
-            show();
-            positionToTopRight();
-            wasHiddenByFullscreen = false;
-        }
+        compactJournal();
+        qApp->quit();
     }
 
-    // 检测PowerPoint是否正在放映
-    void checkForPowerPointShow()
+    void iconActivated(QSystemTrayIcon::ActivationReason reason)
     {
-        bool isPPTShowing = isPowerPointShowing();
-
-        if (isPPTShowing && isVisible()) {
-            // PPT正在放映，隐藏窗口
-            QGraphicsOpacityEffect *opacityEffect = new QGraphicsOpacityEffect(this);
-            QPropertyAnimation *animation = new QPropertyAnimation(opacityEffect, "opacity");
-            animation->setDuration(1500); // 动画持续1.5秒
-            animation->setStartValue(0.8);
-            animation->setEndValue(0.0);
-            animation->setEasingCurve(QEasingCurve::InOutQuad); // 设置缓动曲线
-            animation->start();
-            hide();
-            wasHiddenByPPT = true;
-            qDebug() << "检测到PowerPoint放映，隐藏窗口";
-        }
-        else if (!isPPTShowing && wasHiddenByPPT && !isVisible() && !isTestingMode) {
-            // PPT放映结束，显示窗口
-            show();
-            QGraphicsOpacityEffect *opacityEffect = new QGraphicsOpacityEffect(this);
-            QPropertyAnimation *animation = new QPropertyAnimation(opacityEffect, "opacity");
-            animation->setDuration(1500); // 动画持续1.5秒
-            animation->setStartValue(0.0);
-            animation->setEndValue(0.8);
-            animation->setEasingCurve(QEasingCurve::InOutQuad); // 设置缓动曲线
-            animation->start();
-            positionToTopRight();
-            wasHiddenByPPT = false;
-            qDebug() << "PowerPoint放映结束，显示窗口";
+        if (reason == QSystemTrayIcon::DoubleClick) {
+            toggleVisibility();
         }
     }
 
-    // 定期检查值日更新
-    void checkDutyPeriodically()
+    // 到达工作日零点时更新值日
+    void onDateRollover(const QDate &today)
     {
-        if (checkAndUpdateDuty()) {
-            //qDebug() << "定期检查：值日已更新 -" << QDateTime::currentDateTime().toString();
-            updateDisplay();
+        // 组合随日期变化（考试期间停住），不提示也要刷新显示
+        updateDisplay();
+        if (checkAndUpdateDuty(today)) {
+            //qDebug() << "换日：值日已更新 -" << QDateTime::currentDateTime().toString();
 
             // 可选：显示通知消息
             if (trayIcon && trayIcon->isVisible()) {
                 trayIcon->showMessage("值日已更新",
-                    QString("已自动更新值日安排\n%1").arg(getCurrentDate().toString("yyyy-MM-dd dddd")),
+                    QString("已自动更新值日安排\n%1").arg(today.toString("yyyy-MM-dd dddd")),
                     QSystemTrayIcon::Information, 3000);
             }
         }
     }
 
+public:
+    // 另一个进程转发来的命令，返回一行回复
+    QByteArray handleCommand(const QByteArray &command)
+    {
+        if (command == "query") {
+            const QDate today = timeService->currentDate();
+            const RotationEngine::Pair pair = state.pairFor(today);
+            QString text = today.toString("yyyy-MM-dd") + ' ' + state.label(pair.first) + ' ' + state.label(pair.second);
+            if (state.rosterCount() > 1)
+                text = state.title() + ' ' + text;
+            if (state.isTestingMode)
+                text += " (考试模式)";
+            return text.toUtf8();
+        }
+        if (command == "toggle-exam") {
+            toggleTestingMode();
+            return "ok";
+        }
+        if (command != "show" && command != "next" && command != "previous")
+            return "error 未知命令: " + command;
+        if (state.isTestingMode)
+            return "error 考试模式下不可用";
+
+        if (command == "next")
+            stepDuty(1);
+        else if (command == "previous")
+            stepDuty(-1);
+        // 被全屏或放映隐藏时不强行显示，恢复时自然会出现
+        if (!isVisible() && !autoHider->isAutoHidden()) {
+            show();
+            positionToTopRight();
+        }
+        return "ok";
+    }
+
 private:
     // 透明度动画函数
     void animateOpacity(qreal targetOpacity)
     {
-        QPropertyAnimation *animation = new QPropertyAnimation(opacityEffect, "opacity");
-        animation->setDuration(300); // 300毫秒的过渡动画
-        animation->setStartValue(opacityEffect->opacity());
-        animation->setEndValue(targetOpacity);
-        animation->setEasingCurve(QEasingCurve::InOutQuad);
-        animation->start(QPropertyAnimation::DeleteWhenStopped);
+        fader->fadeTo(targetOpacity, 300); // 300毫秒的过渡动画
     }
 
-    // 检测PowerPoint是否正在放映
-    bool isPowerPointShowing()
+    // 周一到周五，按节假日表放假和调休补班
+    bool isWorkday(const QDate &date) const
     {
-        #ifdef Q_OS_WIN 
-        // 方法1: 查找PowerPoint幻灯片放映窗口
-        HWND hwnd = FindWindowW(L"screenClass", L"PowerPoint 幻灯片放映");
-        if (hwnd && IsWindowVisible(hwnd)) {
-            return true;
-        }
-
-        // 方法2: 通过窗口类名查找
-        hwnd = FindWindowW(L"screenClass", nullptr);
-        while (hwnd) {
-            if (IsWindowVisible(hwnd)) {
-                wchar_t windowTitle[256];
-                GetWindowTextW(hwnd, windowTitle, 256);
-                if (wcsstr(windowTitle, L"PowerPoint") != nullptr ||
-                    wcsstr(windowTitle, L"幻灯片放映") != nullptr) {
-                    return true;
-                }
-            }
-            hwnd = FindWindowExW(nullptr, hwnd, L"screenClass", nullptr);
-        }
-
-        return false;
-        #else
-        // 非Windows平台暂不支持
-        return false;
-        #endif
+        return state.calendar.isWorkday(date);
     }
 
-    bool checkAndUpdateDuty()
+    bool checkAndUpdateDuty(const QDate &today)
     {
-        QDate today = getCurrentDate();
-        QString todayStr = today.toString("yyyyMMdd");
+#ifdef ONDUTY_HAVE_NETWORK
+        // 局域网同步时只有权威节点换日，跟随节点等它广播
+        if (peerSync && !peerSync->isAuthority())
+            return false;
+#endif
 
-        // 检查是否是工作日（周一到周五）
-        if (today.dayOfWeek() >= 1 && today.dayOfWeek() <= 5 && !isTestingMode)
+        // 工作日且今天还没有换过日时，所有名单一起换日
+        if (isWorkday(today) && !state.isTestingMode && state.advance(today))
         {
-            // 检查配置文件中是否已经更新过今天的值日
-            if (lastUpdateDate != todayStr)
-            {
-                // 轮换值日人员
-                currentDutyIndex1 = (currentDutyIndex1 + 2) % totalPersons;
-                currentDutyIndex2 = (currentDutyIndex2 + 2) % totalPersons;
-
-                // 确保两个人不同
-                while (currentDutyIndex1 == currentDutyIndex2)
-                {
-                    currentDutyIndex2 = (currentDutyIndex2 + 1) % totalPersons;
-                }
-
-                // 更新日期
-                lastUpdateDate = todayStr;
-                originIndex1 = currentDutyIndex1;
-                originIndex2 = currentDutyIndex2;
-
-                // 保存配置
-                saveConfig();
-                updateDisplay();
-                return true;
-            }
+            // 记录状态变化
+            commitState();
+            recordHistory(DutyHistory::Auto, today);
+            updateDisplay();
+            return true;
         }
         return false;
     }
@@ -424,69 +342,257 @@ private:
         setAttribute(Qt::WA_TranslucentBackground);
         //setAttribute(Qt::WA_TransparentForMouseEvents, true);
 
-        QWidget *mainWidget = new QWidget(this);
-        mainWidget->setStyleSheet("background-color: rgba(255, 255, 255, 200); border-radius: 10px; border: 2px solid #dddddd;");
-
-        QVBoxLayout *mainLayout = new QVBoxLayout(mainWidget);
-        QVBoxLayout *outerLayout = new QVBoxLayout(this);
-        outerLayout->addWidget(mainWidget);
-        outerLayout->setContentsMargins(5, 5, 5, 5);
-
-        // 标题栏
-        QHBoxLayout *titleLayout = new QHBoxLayout();
-        QLabel *titleLabel = new QLabel("值日安排");
-        titleLabel->setStyleSheet("min-width: 60px;border: none;font-size: 14pt;background: none;");
-        QFont titleFont = titleLabel->font();
-        titleFont.setPointSize(14);
-        titleFont.setBold(true);
-        titleLabel->setFont(titleFont);
-
-        titleLayout->addWidget(titleLabel);
-        titleLayout->addStretch();
-        mainLayout->addLayout(titleLayout);
-
-        // 值日人员显示
-        QHBoxLayout *dutyLayout = new QHBoxLayout();
-        duty1Label = new QLabel();
-        duty2Label = new QLabel();
-        QFont dutyFont = duty1Label->font();
-        dutyFont.setPointSize(18);
-        dutyFont.setBold(true);
-        duty1Label->setFont(dutyFont);
-        duty2Label->setFont(dutyFont);
-        duty1Label->setAlignment(Qt::AlignCenter);
-        duty2Label->setAlignment(Qt::AlignCenter);
-
-        QLabel *andlabel = new QLabel("&");
-        andlabel->setStyleSheet("max-width: 15px;border: none;font-size: 12pt;font-weight: bold;background: none;");
-
-        dutyLayout->addWidget(duty1Label);
-        dutyLayout->addWidget(andlabel);
-        dutyLayout->addWidget(duty2Label);
-        mainLayout->addLayout(dutyLayout);
-
+        // 背景、标题和名字都由同一个控件绘制
+        dutyView = new DutyView(this);
         setFixedSize(240, 140);
+        dutyView->setGeometry(rect());
+    }
+
+    // 第一帧之后：文件监视、校时、值日检查和换日调度
+    void finishStartup()
+    {
+        if (rolloverScheduler)
+            return;
+
+        setupRosterWatcher();
+        setupPeerSync();
+        // 运行中手动修改配置文件时只应用改动的键
+        connect(configStore, &ConfigStore::externallyChanged, this, &DutyRosterApp::onConfigChanged);
+        configStore->setWatched(true);
+
+        if(!state.isTestingMode){
+            // 在启动时检查并更新值日
+            requestCurrentDate([this](const QDate &today) { checkAndUpdateDuty(today); });
+        }
+        // 后台重新校时，成功后保存偏移并以校正后的日期再检查一次
+        connect(timeService, &TimeService::synced, this, [this]() {
+            saveSettings();
+            if (!state.isTestingMode)
+                checkAndUpdateDuty(timeService->currentDate());
+        });
+        timeService->sync();
+
+        // 在下一个工作日零点准时换日，期间不再唤醒
+        rolloverScheduler = new RolloverScheduler(timeService, [this](const QDate &date) { return isWorkday(date); }, this);
+        connect(rolloverScheduler, &RolloverScheduler::rollover, this, &DutyRosterApp::onDateRollover);
+        // 以考试模式启动时窗口从未显示过，没有hideEvent
+        updateSuspension();
+
+        StartupTrace::finish("deferredInit", QCoreApplication::applicationDirPath() + "/startup_metrics.jsonl");
+        if (footprintMode) {
+            // 等托盘和字体缓存等延迟分配完成后再测量
+            const double startupMs = StartupTrace::elapsedMs();
+            QTimer::singleShot(1000, this, [this, startupMs]() { printFootprint(startupMs); });
+        }
+    }
+
+    // 供构建时的 footprint 目标读取：输出一行JSON后退出
+    void printFootprint(double startupMs)
+    {
+        QJsonObject footprint;
+        footprint["profile"] = QStringLiteral(ONDUTY_PROFILE);
+        footprint["residentBytes"] = Metrics::residentBytes();
+        footprint["startupMs"] = startupMs;
+        footprint["binaryBytes"] = QFileInfo(QCoreApplication::applicationFilePath()).size();
+        footprint["qt"] = QString::fromLatin1(qVersion());
+        attachParentConsole();
+        const QByteArray line = QJsonDocument(footprint).toJson(QJsonDocument::Compact) + '\n';
+        std::fwrite(line.constData(), 1, size_t(line.size()), stdout);
+        std::fflush(stdout);
+        quitApplication();
+    }
+
+    // 局域网同步：先等待已有的权威节点，期间不做NTP校时；成为权威节点后补做换日检查
+    void setupPeerSync()
+    {
+#ifdef ONDUTY_HAVE_NETWORK
+        if (!peerEnabled)
+            return;
+        peerSync = new PeerSync(&state, timeService, peerSettings, this);
+        if (!peerSync->start()) {
+            delete peerSync;
+            peerSync = nullptr;
+            return;
+        }
+        connect(peerSync, &PeerSync::stateApplied, this, &DutyRosterApp::onPeerStateApplied);
+        connect(peerSync, &PeerSync::roleChanged, this, [this](PeerSync::Role role) {
+            if (role == PeerSync::Authority)
+                checkAndUpdateDuty(timeService->currentDate());
+        });
+#endif
+    }
+
+    // 权威节点同步来的状态：记入本地日志，考试模式的变化同样隐藏或显示窗口
+    void onPeerStateApplied()
+    {
+        if (state.isTestingMode && isVisible()) {
+            hide();
+        } else if (!state.isTestingMode && !isVisible() && !autoHider->isAutoHidden()) {
+            show();
+            positionToTopRight();
+        }
+        updateTrayActions();
+        commitState();
+        recordHistory(DutyHistory::Sync, timeService->currentDate());
+        updateDisplay();
+        updateSuspension();
     }
 
+    // 配置文件被手动修改：按改动的键重新应用对应的部分，不重启、不重新校时，也不写回配置文件
+    void onConfigChanged(const QStringList &keys)
+    {
+        const QDate today = timeService->currentDate();
+        const bool wasTesting = state.isTestingMode;
+        const int scope = state.applyChangedKeys(*configStore, keys, QCoreApplication::applicationDirPath(), today);
+        if (scope & DutyState::ReloadCalendar) {
+            loadCalendar();
+            if (rolloverScheduler)
+                rolloverScheduler->rearm();
+        }
+        if (scope & DutyState::ReloadRosters) {
+            journaledState.resize(state.rosterCount());
+            loadRosters();
+            updateWatchedFiles();
+            resetTrayMenu();
+        }
+        // 改动的轮换字段记入日志，以后重放日志时不会被旧记录覆盖
+        if (scope & DutyState::ReloadState)
+            commitState();
+
+        bool cycleChanged = false;
+        bool peerChanged = false;
+        for (const QString &key : keys) {
+            if (key == "time/resyncMinutes")
+                timeService->setResyncInterval(configStore->value(key, 360).toInt());
+            else if (key == "settings/cycleRosters" || key == "settings/cycleSeconds")
+                cycleChanged = true;
+            else if (key.startsWith("peer/"))
+                peerChanged = true;
+        }
+#ifdef ONDUTY_HAVE_NETWORK
+        if (peerChanged) {
+            readPeerSettings(*configStore);
+            delete peerSync;
+            peerSync = nullptr;
+            setupPeerSync();
+        }
+#else
+        Q_UNUSED(peerChanged);
+#endif
+        if (cycleChanged) {
+            cycleRosters = configStore->value("settings/cycleRosters", false).toBool();
+            cycleSeconds = qMax(3, configStore->value("settings/cycleSeconds", 20).toInt());
+            if (rosterCycleTask)
+                rosterCycleTask->stop();
+            resetTrayMenu();
+        }
+
+        if (state.isTestingMode != wasTesting) {
+            autoHider->reset();
+            if (state.isTestingMode) {
+                hide();
+            } else {
+                show();
+                positionToTopRight();
+            }
+        }
+        updateTrayActions();
+        updateDisplay();
+        updateCycleTask();
+        updateSuspension();
+    }
+
+    // 菜单按名单个数和标题创建，这些设置改变后清空，下次打开时重新创建
+    void resetTrayMenu()
+    {
+        if (!toggleTestingModeAction)
+            return;
+        trayMenu->hide();
+        QList<QMenu *> menus;
+        QList<QAction *> ownActions;
+        for (QAction *action : trayMenu->actions()) {
+            if (action->menu())
+                menus.append(action->menu());
+            else if (action->parent() == this)
+                ownActions.append(action);
+        }
+        trayMenu->clear();
+        qDeleteAll(ownActions);
+        for (QMenu *menu : std::as_const(menus)) {
+            qDeleteAll(menu->actions());
+            delete menu;
+        }
+        toggleTestingModeAction = nullptr;
+        cycleRostersAction = nullptr;
+        dutyActions.clear();
+        rosterActions.clear();
+    }
+
+    // 托盘图标立即显示，菜单在第一次打开时才创建
     void setupTrayIcon()
     {
         trayIcon = new QSystemTrayIcon(this);
         trayIcon->setIcon(QIcon(":/board.png")); // 替换为你的图标路径
         trayIcon->setToolTip("值日安排");
 
+        trayMenu = new QMenu(this);
+        connect(trayMenu, &QMenu::aboutToShow, this, &DutyRosterApp::buildTrayMenu);
+        trayIcon->setContextMenu(trayMenu);
+
+        connect(trayIcon, &QSystemTrayIcon::activated, this, [this](QSystemTrayIcon::ActivationReason reason){
+            if (reason == QSystemTrayIcon::Trigger) // 左键单击
+            {
+                // 获取托盘图标的位置并显示菜单
+                QPoint pos = QCursor::pos();
+                trayMenu->popup(pos);
+            }
+        });
+        connect(trayIcon, &QSystemTrayIcon::activated, this, &DutyRosterApp::iconActivated);
+        trayIcon->show();
+
+        // 初始化考试模式状态
+        autoHider->reset();
+        if (state.isTestingMode){
+            this->hide();
+        }
+        else{
+            this->show();
+            positionToTopRight();
+        }
+    }
+
+    // 考试模式下禁用值日相关的菜单项
+    void updateTrayActions()
+    {
+        if (!toggleTestingModeAction)
+            return;
+        toggleTestingModeAction->setText(state.isTestingMode ? "禁用考试模式" : "启用考试模式");
+        for (QAction *action : dutyActions)
+            action->setEnabled(!state.isTestingMode);
+        if (!rosterActions.isEmpty())
+            rosterActions[state.currentRoster()]->setChecked(true);
+    }
+
+    void buildTrayMenu()
+    {
+        if (toggleTestingModeAction)
+            return;
 
+        //检查开机启动
+        QString startupPath = QStandardPaths::writableLocation(QStandardPaths::ApplicationsLocation) + "/Startup/onduty.lnk";
+        if(QFileInfo::exists(startupPath)){
+            isStartupLaunch = true;
+        }else{
+            isStartupLaunch = false;
+        }
+        saveSettings();
 
-        QMenu *trayMenu = new QMenu(this);
         QAction *updateAction = new QAction("刷新", this);
         QAction *lastDutyAction=new QAction("上一组值日",this);
         QAction *rotateAction = new QAction("下一组值日", this);
         QAction *BackupAction = new QAction("恢复", this);
         QAction *toggleAction = new QAction("显示/隐藏窗口", this);
-        QAction *toggleTestingModeAction = new QAction(this);
-        if(!isTestingMode)
-            toggleTestingModeAction->setText("启用考试模式");
-        else
-            toggleTestingModeAction->setText("禁用考试模式");
+        toggleTestingModeAction = new QAction(this);
         QMenu *settingsMenu = new QMenu("设置", this);
         QAction *openConfigAction = new QAction("打开配置文件", this);
         QAction *createLaunchAction = new QAction(this);
@@ -496,104 +602,50 @@ private:
             createLaunchAction->setText("移除开机启动项");
         settingsMenu->addAction(openConfigAction);
         settingsMenu->addAction(createLaunchAction);
+        QAction *historyAction = new QAction("历史记录", this);
+        QAction *diagnosticsAction = new QAction("诊断", this);
         QAction *quitAction = new QAction("退出", this);
 
-        connect(trayIcon, &QSystemTrayIcon::activated, this, [=,this](QSystemTrayIcon::ActivationReason reason){
-            if (reason == QSystemTrayIcon::Trigger) // 左键单击
-            {
-                // 获取托盘图标的位置并显示菜单
-                QPoint pos = QCursor::pos();
-                trayMenu->popup(pos);
+        // 多个名单时可以切换或轮流显示
+        QMenu *rosterMenu = nullptr;
+        if (state.rosterCount() > 1) {
+            rosterMenu = new QMenu("名单", this);
+            QActionGroup *rosterGroup = new QActionGroup(rosterMenu);
+            for (int i = 0; i < state.rosterCount(); ++i) {
+                QAction *action = rosterMenu->addAction(state.rosterFile(i).title);
+                action->setCheckable(true);
+                rosterGroup->addAction(action);
+                connect(action, &QAction::triggered, this, [this, i]() { switchRoster(i); });
+                rosterActions.append(action);
             }
-        });
-
-        // 初始化考试模式状态
-        if (isTestingMode){
-            toggleTestingModeAction->setText("禁用考试模式");
-            this->hide();
-            wasHiddenByFullscreen=false;
-            wasHiddenByPPT=false;
-            updateAction->setEnabled(false);
-            lastDutyAction->setEnabled(false);
-            rotateAction->setEnabled(false);
-            BackupAction->setEnabled(false);
-            toggleAction->setEnabled(false);
+            rosterMenu->addSeparator();
+            cycleRostersAction = rosterMenu->addAction(QString("每%1秒轮流显示").arg(cycleSeconds));
+            cycleRostersAction->setCheckable(true);
+            cycleRostersAction->setChecked(cycleRosters);
+            connect(cycleRostersAction, &QAction::toggled, this, &DutyRosterApp::setCycleRosters);
         }
-        else{
-            toggleTestingModeAction->setText("启用考试模式");
-            this->show();
-            wasHiddenByFullscreen=false;
-            wasHiddenByPPT=false;
-            positionToTopRight();
-            updateAction->setEnabled(true);
-            lastDutyAction->setEnabled(true);
-            rotateAction->setEnabled(true);
-            BackupAction->setEnabled(true);
-            toggleAction->setEnabled(true);
-        }
-
-        connect(toggleTestingModeAction, &QAction::triggered, this, [=,this]() {
-            isTestingMode = !isTestingMode;
-            if (isTestingMode){
-                toggleTestingModeAction->setText("禁用考试模式");
-                this->hide();
-                wasHiddenByFullscreen=false;
-                wasHiddenByPPT=false;
-                updateAction->setEnabled(false);
-                lastDutyAction->setEnabled(false);
-                rotateAction->setEnabled(false);
-                BackupAction->setEnabled(false);
-                toggleAction->setEnabled(false);
-            }
-            else{
-                toggleTestingModeAction->setText("启用考试模式");
-                this->show();
-                wasHiddenByFullscreen=false;
-                wasHiddenByPPT=false;
-                positionToTopRight();
-                updateAction->setEnabled(true);
-                lastDutyAction->setEnabled(true);
-                rotateAction->setEnabled(true);
-                BackupAction->setEnabled(true);
-                toggleAction->setEnabled(true);
-                this->show();
-                this->positionToTopRight();
-                this->updateDisplay();
-            }
-            saveConfig();
-        });
-        connect(updateAction, &QAction::triggered, this, &DutyRosterApp::checkAndUpdateDuty);
 
-        connect(lastDutyAction, &QAction::triggered, this, [=,this]()
-        {
-            currentDutyIndex1 -= 2 ;
-            currentDutyIndex2 -= 2;
-            if (currentDutyIndex1<0)currentDutyIndex1+=totalPersons;
-            if (currentDutyIndex2<0)currentDutyIndex2+=totalPersons;
-            saveConfig();
-            updateDisplay();
+        dutyActions = { updateAction, lastDutyAction, rotateAction, BackupAction, toggleAction };
+        updateTrayActions();
 
+        connect(toggleTestingModeAction, &QAction::triggered, this, &DutyRosterApp::toggleTestingMode);
+        connect(updateAction, &QAction::triggered, this, [this]() {
+            requestCurrentDate([this](const QDate &today) { checkAndUpdateDuty(today); });
         });
 
-        connect(rotateAction, &QAction::triggered, this, [=,this]() {
-            currentDutyIndex1 = (currentDutyIndex1 + 2) % totalPersons;
-            currentDutyIndex2 = (currentDutyIndex2 + 2) % totalPersons;
-            // 确保两个人不同
-            if (currentDutyIndex1 == currentDutyIndex2)
-                currentDutyIndex2 = (currentDutyIndex2 + 1) % totalPersons;
-
-            // 保存配置
-            saveConfig();
-            updateDisplay();
-        });
+        connect(lastDutyAction, &QAction::triggered, this, [this]() { stepDuty(-1); });
+        connect(rotateAction, &QAction::triggered, this, [this]() { stepDuty(1); });
         connect(toggleAction, &QAction::triggered, this, &DutyRosterApp::toggleVisibility);
+        connect(historyAction, &QAction::triggered, this, &DutyRosterApp::showHistory);
+        connect(diagnosticsAction, &QAction::triggered, this, &DutyRosterApp::showDiagnostics);
         connect(quitAction, &QAction::triggered, this, &DutyRosterApp::quitApplication);
 
         connect(BackupAction, &QAction::triggered, this, [=,this](){
-            if(isTestingMode){
-                currentDutyIndex1 = originIndex1;
-                currentDutyIndex2 = originIndex2;
-                saveConfig();
+            if(state.isTestingMode){
+                const QDate today = timeService->currentDate();
+                state.restoreDuty(today);
+                commitState();
+                recordHistory(DutyHistory::Restore, today);
                 updateDisplay();
             }
         });
@@ -611,7 +663,7 @@ private:
                     QMessageBox::information(this, "移除成功", "已移除开机启动项。");
                     isStartupLaunch = false;
                     createLaunchAction->setText("创建开机启动项");
-                    saveConfig();
+                    saveSettings();
                 } else {
                     QMessageBox::warning(this, "移除失败", "无法移除开机启动项。");
                 }
@@ -633,7 +685,7 @@ private:
                     QMessageBox::information(this, "快捷方式创建成功", "已在开机启动文件夹创建快捷方式。");
                     isStartupLaunch = true;
                     createLaunchAction->setText("移除开机启动项");
-                    saveConfig();
+                    saveSettings();
                 } else {
                     QMessageBox::warning(this, "快捷方式创建失败", "无法创建快捷方式。");
                 }
@@ -650,15 +702,124 @@ private:
         trayMenu->addAction(rotateAction);
         trayMenu->addAction(BackupAction);
         trayMenu->addAction(toggleAction);
+        if (rosterMenu)
+            trayMenu->addMenu(rosterMenu);
         trayMenu->addAction(toggleTestingModeAction);
         trayMenu->addSeparator();
         trayMenu->addMenu(settingsMenu);
+        trayMenu->addAction(historyAction);
+        trayMenu->addAction(diagnosticsAction);
         trayMenu->addSeparator();
         trayMenu->addAction(quitAction);
+    }
 
-        trayIcon->setContextMenu(trayMenu);
-        connect(trayIcon, &QSystemTrayIcon::activated, this, &DutyRosterApp::iconActivated);
-        trayIcon->show();
+    // 按日期范围查询值日历史，默认最近30天
+    void showHistory()
+    {
+        const QDate today = timeService->currentDate();
+        QDialog dialog(this);
+        dialog.setWindowTitle("历史记录");
+        QDateEdit *fromEdit = new QDateEdit(today.addDays(-30), &dialog);
+        QDateEdit *toEdit = new QDateEdit(today, &dialog);
+        for (QDateEdit *edit : { fromEdit, toEdit }) {
+            edit->setCalendarPopup(true);
+            edit->setDisplayFormat("yyyy-MM-dd");
+        }
+        QPlainTextEdit *output = new QPlainTextEdit(&dialog);
+        output->setReadOnly(true);
+        QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Close, &dialog);
+        connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+
+        QHBoxLayout *rangeLayout = new QHBoxLayout();
+        rangeLayout->addWidget(new QLabel("从", &dialog));
+        rangeLayout->addWidget(fromEdit);
+        rangeLayout->addWidget(new QLabel("到", &dialog));
+        rangeLayout->addWidget(toEdit);
+        rangeLayout->addStretch();
+        QVBoxLayout *layout = new QVBoxLayout(&dialog);
+        layout->addLayout(rangeLayout);
+        layout->addWidget(output);
+        layout->addWidget(buttons);
+
+        // 其他名单的姓名只在这里临时加载
+        QVector<Roster> rosters(state.rosterCount());
+        const auto label = [this, &rosters](int roster, int index) {
+            if (roster == state.currentRoster())
+                return state.label(index);
+            if (rosters[roster].isEmpty())
+                rosters[roster].load(state.rosterFile(roster).filePath);
+            const QString name = rosters[roster].name(index);
+            return name.isEmpty() ? QString::number(index + 1) : name;
+        };
+        const QLocale locale(QLocale::Chinese, QLocale::China);
+        const auto refresh = [&]() {
+            QStringList lines;
+            for (const DutyHistory::Entry &entry : dutyHistory.entriesBetween(fromEdit->date(), toEdit->date())) {
+                if (entry.roster >= state.rosterCount())
+                    continue;
+                QString line = entry.date.toString("yyyy-MM-dd") + ' '
+                    + locale.dayName(entry.date.dayOfWeek(), QLocale::ShortFormat) + "  " + label(entry.roster, entry.pair.first) + " "
+                    + label(entry.roster, entry.pair.second) + "  " + DutyHistory::reasonLabel(entry.reason) + " "
+                    + QDateTime::fromSecsSinceEpoch(entry.recordedAt).toString("HH:mm");
+                if (state.rosterCount() > 1)
+                    line.prepend(state.rosterFile(entry.roster).title + "  ");
+                lines << line;
+            }
+            output->setPlainText(lines.isEmpty() ? QStringLiteral("这段时间没有记录") : lines.join('\n'));
+        };
+        connect(fromEdit, &QDateEdit::dateChanged, &dialog, refresh);
+        connect(toEdit, &QDateEdit::dateChanged, &dialog, refresh);
+        refresh();
+
+        dialog.resize(460, 360);
+        dialog.exec();
+    }
+
+    // 显示运行指标，可以保存为JSON
+    void showDiagnostics()
+    {
+        QMessageBox box(QMessageBox::Information, "诊断", Metrics::summary(), QMessageBox::Close, this);
+        const QByteArray json = QJsonDocument(Metrics::snapshot()).toJson(QJsonDocument::Indented);
+        box.setDetailedText(QString::fromUtf8(json));
+        QPushButton *saveButton = box.addButton("保存JSON", QMessageBox::ActionRole);
+        box.exec();
+        if (box.clickedButton() != saveButton)
+            return;
+
+        const QString path = QCoreApplication::applicationDirPath() + "/metrics.json";
+        QSaveFile file(path);
+        if (file.open(QIODevice::WriteOnly) && file.write(json) == json.size() && file.commit())
+            QMessageBox::information(this, "诊断", "已保存到 " + QDir::toNativeSeparators(path));
+        else
+            QMessageBox::warning(this, "诊断", "无法保存 " + QDir::toNativeSeparators(path));
+    }
+
+    // 轮流显示只在窗口可见时计时，隐藏、考试模式或只有一个名单时没有唤醒
+    void updateCycleTask()
+    {
+        const bool run = cycleRosters && state.rosterCount() > 1 && isVisible();
+        if (run && !rosterCycleTask) {
+            rosterCycleTask = new ScheduledTask("rosterCycle", 1000, this);
+            connect(rosterCycleTask, &ScheduledTask::timeout, this, [this]() {
+                Metrics::increment(Metrics::RosterCycleWakeups);
+                if (state.selectRoster((state.currentRoster() + 1) % state.rosterCount()))
+                    saveSettings();
+                updateDisplay();
+                updateTrayActions();
+            });
+        }
+        if (!rosterCycleTask)
+            return;
+        if (run && !rosterCycleTask->isActive())
+            rosterCycleTask->start(cycleSeconds * 1000);
+        else if (!run)
+            rosterCycleTask->stop();
+    }
+
+    // 考试模式下窗口隐藏时暂停所有周期任务，只剩延迟写入和进行中的校时
+    void updateSuspension()
+    {
+        TaskScheduler::global()->setSuspended(state.isTestingMode && !isVisible());
     }
 
     void positionToTopRight()
@@ -670,106 +831,318 @@ private:
         move(x, y);
     }
 
+    // 当前组合由日期和手动调整的步数直接算出
+    void refreshPair()
+    {
+        const RotationEngine::Pair pair = state.pairFor(timeService->currentDate());
+        currentDutyIndex1 = pair.first;
+        currentDutyIndex2 = pair.second;
+    }
+
     void updateDisplay()
     {
-        duty1Label->setText(QString::number(currentDutyIndex1 + 1));
-        duty2Label->setText(QString::number(currentDutyIndex2 + 1));
-        repaint();
+        refreshPair();
+        dutyView->setTitle(state.title());
+        dutyView->setNames(state.label(currentDutyIndex1), state.label(currentDutyIndex2));
     }
 
-    void loadConfig()
+    // 读取所有名单，人数以名单为准
+    void loadRosters()
+    {
+        rosterStamps.resize(state.rosterCount());
+        planStamps.resize(state.rosterCount());
+        for (int i = 0; i < state.rosterCount(); ++i) {
+            fileChanged(state.rosterFile(i).filePath, rosterStamps[i]);
+            fileChanged(state.rosterFile(i).planFilePath, planStamps[i]);
+        }
+        if (state.loadRosters())
+            saveSettings();
+    }
+
+    struct FileStamp {
+        QDateTime modified;
+        qint64 size = -1;
+    };
+
+    // 名单文件变化时重新加载；同时监视目录，以便发现新建或被整体替换的文件
+    // 文件的修改时间或大小变化时返回true并记下新值
+    static bool fileChanged(const QString &filePath, FileStamp &stamp)
+    {
+        const QFileInfo info(filePath);
+        const QDateTime newModified = info.exists() ? info.lastModified() : QDateTime();
+        const qint64 newSize = info.exists() ? info.size() : -1;
+        if (newModified == stamp.modified && newSize == stamp.size)
+            return false;
+        stamp.modified = newModified;
+        stamp.size = newSize;
+        return true;
+    }
+
+    void loadCalendar()
     {
-        QSettings config(configFilePath, QSettings::IniFormat);
+        fileChanged(state.holidayFilePath, holidayStamp);
+        state.loadCalendar();
+    }
+
+    // 所有名单文件、约束文件和节假日文件
+    QStringList watchedFiles() const
+    {
+        QStringList files;
+        for (int i = 0; i < state.rosterCount(); ++i) {
+            files.append(state.rosterFile(i).filePath);
+            if (!state.rosterFile(i).planFilePath.isEmpty())
+                files.append(state.rosterFile(i).planFilePath);
+        }
+        files.append(state.holidayFilePath);
+        return files;
+    }
+
+    // 名单和节假日文件都在这里监视
+    void setupRosterWatcher()
+    {
+        rosterReloadTask = new ScheduledTask("fileReload", 300, this);
+        rosterReloadTask->setSingleShot(true);
+        rosterReloadTask->setInterval(200);
+        connect(rosterReloadTask, &ScheduledTask::timeout, this, [this]() {
+            Metrics::increment(Metrics::FileReloadWakeups);
+            bool changed = false;
+            for (int i = 0; i < state.rosterCount(); ++i) {
+                if (fileChanged(state.rosterFile(i).filePath, rosterStamps[i])) {
+                    if (state.loadRoster(i))
+                        saveSettings();
+                    fileChanged(state.rosterFile(i).planFilePath, planStamps[i]);
+                    changed = true;
+                } else if (fileChanged(state.rosterFile(i).planFilePath, planStamps[i])) {
+                    // 只重排改动的约束影响到的日子
+                    state.loadPlan(i);
+                    changed = true;
+                }
+            }
+            if (fileChanged(state.holidayFilePath, holidayStamp)) {
+                state.loadCalendar();
+                rolloverScheduler->rearm();
+                changed = true;
+            }
+            for (const QString &path : watchedFiles()) {
+                if (QFileInfo::exists(path) && !rosterWatcher->files().contains(path))
+                    rosterWatcher->addPath(path);
+            }
+            if (changed)
+                updateDisplay();
+        });
 
-        currentDutyIndex1 = config.value("duty/index1", 0).toInt();
-        currentDutyIndex2 = config.value("duty/index2", 1).toInt();
-        lastUpdateDate = config.value("date/lastUpdate", "").toString();
+        rosterWatcher = new QFileSystemWatcher(this);
+        updateWatchedFiles();
+        connect(rosterWatcher, &QFileSystemWatcher::fileChanged, rosterReloadTask, qOverload<>(&ScheduledTask::start));
+        connect(rosterWatcher, &QFileSystemWatcher::directoryChanged, rosterReloadTask, qOverload<>(&ScheduledTask::start));
+    }
+
+    // 名单设置改变后新的文件和目录也要监视
+    void updateWatchedFiles()
+    {
+        if (!rosterWatcher)
+            return;
+        for (const QString &path : watchedFiles()) {
+            const QString dir = QFileInfo(path).absolutePath();
+            if (!rosterWatcher->directories().contains(dir))
+                rosterWatcher->addPath(dir);
+            if (QFileInfo::exists(path) && !rosterWatcher->files().contains(path))
+                rosterWatcher->addPath(path);
+        }
+    }
 
-        originIndex1 = config.value("origin/index1", 0).toInt();
-        originIndex2 = config.value("origin/index2", 1).toInt();
+    void loadConfig()
+    {
+        const bool exists = configStore->load();
+        const ConfigStore &config = *configStore;
 
-        isTestingMode = config.value("settings/testingMode", false).toBool();
-        totalPersons = config.value("settings/totalPersons", 47).toInt();
         isStartupLaunch = config.value("settings/startupLaunch", false).toBool();
+        state.readSettings(config, QCoreApplication::applicationDirPath());
+        loadCalendar();
+
+        timeService->setResyncInterval(config.value("time/resyncMinutes", 360).toInt());
+        timeService->restoreOffset(config.value("time/offsetMs", 0).toLongLong(),
+                                   QDateTime::fromString(config.value("time/lastSync").toString(), Qt::ISODate));
+
+#ifdef ONDUTY_HAVE_NETWORK
+        readPeerSettings(config);
+#endif
+
+        cycleRosters = config.value("settings/cycleRosters", false).toBool();
+        cycleSeconds = qMax(3, config.value("settings/cycleSeconds", 20).toInt());
+
+        // 先读名单：迁移旧配置时要用实际人数
+        loadRosters();
+
+        const bool snapshotStale = state.restore(config, stateJournal, timeService->currentDate());
+        journaledState.resize(state.rosterCount());
+        for (int i = 0; i < state.rosterCount(); ++i) {
+            for (StateJournal::Field field : DutyState::liveFields)
+                journaledState[i][field] = state.field(field, i);
+        }
 
-        // 如果配置文件不存在，创建默认配置
-        if (!QFile::exists(configFilePath)) {
-            saveConfig();
+        // 配置文件不存在时创建默认配置，有日志或迁移时合并进快照
+        if (!exists || snapshotStale) {
+            compactJournal();
         }
     }
 
-    void saveConfig()
+#ifdef ONDUTY_HAVE_NETWORK
+    void readPeerSettings(const ConfigStore &config)
     {
-        QSettings config(configFilePath, QSettings::IniFormat);
-        
-        config.clear(); // 清除旧配置
-        
-        config.setValue("duty/index1", currentDutyIndex1);
-        config.setValue("duty/index2", currentDutyIndex2);
-        config.setValue("date/lastUpdate", lastUpdateDate);
+        peerEnabled = config.value("peer/enabled", false).toBool();
+        peerSettings.room = config.value("peer/room", peerSettings.room).toString();
+        peerSettings.group = QHostAddress(config.value("peer/group", peerSettings.group.toString()).toString());
+        peerSettings.port = quint16(config.value("peer/port", peerSettings.port).toUInt());
+        peerSettings.priority = config.value("peer/priority", 0).toInt();
+        peerSettings.interfaceName = config.value("peer/interface").toString();
+    }
+#endif
+
+    // 值日状态变化：每个改变的字段只追加一条日志记录，不重写配置文件
+    void commitState()
+    {
+        for (int i = 0; i < state.rosterCount(); ++i) {
+            for (StateJournal::Field field : DutyState::liveFields) {
+                const qint64 value = state.field(field, i);
+                if (journaledState[i][field] != value && stateJournal.append(field, value, i))
+                    journaledState[i][field] = value;
+            }
+        }
+        if (stateJournal.pendingRecords() >= 64)
+            compactJournal();
+#ifdef ONDUTY_HAVE_NETWORK
+        if (peerSync)
+            peerSync->publish();
+#endif
+    }
+
+    // 组合与该名单最近一条历史记录不同（或不是同一天）时追加一条，没有变化的名单不记录
+    void recordHistory(DutyHistory::Reason reason, const QDate &today)
+    {
+        const qint64 recordedAt = timeService->currentMSecsSinceEpoch() / 1000;
+        for (int i = 0; i < state.rosterCount(); ++i) {
+            const RotationEngine::Pair pair = state.pairFor(today, i);
+            const DutyHistory::Entry last = dutyHistory.latest(i);
+            if (last.date == today && last.pair == pair)
+                continue;
+            dutyHistory.append({ today, i, pair, reason, recordedAt });
+        }
+    }
 
-        config.setValue("origin/index1", originIndex1);
-        config.setValue("origin/index2", originIndex2);
+    // 把当前状态写入快照，成功后清空日志
+    void compactJournal()
+    {
+        ConfigStore &config = *configStore;
+
+        state.writeSnapshot(config, timeService->currentDate());
+        config.setValue("journal/seq", stateJournal.lastSeq());
+        saveSettings();
+
+        if (configStore->flush())
+            stateJournal.truncate();
+    }
 
-        config.setValue("settings/testingMode", isTestingMode);
-        config.setValue("settings/totalPersons", totalPersons);
+    // 设置项交给配置存储，只有值真正变化时才会在稍后合并写入一次
+    void saveSettings()
+    {
+        ConfigStore &config = *configStore;
 
         config.setValue("settings/startupLaunch", isStartupLaunch);
+        config.setValue("settings/cycleRosters", cycleRosters);
+        config.setValue("settings/cycleSeconds", cycleSeconds);
+        state.writeSettings(config);
+
+#ifdef ONDUTY_HAVE_NETWORK
+        // 精简构建没有局域网同步，[peer] 原样保留在配置中
+        config.setValue("peer/enabled", peerEnabled);
+        config.setValue("peer/room", peerSettings.room);
+        config.setValue("peer/group", peerSettings.group.toString());
+        config.setValue("peer/port", peerSettings.port);
+        config.setValue("peer/priority", peerSettings.priority);
+        config.setValue("peer/interface", peerSettings.interfaceName);
+#endif
 
-        config.sync();
-        QFile file(configFilePath);
-        if (file.open(QIODevice::ReadWrite | QIODevice::Text)) {
-            QByteArray firstLine = file.readLine();
-            file.seek(0);  // 重置到文件开头
-        
-            // 如果第一行已经是注释，则直接返回
-            if (firstLine.startsWith(";")) {
-                qDebug() << "配置文件已有注释，跳过添加注释步骤。";
-                file.close();
-                return;
-            }
-            QByteArray content = file.readAll();
-            file.seek(0);
-            QTextStream out(&file);
-            out << "; 值日安排配置文件\n; index1 和 index2 是当前值日的编号（从0开始）\n; lastUpdate 是上次更新的日期，格式为yyyyMMdd\n";
-            out << "; 不要修改以下origin字段，除非你知道自己在做什么！\n";
-            out << "; testMode 指考试模式\n; totalPersons 是总人数\n; isStartupLaunch 是开机启动状态\n";
-            out << ";在修改配置文件前确保关闭本程序，避免配置覆盖！\n";
-            out << "; 检查系统中是否开启Deepfreeze，如有，请使用MeltdownDFC工具关闭后再使用本程序！\n";
-            out << content;
-            file.close();
+        config.setValue("time/resyncMinutes", timeService->resyncInterval());
+        if (timeService->hasOffset()) {
+            config.setValue("time/offsetMs", timeService->offsetMs());
+            config.setValue("time/lastSync", timeService->lastSyncTime().toString(Qt::ISODate));
         }
     }
 
     // 成员变量
-    QLabel *duty1Label;
-    QLabel *duty2Label;
+    DutyView *dutyView;
     QSystemTrayIcon *trayIcon;
-    QTimer *pptCheckTimer;
-    QTimer *dutyCheckTimer;  // 新增：值日检查定时器
+    QMenu *trayMenu;
+    QAction *toggleTestingModeAction = nullptr;  // 菜单创建之前为空
+    QList<QAction *> dutyActions;
+    bool firstPaintDone = false;
+    ForegroundWatcher *foregroundWatcher;
+    RolloverScheduler *rolloverScheduler = nullptr;  // 工作日零点换日，第一帧之后创建
+#ifdef ONDUTY_HAVE_NETWORK
+    PeerSync *peerSync = nullptr;  // 局域网同步，未启用时为空
+    PeerSync::Settings peerSettings;
+    bool peerEnabled = false;
+#endif
+    TimeService *timeService;
+    ConfigStore *configStore;
+    StateJournal stateJournal;
+    DutyHistory dutyHistory;  // 每次换日和手动调整的记录，供“历史记录”和 --history 查询
+    QVector<std::array<qint64, StateJournal::FieldCount>> journaledState;  // 每个名单一项
     QString configFilePath;
-    bool wasHiddenByFullscreen = false;
-    bool wasHiddenByPPT = false;
     bool isStartupLaunch = false;
-    QGraphicsOpacityEffect *opacityEffect;  // 添加透明度效果对象
-    int originIndex1=0, originIndex2=1;
+    FadeController *fader;  // 透明度/淡入淡出控制
+    AutoHider *autoHider;  // 放映和全屏时自动隐藏
     int currentDutyIndex1 = 0;
     int currentDutyIndex2 = 1;
-    QString lastUpdateDate;
-    int totalPersons = 47;
+    QVector<FileStamp> rosterStamps;  // 每个名单一项
+    QVector<FileStamp> planStamps;    // 每个名单的约束文件
+    FileStamp holidayStamp;
+    QList<QAction *> rosterActions;
+    QAction *cycleRostersAction = nullptr;
+    ScheduledTask *rosterCycleTask = nullptr;  // 只在轮流显示且窗口可见时运行
+    bool cycleRosters = false;
+    int cycleSeconds = 20;
+    QFileSystemWatcher *rosterWatcher = nullptr;
+    ScheduledTask *rosterReloadTask;
 };
 
 int main(int argc, char *argv[])
 {
+    StartupTrace::start();
+
+    // 查询参数走无界面模式，不创建QApplication、窗口和托盘
+    if (isHeadlessCommand(argc, argv))
+        return runHeadless(argc, argv);
+
+    // 同一个配置文件只运行一个实例，避免两个进程同时换日、同时写配置。
+    // 先取锁：锁被其他实例持有时把命令交给它，不创建界面也不联网
+    SingleInstance instance(SingleInstance::applicationDir(argv) + "/duty_config.ini");
+    const QByteArray command = SingleInstance::commandFromArguments(argc, argv);
+    const int forwarded = instance.lockOrForward(command);
+    if (forwarded >= 0)
+        return forwarded;
+
     QApplication app(argc, argv);
+    StartupTrace::setPrintEnabled(app.arguments().contains("--trace-startup"));
+    StartupTrace::mark("QApplication");
     app.setQuitOnLastWindowClosed(false);
     app.setApplicationName("值日安排");
     app.setApplicationVersion("1.1");
     app.setWindowIcon(QIcon(":/board.png")); 
 
+    // 已经持有锁，开始接收之后启动的进程转发的命令
+    instance.listen();
+    StartupTrace::mark("singleInstance");
+
     DutyRosterApp window;
+    window.footprintMode = app.arguments().contains("--footprint");
+    StartupTrace::mark("window");
+    instance.setHandler([&window](const QByteArray &command) { return window.handleCommand(command); });
+    if (command != "show" && command != "query")
+        window.handleCommand(command);
 
-    if(!window.isTestingMode)
+    if(!window.state.isTestingMode)
         window.show();
     else
         window.hide();
@@ -0,0 +1,271 @@
+#include "metrics.h"
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMap>
+#include <QMutex>
+#include <QStringList>
+#include <QtAlgorithms>
+#include <atomic>
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#elif defined(Q_OS_MACOS)
+#include <mach/mach.h>
+#elif defined(Q_OS_UNIX)
+#include <unistd.h>
+#endif
+
+namespace {
+// 第b个桶是[2^(b-1), 2^b)微秒，第0个桶是0
+const int kBuckets = 32;
+
+struct HistogramData {
+    std::atomic<quint64> buckets[kBuckets] = {};
+    std::atomic<quint64> count{ 0 };
+    std::atomic<quint64> sum{ 0 };
+    std::atomic<qint64> max{ 0 };
+};
+
+struct ServerStats {
+    quint64 count = 0;
+    qint64 sum = 0;
+    qint64 min = 0;
+    qint64 max = 0;
+};
+
+struct MetricsData {
+    MetricsData() { uptime.start(); }
+
+    std::atomic<quint64> counters[Metrics::CounterCount] = {};
+    HistogramData histograms[Metrics::HistogramCount];
+    QMutex serverMutex;
+    QMap<QString, ServerStats> servers;
+    QElapsedTimer uptime;
+};
+
+MetricsData &data()
+{
+    static MetricsData metrics;
+    return metrics;
+}
+
+struct Name {
+    const char *key;
+    const char *label;
+};
+
+const Name kCounterNames[] = {
+    { "ntpQueries", "NTP请求" },
+    { "ntpReplies", "NTP有效应答" },
+    { "ntpRejects", "NTP无效应答" },
+    { "ntpFailures", "NTP校时失败" },
+    { "configWrites", "配置写入次数" },
+    { "configWriteFailures", "配置写入失败" },
+    { "configBytesWritten", "配置写入字节" },
+    { "configReloads", "配置文件重新读取" },
+    { "journalAppends", "状态日志记录" },
+    { "journalBytesWritten", "状态日志写入字节" },
+    { "historyBytesWritten", "值日历史写入字节" },
+    { "planDaysReplanned", "值日计划重排天数" },
+    { "schedulerWakeups", "调度器唤醒" },
+    { "resyncWakeups", "定时校时唤醒" },
+    { "rolloverWakeups", "换日调度唤醒" },
+    { "configTimerWakeups", "延迟写入唤醒" },
+    { "fileReloadWakeups", "文件变化唤醒" },
+    { "rosterCycleWakeups", "名单轮换唤醒" },
+    { "peerWakeups", "局域网同步唤醒" },
+    { "peerMessagesSent", "局域网同步发送" },
+    { "peerMessagesReceived", "局域网同步接收" },
+    { "presentationHides", "放映时隐藏" },
+    { "presentationShows", "放映结束显示" },
+    { "fullscreenHides", "全屏时隐藏" },
+    { "fullscreenShows", "全屏结束显示" },
+};
+static_assert(sizeof(kCounterNames) / sizeof(kCounterNames[0]) == Metrics::CounterCount, "计数器名称与枚举不一致");
+
+const Name kHistogramNames[] = {
+    { "ntpRoundTrip", "NTP往返" },
+    { "configWriteTime", "配置写入耗时" },
+    { "journalAppendTime", "日志追加耗时" },
+};
+static_assert(sizeof(kHistogramNames) / sizeof(kHistogramNames[0]) == Metrics::HistogramCount, "直方图名称与枚举不一致");
+
+int bucketOf(qint64 micros)
+{
+    if (micros <= 0)
+        return 0;
+    return qMin(kBuckets - 1, 64 - int(qCountLeadingZeroBits(quint64(micros))));
+}
+
+double schedulerWakeupsPerHour(const MetricsData &metrics)
+{
+    const quint64 wakeups = metrics.counters[Metrics::SchedulerWakeups].load(std::memory_order_relaxed);
+    return wakeups * 3600000.0 / qMax<qint64>(metrics.uptime.elapsed(), 1);
+}
+
+// 百分位的近似值：所在桶的上界
+qint64 percentile(const HistogramData &histogram, quint64 count, double fraction)
+{
+    const quint64 target = quint64(count * fraction + 0.5);
+    quint64 seen = 0;
+    for (int b = 0; b < kBuckets; ++b) {
+        seen += histogram.buckets[b].load(std::memory_order_relaxed);
+        if (seen >= target && seen > 0)
+            return b == 0 ? 0 : (qint64(1) << b) - 1;
+    }
+    return histogram.max.load(std::memory_order_relaxed);
+}
+}
+
+void Metrics::increment(Counter counter, quint64 amount)
+{
+    data().counters[counter].fetch_add(amount, std::memory_order_relaxed);
+}
+
+void Metrics::record(Histogram histogram, qint64 micros)
+{
+    HistogramData &h = data().histograms[histogram];
+    h.buckets[bucketOf(micros)].fetch_add(1, std::memory_order_relaxed);
+    h.count.fetch_add(1, std::memory_order_relaxed);
+    h.sum.fetch_add(quint64(qMax<qint64>(micros, 0)), std::memory_order_relaxed);
+    qint64 previous = h.max.load(std::memory_order_relaxed);
+    while (micros > previous && !h.max.compare_exchange_weak(previous, micros, std::memory_order_relaxed)) {
+    }
+}
+
+void Metrics::recordNtpRoundTrip(const QString &server, qint64 micros)
+{
+    record(NtpRoundTrip, micros);
+
+    MetricsData &metrics = data();
+    QMutexLocker locker(&metrics.serverMutex);
+    ServerStats &stats = metrics.servers[server];
+    stats.min = stats.count ? qMin(stats.min, micros) : micros;
+    stats.max = qMax(stats.max, micros);
+    stats.sum += micros;
+    ++stats.count;
+}
+
+quint64 Metrics::counter(Counter counter)
+{
+    return data().counters[counter].load(std::memory_order_relaxed);
+}
+
+qint64 Metrics::residentBytes()
+{
+#ifdef Q_OS_WIN
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return qint64(counters.WorkingSetSize);
+    return -1;
+#elif defined(Q_OS_MACOS)
+    mach_task_basic_info info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, task_info_t(&info), &count) == KERN_SUCCESS)
+        return qint64(info.resident_size);
+    return -1;
+#elif defined(Q_OS_UNIX)
+    // /proc/self/statm的第二个字段是常驻页数
+    QFile statm(QStringLiteral("/proc/self/statm"));
+    if (!statm.open(QIODevice::ReadOnly))
+        return -1;
+    const QList<QByteArray> fields = statm.readAll().split(' ');
+    if (fields.size() < 2)
+        return -1;
+    return fields[1].toLongLong() * sysconf(_SC_PAGESIZE);
+#else
+    return -1;
+#endif
+}
+
+QJsonObject Metrics::snapshot()
+{
+    MetricsData &metrics = data();
+
+    QJsonObject counters;
+    for (int i = 0; i < CounterCount; ++i)
+        counters[QLatin1String(kCounterNames[i].key)] = qint64(metrics.counters[i].load(std::memory_order_relaxed));
+
+    QJsonObject histograms;
+    for (int i = 0; i < HistogramCount; ++i) {
+        const HistogramData &h = metrics.histograms[i];
+        const quint64 count = h.count.load(std::memory_order_relaxed);
+        QJsonObject object;
+        object["count"] = qint64(count);
+        if (count) {
+            object["meanUs"] = double(h.sum.load(std::memory_order_relaxed)) / count;
+            object["maxUs"] = h.max.load(std::memory_order_relaxed);
+            object["p50Us"] = percentile(h, count, 0.5);
+            object["p90Us"] = percentile(h, count, 0.9);
+            object["p99Us"] = percentile(h, count, 0.99);
+        }
+        histograms[QLatin1String(kHistogramNames[i].key)] = object;
+    }
+
+    QJsonObject servers;
+    {
+        QMutexLocker locker(&metrics.serverMutex);
+        for (auto it = metrics.servers.constBegin(); it != metrics.servers.constEnd(); ++it) {
+            QJsonObject object;
+            object["count"] = qint64(it->count);
+            object["meanUs"] = double(it->sum) / qMax<quint64>(it->count, 1);
+            object["minUs"] = it->min;
+            object["maxUs"] = it->max;
+            servers[it.key()] = object;
+        }
+    }
+
+    QJsonObject snapshot;
+    snapshot["uptimeSec"] = metrics.uptime.elapsed() / 1000;
+    snapshot["schedulerWakeupsPerHour"] = schedulerWakeupsPerHour(metrics);
+    snapshot["residentBytes"] = residentBytes();
+    snapshot["counters"] = counters;
+    snapshot["histograms"] = histograms;
+    snapshot["ntpServers"] = servers;
+    return snapshot;
+}
+
+QString Metrics::summary()
+{
+    MetricsData &metrics = data();
+    QStringList lines;
+
+    const qint64 uptimeSec = metrics.uptime.elapsed() / 1000;
+    lines << QStringLiteral("运行时间：%1小时%2分").arg(uptimeSec / 3600).arg(uptimeSec / 60 % 60);
+    const qint64 rss = residentBytes();
+    if (rss >= 0)
+        lines << QStringLiteral("常驻内存：%1 MB").arg(rss / 1048576.0, 0, 'f', 1);
+    lines << QStringLiteral("调度器唤醒：每小时%1次").arg(schedulerWakeupsPerHour(metrics), 0, 'f', 1);
+
+    lines << QString();
+    for (int i = 0; i < CounterCount; ++i)
+        lines << QStringLiteral("%1：%2").arg(QString::fromUtf8(kCounterNames[i].label)).arg(metrics.counters[i].load(std::memory_order_relaxed));
+
+    lines << QString();
+    for (int i = 0; i < HistogramCount; ++i) {
+        const HistogramData &h = metrics.histograms[i];
+        const quint64 count = h.count.load(std::memory_order_relaxed);
+        if (!count) {
+            lines << QStringLiteral("%1：无").arg(QString::fromUtf8(kHistogramNames[i].label));
+            continue;
+        }
+        lines << QStringLiteral("%1：%2次，平均%3 ms，p90≤%4 ms，最大%5 ms")
+                     .arg(QString::fromUtf8(kHistogramNames[i].label))
+                     .arg(count)
+                     .arg(h.sum.load(std::memory_order_relaxed) / 1000.0 / count, 0, 'f', 2)
+                     .arg(percentile(h, count, 0.9) / 1000.0, 0, 'f', 2)
+                     .arg(h.max.load(std::memory_order_relaxed) / 1000.0, 0, 'f', 2);
+    }
+
+    QMutexLocker locker(&metrics.serverMutex);
+    for (auto it = metrics.servers.constBegin(); it != metrics.servers.constEnd(); ++it) {
+        lines << QStringLiteral("  %1：%2次，平均%3 ms")
+                     .arg(it.key())
+                     .arg(it->count)
+                     .arg(it->sum / 1000.0 / qMax<quint64>(it->count, 1), 0, 'f', 1);
+    }
+    return lines.join('\n');
+}
@@ -0,0 +1,62 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <QJsonObject>
+#include <QString>
+
+// 进程内的运行指标：计数器和延迟直方图。
+// 计数和记录只是几次relaxed原子操作，可以放在任何路径上；快照和文本只在查看时生成
+class Metrics
+{
+public:
+    enum Counter {
+        NtpQueries,          // 向单个服务器发出的请求
+        NtpReplies,          // 有效应答
+        NtpRejects,          // 校验失败的应答（模式、时间戳、Kiss-o'-Death等）
+        NtpFailures,         // 一轮查询全部失败或超时
+        ConfigWrites,
+        ConfigWriteFailures,
+        ConfigBytesWritten,
+        ConfigReloads,       // 配置文件被其他程序修改后重新读取
+        JournalAppends,
+        JournalBytesWritten,
+        HistoryBytesWritten, // 值日历史的追加和重写
+        PlanDaysReplanned,   // 值日计划因约束变化重排的天数
+        SchedulerWakeups,    // 任务调度器的定时器真正触发的次数，下面的唤醒计数是各任务的运行次数
+        ResyncWakeups,       // 定时重新校时
+        RolloverWakeups,     // 换日调度器被唤醒（到点、时间跳变、唤醒、时区变化）
+        ConfigTimerWakeups,  // 延迟写入配置
+        FileReloadWakeups,   // 名单/节假日文件变化
+        RosterCycleWakeups,  // 多个名单轮流显示
+        PeerWakeups,         // 局域网同步的信标定时器
+        PeerMessagesSent,
+        PeerMessagesReceived,
+        PresentationHides,
+        PresentationShows,
+        FullscreenHides,
+        FullscreenShows,
+        CounterCount
+    };
+
+    enum Histogram {
+        NtpRoundTrip,   // 微秒
+        ConfigWriteTime,
+        JournalAppendTime,
+        HistogramCount
+    };
+
+    static void increment(Counter counter, quint64 amount = 1);
+    static void record(Histogram histogram, qint64 micros);
+    // 每个服务器单独统计往返时间
+    static void recordNtpRoundTrip(const QString &server, qint64 micros);
+
+    static quint64 counter(Counter counter);
+    // 常驻内存（字节），取不到时返回-1
+    static qint64 residentBytes();
+
+    static QJsonObject snapshot();
+    // 供“诊断”窗口显示的文本
+    static QString summary();
+};
+
+#endif // METRICS_H
@@ -0,0 +1,406 @@
+#include "ntpclient.h"
+#include "metrics.h"
+#include "taskscheduler.h"
+
+#include <QUdpSocket>
+#include <QHostAddress>
+#include <QRandomGenerator>
+#include <QRegularExpression>
+#include <QDebug>
+#include <QLoggingCategory>
+#include <QtEndian>
+#include <algorithm>
+
+// 校时结果写在onduty.ntp；每个应答的偏差和延迟默认不输出，
+// 排查服务器时用 QT_LOGGING_RULES="onduty.ntp.reply.debug=true" 打开
+Q_LOGGING_CATEGORY(lcNtp, "onduty.ntp")
+Q_LOGGING_CATEGORY(lcNtpReply, "onduty.ntp.reply", QtInfoMsg)
+
+namespace {
+// 常用NTP服务器列表（按优先级排序）
+const char kDefaultServers[] =
+    "cn.pool.ntp.org,"      // 中国NTP池
+    "ntp.aliyun.com,"       // 阿里云
+    "ntp1.aliyun.com,"      // 阿里云备用
+    "time.google.com,"      // Google时间服务器
+    "time.windows.com,"     // Windows时间服务器
+    "pool.ntp.org,"         // NTP池
+    "time.apple.com";       // Apple时间服务器
+
+const quint16 kNtpPort = 123;
+const int kNtpPacketSize = 48;
+
+// NTP时间戳（1900年1月1日）到Unix时间戳（1970年1月1日）的偏移量
+const qint64 kNtpToUnixOffset = 2208988800LL;
+
+// 根延迟的一半加根离散超过1.5秒的服务器不可信（RFC 5905的MAXDIST）
+const qint64 kMaxRootDistanceUs = 1500000;
+const qint64 kMaxDelayUs = 16000000;
+// 服务器的时钟精度有限，算出的延迟可以略小于0
+const qint64 kDelayToleranceUs = 1000;
+// 与中位数相差超过1秒的样本视为时间戳错误
+const qint64 kMaxOffsetSpreadUs = 1000000;
+
+bool isValidHost(const QString &host)
+{
+    if (!QHostAddress(host).isNull())
+        return true;
+    static const QRegularExpression hostPattern(
+        "^(?=.{1,253}$)[A-Za-z0-9](?:[A-Za-z0-9-]{0,61}[A-Za-z0-9])?"
+        "(?:\\.[A-Za-z0-9](?:[A-Za-z0-9-]{0,61}[A-Za-z0-9])?)*$");
+    return hostPattern.match(host).hasMatch();
+}
+
+// 拆出主机名和端口，没有写端口时为123；不带方括号的IPv6地址不能带端口
+bool splitServer(const QString &server, QString *host, quint16 *port)
+{
+    *host = server;
+    *port = kNtpPort;
+    QString portText;
+    bool hasPort = false;
+    if (server.startsWith('[')) {
+        const int close = server.indexOf(']');
+        if (close < 0)
+            return false;
+        *host = server.mid(1, close - 1);
+        hasPort = close + 1 < server.size();
+        if (hasPort && server.at(close + 1) != ':')
+            return false;
+        portText = server.mid(close + 2);
+    } else if (server.count(':') == 1) {
+        const int colon = server.indexOf(':');
+        *host = server.left(colon);
+        hasPort = true;
+        portText = server.mid(colon + 1);
+    }
+    if (hasPort) {
+        bool ok = false;
+        const uint value = portText.toUInt(&ok);
+        if (!ok || value == 0 || value > 65535)
+            return false;
+        *port = quint16(value);
+    }
+    return isValidHost(*host);
+}
+
+quint32 readUInt32(const uchar *data)
+{
+    return qFromBigEndian<quint32>(data);
+}
+
+quint64 readTimestamp(const uchar *data)
+{
+    return qFromBigEndian<quint64>(data);
+}
+
+// 16.16定点的秒数转为微秒
+qint64 shortFormatUs(quint32 value)
+{
+    return qint64((quint64(value) * 1000000) >> 16);
+}
+}
+
+NtpClient::NtpClient(QObject *parent)
+    : QObject(parent)
+    , serverList(defaultServers())
+{
+    connect(this, &NtpClient::failed, this, []() { Metrics::increment(Metrics::NtpFailures); });
+
+    // 查询已经发出，调度器暂停时也要按时结束
+    timeoutTask = new ScheduledTask("ntpTimeout", 200, this);
+    timeoutTask->setSingleShot(true);
+    timeoutTask->setRunWhileSuspended(true);
+    connect(timeoutTask, &ScheduledTask::timeout, this, [this]() {
+        // 已经有样本时只是还有服务器没有回复
+        if (!samples.isEmpty()) {
+            finish();
+            return;
+        }
+        qCWarning(lcNtp) << "All NTP servers timed out";
+        cancel();
+        emit failed();
+    });
+
+    windowTask = new ScheduledTask("ntpSampleWindow", 50, this);
+    windowTask->setSingleShot(true);
+    windowTask->setRunWhileSuspended(true);
+    connect(windowTask, &ScheduledTask::timeout, this, &NtpClient::finish);
+}
+
+NtpClient::~NtpClient()
+{
+    cancel();
+}
+
+QStringList NtpClient::parseServerList(const QString &list)
+{
+    static const QRegularExpression separators("[,;\\s]+");
+    QStringList servers;
+    for (const QString &entry : list.split(separators, Qt::SkipEmptyParts)) {
+        const QString server = entry.trimmed().toLower();
+        QString host;
+        quint16 port = 0;
+        if (!splitServer(server, &host, &port)) {
+            qCWarning(lcNtp) << "Ignoring invalid NTP server:" << entry;
+            continue;
+        }
+        if (!servers.contains(server))
+            servers.append(server);
+    }
+    return servers;
+}
+
+QStringList NtpClient::defaultServers()
+{
+    return parseServerList(QString::fromLatin1(kDefaultServers));
+}
+
+quint64 NtpClient::toNtpTimestamp(qint64 unixUs)
+{
+    qint64 seconds = unixUs / 1000000;
+    qint64 micros = unixUs % 1000000;
+    if (micros < 0) {
+        --seconds;
+        micros += 1000000;
+    }
+    // 秒数只保留低32位，2036年之后自然进入纪元1
+    const quint32 ntpSeconds = quint32(seconds + kNtpToUnixOffset);
+    const quint64 fraction = (quint64(micros) << 32) / 1000000;
+    return (quint64(ntpSeconds) << 32) | fraction;
+}
+
+qint64 NtpClient::fromNtpTimestamp(quint64 timestamp)
+{
+    const quint32 ntpSeconds = quint32(timestamp >> 32);
+    // 最高位为0说明已进入2036年之后的NTP纪元1
+    qint64 seconds = ntpSeconds;
+    if (!(ntpSeconds & 0x80000000u))
+        seconds += Q_INT64_C(0x100000000);
+    const qint64 micros = qint64(((timestamp & 0xFFFFFFFFu) * 1000000) >> 32);
+    return (seconds - kNtpToUnixOffset) * 1000000 + micros;
+}
+
+bool NtpClient::parseResponse(const QByteArray &response, quint64 origin, qint64 t1Us, qint64 t4Us,
+                              Sample *sample, QString *error)
+{
+    const auto reject = [error](const QString &reason) {
+        if (error)
+            *error = reason;
+        return false;
+    };
+
+    if (response.size() < kNtpPacketSize)
+        return reject(QStringLiteral("short reply (%1 bytes)").arg(response.size()));
+
+    const uchar *data = reinterpret_cast<const uchar *>(response.constData());
+    const int leap = data[0] >> 6;
+    const int version = (data[0] >> 3) & 0x07;
+    const int mode = data[0] & 0x07;
+    const int stratum = data[1];
+
+    // 单播请求的应答只能是服务器模式(4)
+    if (mode != 4)
+        return reject(QStringLiteral("unexpected mode %1").arg(mode));
+    if (version < 1 || version > 4)
+        return reject(QStringLiteral("unsupported version %1").arg(version));
+    if (stratum == 0) {
+        // Kiss-o'-Death：参考标识是四个ASCII字母，例如RATE、DENY、RSTR
+        QByteArray code(response.constData() + 12, 4);
+        code.replace('\0', "");
+        return reject(QStringLiteral("KoD ") + QString::fromLatin1(code));
+    }
+    if (stratum > 15)
+        return reject(QStringLiteral("stratum %1").arg(stratum));
+    if (leap == 3)
+        return reject(QStringLiteral("server clock is not synchronized"));
+    if (shortFormatUs(readUInt32(data + 4)) / 2 + shortFormatUs(readUInt32(data + 8)) > kMaxRootDistanceUs)
+        return reject(QStringLiteral("root distance too large"));
+
+    // originate字段必须是请求的发送时间戳，否则是过期或伪造的应答
+    if (readTimestamp(data + 24) != origin)
+        return reject(QStringLiteral("originate timestamp does not match the request"));
+    const quint64 receive = readTimestamp(data + 32);
+    const quint64 transmit = readTimestamp(data + 40);
+    if (receive == 0 || transmit == 0)
+        return reject(QStringLiteral("zero timestamp"));
+
+    const qint64 t2Us = fromNtpTimestamp(receive);
+    const qint64 t3Us = fromNtpTimestamp(transmit);
+    if (t3Us < t2Us)
+        return reject(QStringLiteral("transmit timestamp before receive timestamp"));
+
+    const qint64 delayUs = (t4Us - t1Us) - (t3Us - t2Us);
+    if (delayUs < -kDelayToleranceUs || delayUs > kMaxDelayUs)
+        return reject(QStringLiteral("round-trip delay %1 us").arg(delayUs));
+
+    sample->offsetUs = ((t2Us - t1Us) + (t3Us - t4Us)) / 2;
+    sample->delayUs = qMax<qint64>(delayUs, 0);
+    sample->stratum = stratum;
+    return true;
+}
+
+void NtpClient::setServers(const QStringList &servers)
+{
+    serverList = servers.isEmpty() ? defaultServers() : servers;
+}
+
+void NtpClient::query(int timeout)
+{
+    if (isRunning())
+        return;
+
+    samples.clear();
+    wallBaseUs = QDateTime::currentMSecsSinceEpoch() * 1000;
+    queryClock.start();
+    for (const QString &server : std::as_const(serverList)) {
+        QString host;
+        quint16 port = 0;
+        if (deniedServers.contains(server) || !splitServer(server, &host, &port))
+            continue;
+
+        QUdpSocket *socket = new QUdpSocket(this);
+        sockets.append(socket);
+        requests.insert(socket, { server });
+
+        // 主机名解析和连接均为异步，连接成功后再发送请求
+        connect(socket, &QUdpSocket::connected, this, [this, socket]() { sendRequest(socket); });
+        connect(socket, &QUdpSocket::readyRead, this, [this, socket]() { readResponse(socket); });
+        connect(socket, &QUdpSocket::errorOccurred, this, [this, socket, server]() {
+            qCWarning(lcNtp) << "NTP server" << server << "failed:" << socket->errorString();
+            dropSocket(socket);
+        });
+
+        socket->connectToHost(host, port, QIODevice::ReadWrite);
+    }
+
+    if (sockets.isEmpty()) {
+        qCWarning(lcNtp) << "No NTP server to query";
+        emit failed();
+        return;
+    }
+    timeoutTask->start(timeout);
+}
+
+void NtpClient::cancel()
+{
+    timeoutTask->stop();
+    windowTask->stop();
+    const QList<QUdpSocket *> pending = sockets;
+    sockets.clear();
+    requests.clear();
+    samples.clear();
+    for (QUdpSocket *socket : pending) {
+        socket->disconnect(this);
+        socket->abort();
+        socket->deleteLater();
+    }
+}
+
+void NtpClient::sendRequest(QUdpSocket *socket)
+{
+    Request &request = requests[socket];
+    QByteArray packet(kNtpPacketSize, 0);
+    packet[0] = char(0x23);  // LI=0, Version=4, Mode=3 (客户端)
+
+    // 发送时间戳会原样出现在应答的originate字段中；不足1微秒的小数位填随机数，使应答难以伪造
+    request.sentUs = wallClockUs();
+    request.origin = toNtpTimestamp(request.sentUs) | (QRandomGenerator::global()->generate() & 0xFFFu);
+    qToBigEndian(request.origin, packet.data() + 40);
+    if (socket->write(packet) != packet.size()) {
+        qCWarning(lcNtp) << "Failed to send NTP request to" << request.server;
+        return;
+    }
+    Metrics::increment(Metrics::NtpQueries);
+}
+
+void NtpClient::readResponse(QUdpSocket *socket)
+{
+    const Request request = requests.value(socket);
+    while (socket->hasPendingDatagrams()) {
+        const qint64 receivedUs = wallClockUs();
+        QByteArray response(int(qMax<qint64>(socket->pendingDatagramSize(), 0)), '\0');
+        socket->readDatagram(response.data(), response.size());
+        if (request.sentUs < 0)
+            continue;
+
+        Sample sample;
+        QString error;
+        if (!parseResponse(response, request.origin, request.sentUs, receivedUs, &sample, &error)) {
+            Metrics::increment(Metrics::NtpRejects);
+            qCWarning(lcNtp) << "Rejected NTP reply from" << request.server << ":" << error;
+            if (error.startsWith(QLatin1String("KoD"))) {
+                // RATE：这一轮不再等它；DENY、RSTR：服务器拒绝为本机服务，本次运行不再查询
+                if (error == QLatin1String("KoD DENY") || error == QLatin1String("KoD RSTR"))
+                    deniedServers.insert(request.server);
+                dropSocket(socket);
+                return;
+            }
+            // 其他无效应答可能是伪造的，继续等待同一服务器的真正应答
+            continue;
+        }
+
+        sample.server = request.server;
+        Metrics::increment(Metrics::NtpReplies);
+        Metrics::recordNtpRoundTrip(request.server, sample.delayUs);
+        qCDebug(lcNtpReply) << "NTP reply from" << request.server << "offset" << sample.offsetUs / 1000.0
+                 << "ms, delay" << sample.delayUs / 1000.0 << "ms";
+        samples.append(sample);
+        if (sampleWindow <= 0) {
+            finish();
+            return;
+        }
+        if (samples.size() == 1)
+            windowTask->start(sampleWindow);
+        dropSocket(socket);
+        return;
+    }
+}
+
+void NtpClient::dropSocket(QUdpSocket *socket)
+{
+    if (!sockets.removeOne(socket))
+        return;
+    requests.remove(socket);
+    socket->disconnect(this);
+    socket->abort();
+    socket->deleteLater();
+
+    if (!sockets.isEmpty())
+        return;
+    if (!samples.isEmpty()) {
+        finish();
+        return;
+    }
+    qCWarning(lcNtp) << "All NTP servers failed";
+    timeoutTask->stop();
+    emit failed();
+}
+
+void NtpClient::finish()
+{
+    // 三个以上样本时排除偏差离中位数太远的（时间戳错误的服务器），再取延迟最小的
+    QList<Sample> candidates = samples;
+    if (candidates.size() >= 3) {
+        QList<qint64> offsets;
+        for (const Sample &sample : std::as_const(candidates))
+            offsets.append(sample.offsetUs);
+        std::nth_element(offsets.begin(), offsets.begin() + offsets.size() / 2, offsets.end());
+        const qint64 median = offsets[offsets.size() / 2];
+        candidates.erase(std::remove_if(candidates.begin(), candidates.end(), [median](const Sample &sample) {
+            return qAbs(sample.offsetUs - median) > kMaxOffsetSpreadUs;
+        }), candidates.end());
+    }
+    best = *std::min_element(candidates.cbegin(), candidates.cend(), [](const Sample &a, const Sample &b) {
+        return a.delayUs < b.delayUs;
+    });
+
+    const QDateTime utc = QDateTime::fromMSecsSinceEpoch((wallClockUs() + best.offsetUs) / 1000, Qt::UTC);
+    qCDebug(lcNtp) << "Using time from" << best.server << "(" << samples.size() << "samples):" << utc.toString(Qt::ISODateWithMs);
+    cancel();
+    emit finished(utc, best.server);
+}
+
+qint64 NtpClient::wallClockUs() const
+{
+    return wallBaseUs + queryClock.nsecsElapsed() / 1000;
+}
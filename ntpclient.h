@@ -0,0 +1,88 @@
+#ifndef NTPCLIENT_H
+#define NTPCLIENT_H
+
+#include <QObject>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QSet>
+#include <QStringList>
+
+class QUdpSocket;
+class ScheduledTask;
+
+// 异步SNTP客户端：同时向所有服务器发送请求，校验应答并算出时钟偏差和往返延迟。
+// 第一个有效应答到达后再等一小段时间收集其他服务器的应答，排除明显不一致的样本后取延迟最小的
+class NtpClient : public QObject
+{
+    Q_OBJECT
+
+public:
+    // 一次有效的测量
+    struct Sample {
+        qint64 offsetUs = 0;  // 服务器时间减本机时间
+        qint64 delayUs = 0;   // 往返延迟，不含服务器的处理时间
+        int stratum = 0;
+        QString server;
+    };
+
+    explicit NtpClient(QObject *parent = nullptr);
+    ~NtpClient() override;
+
+    // 解析以逗号/空白分隔的服务器列表，丢弃非法或重复的主机名；可以写成host:port或[IPv6]:port
+    static QStringList parseServerList(const QString &list);
+    static QStringList defaultServers();
+
+    // 本机UTC微秒数与64位NTP时间戳（1900年起，高32位为秒，低32位为小数）互相换算
+    static quint64 toNtpTimestamp(qint64 unixUs);
+    static qint64 fromNtpTimestamp(quint64 timestamp);
+
+    // 校验应答并计算偏差和延迟。origin是请求中的发送时间戳，t1Us/t4Us是发出请求和收到应答时的本机时间。
+    // 无效时返回false，error中是原因；Kiss-o'-Death应答的原因是"KoD "加上服务器给出的四个字母的代码
+    static bool parseResponse(const QByteArray &response, quint64 origin, qint64 t1Us, qint64 t4Us,
+                              Sample *sample, QString *error = nullptr);
+
+    void setServers(const QStringList &servers);
+    QStringList servers() const { return serverList; }
+    // 第一个有效应答之后等待其他服务器的时间，0表示第一个有效应答直接获胜
+    void setSampleWindow(int msec) { sampleWindow = msec; }
+    bool isRunning() const { return !sockets.isEmpty(); }
+    // 上一次成功查询采用的样本
+    Sample lastSample() const { return best; }
+
+public slots:
+    void query(int timeout = 2000);
+    void cancel();
+
+signals:
+    void finished(const QDateTime &utc, const QString &server);
+    void failed();
+
+private:
+    struct Request {
+        QString server;
+        quint64 origin = 0;
+        qint64 sentUs = -1;
+    };
+
+    void sendRequest(QUdpSocket *socket);
+    void readResponse(QUdpSocket *socket);
+    void dropSocket(QUdpSocket *socket);
+    void finish();
+    qint64 wallClockUs() const;
+
+    QStringList serverList;
+    QSet<QString> deniedServers;  // 回复了DENY/RSTR的服务器，本次运行不再查询
+    QList<QUdpSocket *> sockets;
+    QHash<QUdpSocket *, Request> requests;
+    QList<Sample> samples;
+    Sample best;
+    int sampleWindow = 150;
+    qint64 wallBaseUs = 0;  // 开始查询时的本机时间，之后用queryClock推算，一轮查询内不受系统时间调整影响
+    QElapsedTimer queryClock;
+    ScheduledTask *timeoutTask;
+    ScheduledTask *windowTask;
+};
+
+#endif // NTPCLIENT_H
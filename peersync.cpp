@@ -0,0 +1,383 @@
+#include "peersync.h"
+#include "dutystate.h"
+#include "metrics.h"
+#include "taskscheduler.h"
+#include "timeservice.h"
+
+#include <QDebug>
+#include <QLoggingCategory>
+#include <QNetworkInterface>
+#include <QRandomGenerator>
+#include <QUdpSocket>
+#include <QtEndian>
+#include <algorithm>
+
+// 启动和角色变化写在onduty.peersync，用 QT_LOGGING_RULES="onduty.peersync.debug=false" 关掉
+Q_LOGGING_CATEGORY(lcPeerSync, "onduty.peersync")
+
+namespace {
+// 报文（小端）：magic(4) type(1) room(4) sender(8) priority(2)，之后是各类型的内容
+// 信标：version(8) utcMs(8)
+// 增量/完整状态/提议：version(8) count(2) count×[roster<<4|field(1) value(8)]
+const quint32 kMagic = 0x3150444F;  // "ODP1"
+const int kEntrySize = 9;
+const int kMaxEntries = StateJournal::MaxRosters * StateJournal::FieldCount;
+
+enum MessageType : quint8 {
+    Beacon = 1,
+    Delta,
+    Full,
+    Propose,
+    FullRequest,
+};
+
+template <typename T>
+void put(QByteArray &data, T value)
+{
+    char buffer[sizeof(T)];
+    qToLittleEndian<T>(value, buffer);
+    data.append(buffer, int(sizeof(T)));
+}
+
+struct Reader {
+    const QByteArray &data;
+    int pos = 0;
+    bool ok = true;
+
+    template <typename T>
+    T take()
+    {
+        if (pos + int(sizeof(T)) > data.size()) {
+            ok = false;
+            return T();
+        }
+        const T value = qFromLittleEndian<T>(data.constData() + pos);
+        pos += int(sizeof(T));
+        return value;
+    }
+};
+
+bool isLiveField(quint8 field)
+{
+    return std::find(std::begin(DutyState::liveFields), std::end(DutyState::liveFields), field) != std::end(DutyState::liveFields);
+}
+}
+
+PeerSync::PeerSync(DutyState *state, TimeService *timeService, const Settings &settings, QObject *parent)
+    : QObject(parent)
+    , state(state)
+    , timeService(timeService)
+    , settings(settings)
+    , selfId(QRandomGenerator::system()->generate64())
+    , roomHash(StateJournal::crc32(settings.room.toUtf8().constData(), int(settings.room.toUtf8().size())))
+{
+}
+
+bool PeerSync::start()
+{
+    socket = new QUdpSocket(this);
+    const QHostAddress any = settings.group.protocol() == QAbstractSocket::IPv6Protocol ? QHostAddress(QHostAddress::AnyIPv6)
+                                                                                       : QHostAddress(QHostAddress::AnyIPv4);
+    // 同一台电脑上的多个实例共用端口
+    if (!socket->bind(any, settings.port, QUdpSocket::ShareAddress | QUdpSocket::ReuseAddressHint)) {
+        qCWarning(lcPeerSync) << "Peer sync: cannot bind port" << settings.port << socket->errorString();
+        return false;
+    }
+
+    const QNetworkInterface networkInterface = settings.interfaceName.isEmpty() ? QNetworkInterface()
+                                                                                : QNetworkInterface::interfaceFromName(settings.interfaceName);
+    const bool joined = networkInterface.isValid() ? socket->joinMulticastGroup(settings.group, networkInterface)
+                                                   : socket->joinMulticastGroup(settings.group);
+    if (!joined) {
+        qCWarning(lcPeerSync) << "Peer sync: cannot join" << settings.group.toString() << socket->errorString();
+        return false;
+    }
+    if (networkInterface.isValid())
+        socket->setMulticastInterface(networkInterface);
+    socket->setSocketOption(QAbstractSocket::MulticastTtlOption, 1);
+    socket->setSocketOption(QAbstractSocket::MulticastLoopbackOption, 1);
+    connect(socket, &QUdpSocket::readyRead, this, &PeerSync::onReadyRead);
+
+    resetPublished();
+    clock.start();
+    // 确定角色之前不做NTP校时
+    if (timeService)
+        timeService->setPeerFollower(true);
+
+    // 信标可以晚五分之一个间隔，选举的超时是3.5个间隔
+    beaconTask = new ScheduledTask("peerBeacon", settings.beaconInterval / 5, this);
+    connect(beaconTask, &ScheduledTask::timeout, this, &PeerSync::onBeaconTimer);
+    beaconTask->start(settings.beaconInterval);
+    qCDebug(lcPeerSync) << "Peer sync started in room" << settings.room << "as node" << Qt::hex << selfId;
+    return true;
+}
+
+void PeerSync::publish()
+{
+    if (!socket)
+        return;
+    const QVector<Entry> entries = changedEntries();
+    if (entries.isEmpty())
+        return;
+
+    if (currentRole == Authority) {
+        ++version;
+        for (const Entry &entry : entries)
+            published[entry.roster][entry.field] = entry.value;
+        sendEntries(Delta, entries);
+    } else if (currentRole == Follower) {
+        // 权威节点广播增量后才算确认，在此之前每个信标都会重发
+        sendEntries(Propose, entries);
+    }
+}
+
+void PeerSync::onBeaconTimer()
+{
+    Metrics::increment(Metrics::PeerWakeups);
+    if (currentRole == Authority) {
+        sendBeacon();
+        return;
+    }
+    const qint64 now = clock.elapsed();
+    const qint64 silence = authoritySeenAt >= 0 ? now - authoritySeenAt : now;
+    if (silence >= settings.beaconInterval * 7 / 2)
+        becomeAuthority();
+}
+
+void PeerSync::onReadyRead()
+{
+    while (socket->hasPendingDatagrams()) {
+        const qint64 size = socket->pendingDatagramSize();
+        QByteArray datagram(int(qMax<qint64>(size, 0)), '\0');
+        socket->readDatagram(datagram.data(), datagram.size());
+        handleMessage(datagram);
+    }
+}
+
+void PeerSync::handleMessage(const QByteArray &datagram)
+{
+    Reader in{ datagram };
+    const quint32 magic = in.take<quint32>();
+    const quint8 type = in.take<quint8>();
+    const quint32 room = in.take<quint32>();
+    const quint64 sender = in.take<quint64>();
+    const int priority = in.take<qint16>();
+    // 组播回环会收到自己发出的报文
+    if (!in.ok || magic != kMagic || room != roomHash || sender == selfId)
+        return;
+    Metrics::increment(Metrics::PeerMessagesReceived);
+    const qint64 now = clock.elapsed();
+
+    if (type == Beacon) {
+        const quint64 remoteVersion = in.take<quint64>();
+        const qint64 utcMs = in.take<qint64>();
+        if (!in.ok)
+            return;
+        if (currentRole == Authority) {
+            // 同时有两个权威节点（同时启动或网络恢复）时排名低的退让
+            if (!outranks(sender, priority, selfId, settings.priority))
+                return;
+            follow(sender, priority);
+        } else if (sender != authorityId) {
+            const bool authorityAlive = authoritySeenAt >= 0 && now - authoritySeenAt < settings.beaconInterval * 7 / 2;
+            if (authorityAlive && !outranks(sender, priority, authorityId, authorityPriority))
+                return;
+            follow(sender, priority);
+        }
+        authoritySeenAt = now;
+        if (timeService && utcMs > 0)
+            timeService->applyPeerTime(utcMs);
+
+        if (remoteVersion != version) {
+            requestFullState();
+        } else {
+            const QVector<Entry> pending = changedEntries();
+            if (!pending.isEmpty())
+                sendEntries(Propose, pending);
+        }
+        return;
+    }
+
+    if (type == FullRequest) {
+        // 多个跟随节点同时请求时只回复一次
+        if (currentRole == Authority && (fullSentAt < 0 || now - fullSentAt >= settings.beaconInterval / 4)) {
+            fullSentAt = now;
+            sendEntries(Full, allEntries());
+        }
+        return;
+    }
+
+    const quint64 messageVersion = in.take<quint64>();
+    const int count = in.take<quint16>();
+    if (!in.ok || count > kMaxEntries || datagram.size() - in.pos < count * kEntrySize)
+        return;
+    QVector<Entry> entries;
+    entries.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        const quint8 key = in.take<quint8>();
+        const qint64 value = in.take<qint64>();
+        const quint8 field = key & 0x0F;
+        if (isLiveField(field))
+            entries.append({ quint8(key >> 4), StateJournal::Field(field), value });
+    }
+
+    switch (type) {
+    case Delta:
+    case Full:
+        if (currentRole != Follower || sender != authorityId)
+            return;
+        // 增量必须紧接着本地版本，否则说明丢了报文
+        if (type == Delta && messageVersion != version + 1) {
+            requestFullState();
+            return;
+        }
+        version = messageVersion;
+        if (applyEntries(entries, true))
+            emit stateApplied();
+        break;
+    case Propose:
+        if (currentRole != Authority)
+            return;
+        if (applyEntries(entries, false)) {
+            publish();
+            emit stateApplied();
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+void PeerSync::becomeAuthority()
+{
+    qCDebug(lcPeerSync) << "Peer sync: node" << Qt::hex << selfId << "is now the authority";
+    currentRole = Authority;
+    authorityId = selfId;
+    authorityPriority = settings.priority;
+    // 新的版本号让所有跟随节点都以本节点的完整状态为准
+    ++version;
+    resetPublished();
+    if (timeService)
+        timeService->setPeerFollower(false);
+    sendBeacon();
+    sendEntries(Full, allEntries());
+    emit roleChanged(Authority);
+}
+
+void PeerSync::follow(quint64 authority, int priority)
+{
+    qCDebug(lcPeerSync) << "Peer sync: following node" << Qt::hex << authority;
+    currentRole = Follower;
+    authorityId = authority;
+    authorityPriority = priority;
+    if (timeService)
+        timeService->setPeerFollower(true);
+    requestFullState();
+    emit roleChanged(Follower);
+}
+
+void PeerSync::requestFullState()
+{
+    const qint64 now = clock.elapsed();
+    if (fullRequestedAt >= 0 && now - fullRequestedAt < settings.beaconInterval / 2)
+        return;
+    fullRequestedAt = now;
+    send(header(FullRequest));
+}
+
+void PeerSync::sendBeacon()
+{
+    QByteArray message = header(Beacon);
+    put<quint64>(message, version);
+    put<qint64>(message, timeService ? timeService->currentMSecsSinceEpoch() : 0);
+    send(message);
+}
+
+void PeerSync::sendEntries(quint8 type, const QVector<Entry> &entries)
+{
+    QByteArray message = header(type);
+    put<quint64>(message, version);
+    put<quint16>(message, quint16(entries.size()));
+    for (const Entry &entry : entries) {
+        put<quint8>(message, quint8(entry.roster << 4 | entry.field));
+        put<qint64>(message, entry.value);
+    }
+    send(message);
+}
+
+void PeerSync::send(QByteArray message)
+{
+    Metrics::increment(Metrics::PeerMessagesSent);
+    if (socket->writeDatagram(message, settings.group, settings.port) < 0)
+        qCWarning(lcPeerSync) << "Peer sync: send failed" << socket->errorString();
+}
+
+QByteArray PeerSync::header(quint8 type) const
+{
+    QByteArray message;
+    message.reserve(64);
+    put<quint32>(message, kMagic);
+    put<quint8>(message, type);
+    put<quint32>(message, roomHash);
+    put<quint64>(message, selfId);
+    put<qint16>(message, qint16(settings.priority));
+    return message;
+}
+
+QVector<PeerSync::Entry> PeerSync::changedEntries() const
+{
+    QVector<Entry> entries;
+    for (int i = 0; i < published.size(); ++i) {
+        for (StateJournal::Field field : DutyState::liveFields) {
+            const qint64 value = state->field(field, i);
+            if (published[i][field] != value)
+                entries.append({ quint8(i), field, value });
+        }
+    }
+    return entries;
+}
+
+QVector<PeerSync::Entry> PeerSync::allEntries() const
+{
+    QVector<Entry> entries;
+    for (int i = 0; i < published.size(); ++i) {
+        for (StateJournal::Field field : DutyState::liveFields) {
+            // 考试模式只记在第0个名单下
+            if (field == StateJournal::TestingMode && i > 0)
+                continue;
+            entries.append({ quint8(i), field, state->field(field, i) });
+        }
+    }
+    return entries;
+}
+
+bool PeerSync::applyEntries(const QVector<Entry> &entries, bool markPublished)
+{
+    bool changed = false;
+    for (const Entry &entry : entries) {
+        // 名单个数不同时只同步两边都有的名单
+        if (entry.roster >= published.size() || (entry.field == StateJournal::TestingMode && entry.roster > 0))
+            continue;
+        if (state->field(entry.field, entry.roster) != entry.value) {
+            state->applyField(entry.field, entry.value, entry.roster);
+            changed = true;
+        }
+        if (markPublished)
+            published[entry.roster][entry.field] = entry.value;
+    }
+    return changed;
+}
+
+void PeerSync::resetPublished()
+{
+    published.resize(state->rosterCount());
+    for (int i = 0; i < published.size(); ++i) {
+        for (StateJournal::Field field : DutyState::liveFields)
+            published[i][field] = state->field(field, i);
+    }
+}
+
+bool PeerSync::outranks(quint64 id, int priority, quint64 otherId, int otherPriority)
+{
+    return priority != otherPriority ? priority > otherPriority : id > otherId;
+}
@@ -0,0 +1,98 @@
+#ifndef PEERSYNC_H
+#define PEERSYNC_H
+
+#include "statejournal.h"
+
+#include <QElapsedTimer>
+#include <QHostAddress>
+#include <QObject>
+#include <QVector>
+#include <array>
+
+class DutyState;
+class TimeService;
+class ScheduledTask;
+class QUdpSocket;
+
+// 同一个班的多台电脑通过UDP组播同步值日状态和时间。
+// 同一房间内选出一个权威节点：只有它做NTP校时和换日，定时广播时间和状态版本，
+// 状态改变时立即广播带版本号的增量；跟随节点应用增量，本地的手动调整发给权威节点，
+// 发现版本缺口时请求完整状态。房间名只用来区分不同的班，不是密码
+class PeerSync : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Settings {
+        QString room = QStringLiteral("default");
+        QHostAddress group = QHostAddress(QStringLiteral("239.255.43.21"));
+        quint16 port = 45821;
+        int priority = 0;          // 大的优先成为权威节点，相同时比较随机的节点编号
+        QString interfaceName;     // 为空时使用系统默认的组播接口，本机测试可以用回环接口
+        int beaconInterval = 1000; // 毫秒，权威节点超过3.5个间隔没有消息就重新选举
+    };
+
+    enum Role { Listening, Follower, Authority };
+
+    // timeService可以为空，此时只同步状态
+    PeerSync(DutyState *state, TimeService *timeService, const Settings &settings, QObject *parent = nullptr);
+
+    // 加入组播组，先作为跟随节点等待已有的权威节点；失败时返回false
+    bool start();
+
+    Role role() const { return currentRole; }
+    bool isAuthority() const { return currentRole == Authority; }
+    quint64 stateVersion() const { return version; }
+    quint64 nodeId() const { return selfId; }
+
+    // 本地状态改变后调用：权威节点广播增量，跟随节点把改变发给权威节点
+    void publish();
+
+signals:
+    // 收到其他节点的状态并已写入DutyState
+    void stateApplied();
+    void roleChanged(PeerSync::Role role);
+
+private:
+    struct Entry {
+        quint8 roster;
+        StateJournal::Field field;
+        qint64 value;
+    };
+
+    void onBeaconTimer();
+    void onReadyRead();
+    void handleMessage(const QByteArray &datagram);
+    void becomeAuthority();
+    void follow(quint64 authority, int priority);
+    void requestFullState();
+    void sendBeacon();
+    void sendEntries(quint8 type, const QVector<Entry> &entries);
+    void send(QByteArray message);
+    QByteArray header(quint8 type) const;
+    QVector<Entry> changedEntries() const;
+    QVector<Entry> allEntries() const;
+    bool applyEntries(const QVector<Entry> &entries, bool markPublished);
+    void resetPublished();
+    static bool outranks(quint64 id, int priority, quint64 otherId, int otherPriority);
+
+    DutyState *state;
+    TimeService *timeService;
+    Settings settings;
+    QUdpSocket *socket = nullptr;
+    ScheduledTask *beaconTask = nullptr;
+    QElapsedTimer clock;
+    quint64 selfId;
+    quint32 roomHash;
+    Role currentRole = Listening;
+    quint64 authorityId = 0;
+    int authorityPriority = 0;
+    qint64 authoritySeenAt = -1;
+    qint64 fullRequestedAt = -1;
+    qint64 fullSentAt = -1;
+    quint64 version = 0;
+    // 已知的权威状态（跟随节点）或已广播的状态（权威节点），与DutyState比较得出增量
+    QVector<std::array<qint64, StateJournal::FieldCount>> published;
+};
+
+#endif // PEERSYNC_H
@@ -0,0 +1,188 @@
+#include "rolloverscheduler.h"
+#include "timeservice.h"
+#include "metrics.h"
+#include "taskscheduler.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+
+#ifdef Q_OS_LINUX
+#include <QSocketNotifier>
+#include <QFileSystemWatcher>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+#ifdef Q_OS_WIN
+#include <QAbstractNativeEventFilter>
+#include <QWindow>
+#include <windows.h>
+
+// 监听系统时间/时区变化和睡眠唤醒的广播消息
+class RolloverScheduler::NativeEventFilter : public QAbstractNativeEventFilter
+{
+public:
+    explicit NativeEventFilter(RolloverScheduler *owner) : owner(owner) {}
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+    bool nativeEventFilter(const QByteArray &eventType, void *message, qintptr *) override
+#else
+    bool nativeEventFilter(const QByteArray &eventType, void *message, long *) override
+#endif
+    {
+        if (eventType == "windows_generic_MSG") {
+            const MSG *msg = static_cast<const MSG *>(message);
+            if (msg->message == WM_TIMECHANGE
+                || (msg->message == WM_POWERBROADCAST && msg->wParam == PBT_APMRESUMEAUTOMATIC)) {
+                // 广播会发给每个顶层窗口，排队后只需重新计算
+                QMetaObject::invokeMethod(owner, &RolloverScheduler::rearm, Qt::QueuedConnection);
+            }
+        }
+        return false;
+    }
+
+private:
+    RolloverScheduler *owner;
+};
+#endif
+
+namespace {
+// 任务的间隔是int毫秒，最长只设7天，超出时到期后再重新计算
+const qint64 kMaxTimerInterval = 7LL * 24 * 60 * 60 * 1000;
+}
+
+RolloverScheduler::RolloverScheduler(TimeService *timeService, WorkdayRule isWorkday, QObject *parent)
+    : QObject(parent)
+    , timeService(timeService)
+    , isWorkday(std::move(isWorkday))
+{
+    // 换日不会提前，最多晚1秒
+    task = new ScheduledTask("rollover", 1000, this);
+    task->setSingleShot(true);
+    connect(task, &ScheduledTask::timeout, this, &RolloverScheduler::rearm);
+    connect(TaskScheduler::global(), &TaskScheduler::suspendedChanged, this, &RolloverScheduler::onSuspendedChanged);
+
+    // 校时后偏移可能变化
+    connect(timeService, &TimeService::synced, this, &RolloverScheduler::rearm);
+
+#ifdef Q_OS_LINUX
+    // 绝对时间的CLOCK_REALTIME定时器：睡眠期间到期会在唤醒后立即触发，
+    // 系统时间被修改时返回ECANCELED
+    timerFd = ::timerfd_create(CLOCK_REALTIME, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timerFd >= 0) {
+        timerNotifier = new QSocketNotifier(timerFd, QSocketNotifier::Read, this);
+        connect(timerNotifier, &QSocketNotifier::activated, this, [this]() {
+            quint64 expirations = 0;
+            if (::read(timerFd, &expirations, sizeof(expirations)) < 0 && errno == ECANCELED)
+                qDebug() << "System clock changed, rescheduling rollover";
+            rearm();
+        });
+    } else {
+        qWarning() << "timerfd_create failed, clock changes will not be detected";
+    }
+
+    zoneWatcher = new QFileSystemWatcher(this);
+    zoneWatcher->addPath("/etc/localtime");
+    connect(zoneWatcher, &QFileSystemWatcher::fileChanged, this, [this](const QString &path) {
+        // 时区文件通常是被替换的符号链接，需要重新添加监视
+        if (!zoneWatcher->files().contains(path))
+            zoneWatcher->addPath(path);
+        rearm();
+    });
+#endif
+
+#ifdef Q_OS_WIN
+    nativeFilter = new NativeEventFilter(this);
+    QCoreApplication::instance()->installNativeEventFilter(nativeFilter);
+    // 隐藏的顶层窗口，保证即使主窗口从未显示也能收到广播
+    messageWindow = new QWindow();
+    messageWindow->create();
+#endif
+
+    rearm();
+}
+
+RolloverScheduler::~RolloverScheduler()
+{
+#ifdef Q_OS_LINUX
+    if (timerFd >= 0)
+        ::close(timerFd);
+#endif
+#ifdef Q_OS_WIN
+    QCoreApplication::instance()->removeNativeEventFilter(nativeFilter);
+    delete nativeFilter;
+    delete messageWindow;
+#endif
+}
+
+QDateTime RolloverScheduler::nextRolloverAfter(const QDateTime &from, const WorkdayRule &isWorkday)
+{
+    QDate day = from.date().addDays(1);
+    for (int i = 0; i < 366; ++i, day = day.addDays(1)) {
+        if (isWorkday(day))
+            return day.startOfDay();
+    }
+    return QDateTime();
+}
+
+void RolloverScheduler::rearm()
+{
+    Metrics::increment(Metrics::RolloverWakeups);
+    // timerfd到期或被取消、唤醒、时区变化都走到这里：系统时间被改过时重新校时
+    timeService->resyncIfDiverged();
+    const QDateTime now = timeService->currentDateTime();
+
+    // 定时器、时间跳变或唤醒都可能让已经错过的换日时刻先到这里
+    if (deadline.isValid() && now >= deadline) {
+        qDebug() << "Date rollover at" << now.toString(Qt::ISODate);
+        deadline = QDateTime();
+        emit rollover(now.date());
+    }
+
+    deadline = nextRolloverAfter(now, isWorkday);
+    if (!deadline.isValid()) {
+        task->stop();
+        return;
+    }
+
+    task->start(int(qBound<qint64>(0, now.msecsTo(deadline), kMaxTimerInterval)));
+    if (!TaskScheduler::global()->isSuspended())
+        armClockWatch();
+}
+
+void RolloverScheduler::armClockWatch()
+{
+#ifdef Q_OS_LINUX
+    // 虚拟时钟下换日只由调度器中的任务触发
+    if (timerFd < 0 || !timeService->usesSystemClock())
+        return;
+    // 按校正后的时间与系统时间此刻的差换算回系统时间；系统时间被改过时也在校正后的零点到期
+    const qint64 systemNowMs = QDateTime::currentMSecsSinceEpoch();
+    const qint64 systemDeadlineMs = deadline.toMSecsSinceEpoch() - (timeService->currentMSecsSinceEpoch() - systemNowMs);
+    // 已经过去的时刻会立即触发并不断重新设置；这种情况只由调度器中的任务换日
+    if (systemDeadlineMs <= systemNowMs)
+        return;
+    itimerspec spec = {};
+    spec.it_value.tv_sec = systemDeadlineMs / 1000;
+    spec.it_value.tv_nsec = (systemDeadlineMs % 1000) * 1000000;
+    if (::timerfd_settime(timerFd, TFD_TIMER_ABSTIME | TFD_TIMER_CANCEL_ON_SET, &spec, nullptr) < 0)
+        qWarning() << "timerfd_settime failed";
+#endif
+}
+
+void RolloverScheduler::onSuspendedChanged(bool suspended)
+{
+    if (!suspended) {
+        // 暂停期间可能已经过了换日时刻
+        rearm();
+        return;
+    }
+#ifdef Q_OS_LINUX
+    // 解除timerfd，暂停期间系统时间变化也不唤醒
+    if (timerFd >= 0) {
+        const itimerspec spec = {};
+        ::timerfd_settime(timerFd, 0, &spec, nullptr);
+    }
+#endif
+}
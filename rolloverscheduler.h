@@ -0,0 +1,58 @@
+#ifndef ROLLOVERSCHEDULER_H
+#define ROLLOVERSCHEDULER_H
+
+#include <QObject>
+#include <QDateTime>
+#include <functional>
+
+class ScheduledTask;
+class QSocketNotifier;
+class QFileSystemWatcher;
+class QWindow;
+class TimeService;
+
+// 换日调度器：精确计算下一个工作日零点，只设一个单次任务，
+// 系统时间跳变、时区变化或从睡眠唤醒时重新计算；任务调度器暂停期间不监视，恢复时补做
+class RolloverScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    using WorkdayRule = std::function<bool(const QDate &)>;
+
+    RolloverScheduler(TimeService *timeService, WorkdayRule isWorkday, QObject *parent = nullptr);
+    ~RolloverScheduler() override;
+
+    QDateTime nextRollover() const { return deadline; }
+
+    // from之后第一个工作日的零点（本地时间）
+    static QDateTime nextRolloverAfter(const QDateTime &from, const WorkdayRule &isWorkday);
+
+public slots:
+    void rearm();
+
+signals:
+    void rollover(const QDate &today);
+
+private:
+    void evaluate();
+    void armClockWatch();
+    void onSuspendedChanged(bool suspended);
+
+    TimeService *timeService;
+    WorkdayRule isWorkday;
+    ScheduledTask *task;
+    QDateTime deadline;
+#ifdef Q_OS_LINUX
+    int timerFd = -1;
+    QSocketNotifier *timerNotifier = nullptr;
+    QFileSystemWatcher *zoneWatcher = nullptr;
+#endif
+#ifdef Q_OS_WIN
+    class NativeEventFilter;
+    NativeEventFilter *nativeFilter = nullptr;
+    QWindow *messageWindow = nullptr;
+#endif
+};
+
+#endif // ROLLOVERSCHEDULER_H
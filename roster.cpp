@@ -0,0 +1,272 @@
+#include "roster.h"
+
+#include <QFile>
+#include <QtAlgorithms>
+#include <QDebug>
+#include <cstring>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define ROSTER_USE_SSE2
+#endif
+
+namespace {
+// 找到下一个分隔符或换行，SSE2每次比较16字节
+const char *findDelimiter(const char *p, const char *end, char delimiter)
+{
+#ifdef ROSTER_USE_SSE2
+    const __m128i delimiterMask = _mm_set1_epi8(delimiter);
+    const __m128i lineFeed = _mm_set1_epi8('\n');
+    const __m128i carriageReturn = _mm_set1_epi8('\r');
+    while (end - p >= 16) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        const __m128i hits = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, delimiterMask),
+                                                       _mm_cmpeq_epi8(chunk, lineFeed)),
+                                          _mm_cmpeq_epi8(chunk, carriageReturn));
+        const int mask = _mm_movemask_epi8(hits);
+        if (mask)
+            return p + qCountTrailingZeroBits(quint32(mask));
+        p += 16;
+    }
+#endif
+    while (p < end && *p != delimiter && *p != '\n' && *p != '\r')
+        ++p;
+    return p;
+}
+
+quint32 hashBytes(const char *data, int size)
+{
+    // FNV-1a
+    quint32 hash = 2166136261u;
+    for (int i = 0; i < size; ++i) {
+        hash ^= quint8(data[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+bool isHeaderName(const QByteArray &field)
+{
+    const QByteArray lowered = field.trimmed().toLower();
+    return lowered == "name" || lowered == "姓名" || lowered == "名字";
+}
+}
+
+bool Roster::load(const QString &filePath)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        clear();
+        return false;
+    }
+
+    const qint64 size = file.size();
+    if (size <= 0 || size > std::numeric_limits<qint32>::max()) {
+        clear();
+        return false;
+    }
+
+    // 字符串都会复制进arena，解析完即可解除映射，不会长时间占用文件
+    if (const uchar *mapped = file.map(0, size)) {
+        const bool ok = parse(reinterpret_cast<const char *>(mapped), size);
+        file.unmap(const_cast<uchar *>(mapped));
+        return ok;
+    }
+    const QByteArray data = file.readAll();
+    return parse(data.constData(), data.size());
+}
+
+bool Roster::parse(const char *data, qint64 size)
+{
+    clear();
+
+    const char *p = data;
+    const char *end = data + size;
+    if (size >= 3 && std::memcmp(p, "\xEF\xBB\xBF", 3) == 0)
+        p += 3;
+
+    // 第一行含制表符时按TSV解析
+    const char *firstLineEnd = static_cast<const char *>(std::memchr(p, '\n', end - p));
+    if (!firstLineEnd)
+        firstLineEnd = end;
+    const char delimiter = std::memchr(p, '\t', firstLineEnd - p) ? '\t' : ',';
+
+    // arena不会超过文件大小，行数不会超过换行符数加一，预留后整个解析过程不再重新分配
+    int lines = 1;
+    for (const char *q = p; (q = static_cast<const char *>(std::memchr(q, '\n', end - q))); ++q)
+        ++lines;
+    arena.reserve(int(size));
+    entries.reserve(lines);
+
+    bool firstRow = true;
+    while (p < end) {
+        Entry entry = {};
+        const int rowMark = arena.size();
+        int column = 0;
+        bool rowDone = false;
+
+        while (!rowDone) {
+            const bool quoted = p < end && *p == '"';
+            const char *fieldBegin;
+            const char *fieldEnd;
+            if (quoted) {
+                // 引号内的""表示一个引号
+                fieldBegin = p + 1;
+                const char *q = fieldBegin;
+                while (q < end) {
+                    q = static_cast<const char *>(std::memchr(q, '"', end - q));
+                    if (!q) {
+                        q = end;
+                        break;
+                    }
+                    if (q + 1 < end && q[1] == '"') {
+                        q += 2;
+                        continue;
+                    }
+                    break;
+                }
+                fieldEnd = q;
+                p = findDelimiter(q < end ? q + 1 : end, end, delimiter);
+            } else {
+                fieldBegin = p;
+                p = findDelimiter(p, end, delimiter);
+                fieldEnd = p;
+                while (fieldBegin < fieldEnd && (*fieldBegin == ' ' || *fieldBegin == '\t'))
+                    ++fieldBegin;
+                while (fieldEnd > fieldBegin && (fieldEnd[-1] == ' ' || fieldEnd[-1] == '\t'))
+                    --fieldEnd;
+            }
+
+            if (column == 0)
+                entry.nameOffset = appendField(fieldBegin, fieldEnd, quoted, &entry.nameLength);
+            else if (column == 1)
+                entry.idOffset = appendField(fieldBegin, fieldEnd, quoted, &entry.idLength);
+            else if (column == 2)
+                entry.groupOffset = appendField(fieldBegin, fieldEnd, quoted, &entry.groupLength);
+            ++column;
+
+            if (p >= end) {
+                rowDone = true;
+            } else if (*p == delimiter) {
+                ++p;
+            } else {
+                if (*p == '\r')
+                    ++p;
+                if (p < end && *p == '\n')
+                    ++p;
+                rowDone = true;
+            }
+        }
+
+        const bool isHeader = firstRow
+            && isHeaderName(QByteArray::fromRawData(arena.constData() + entry.nameOffset, entry.nameLength));
+        firstRow = false;
+        if (entry.nameLength == 0 || isHeader) {
+            arena.truncate(rowMark);
+            continue;
+        }
+        entries.append(entry);
+    }
+
+    buildIndex(nameIndex, false);
+    buildIndex(idIndex, true);
+    return !entries.isEmpty();
+}
+
+void Roster::clear()
+{
+    arena.clear();
+    entries.clear();
+    nameIndex.clear();
+    idIndex.clear();
+}
+
+QString Roster::name(int index) const
+{
+    if (index < 0 || index >= size())
+        return QString();
+    return field(entries[index].nameOffset, entries[index].nameLength);
+}
+
+QString Roster::studentId(int index) const
+{
+    if (index < 0 || index >= size())
+        return QString();
+    return field(entries[index].idOffset, entries[index].idLength);
+}
+
+QString Roster::group(int index) const
+{
+    if (index < 0 || index >= size())
+        return QString();
+    return field(entries[index].groupOffset, entries[index].groupLength);
+}
+
+int Roster::indexOfName(const QString &name) const
+{
+    return lookup(nameIndex, name.trimmed().toUtf8(), false);
+}
+
+int Roster::indexOfId(const QString &id) const
+{
+    return lookup(idIndex, id.trimmed().toUtf8(), true);
+}
+
+quint32 Roster::appendField(const char *begin, const char *end, bool quoted, quint16 *length)
+{
+    const quint32 offset = quint32(arena.size());
+    if (!quoted) {
+        arena.append(begin, int(end - begin));
+    } else {
+        for (const char *p = begin; p < end; ++p) {
+            arena.append(*p);
+            if (*p == '"' && p + 1 < end && p[1] == '"')
+                ++p;
+        }
+    }
+    *length = quint16(qMin<qint64>(arena.size() - offset, 0xFFFF));
+    return offset;
+}
+
+void Roster::buildIndex(QVector<qint32> &table, bool byId)
+{
+    int capacity = 16;
+    while (capacity < size() * 2)
+        capacity <<= 1;
+    table = QVector<qint32>(capacity, 0);
+
+    for (int i = 0; i < size(); ++i) {
+        const quint32 offset = byId ? entries[i].idOffset : entries[i].nameOffset;
+        const quint16 length = byId ? entries[i].idLength : entries[i].nameLength;
+        if (length == 0)
+            continue;
+        // 重复的键保留第一次出现的条目
+        if (lookup(table, QByteArray::fromRawData(arena.constData() + offset, length), byId) >= 0)
+            continue;
+        quint32 slot = hashBytes(arena.constData() + offset, length) & quint32(capacity - 1);
+        while (table[slot])
+            slot = (slot + 1) & quint32(capacity - 1);
+        table[slot] = i + 1;
+    }
+}
+
+int Roster::lookup(const QVector<qint32> &table, const QByteArray &key, bool byId) const
+{
+    if (table.isEmpty() || key.isEmpty())
+        return -1;
+    const quint32 mask = quint32(table.size() - 1);
+    for (quint32 slot = hashBytes(key.constData(), key.size()) & mask; table[slot]; slot = (slot + 1) & mask) {
+        const Entry &entry = entries[table[slot] - 1];
+        const quint32 offset = byId ? entry.idOffset : entry.nameOffset;
+        const quint16 length = byId ? entry.idLength : entry.nameLength;
+        if (length == key.size() && std::memcmp(arena.constData() + offset, key.constData(), length) == 0)
+            return table[slot] - 1;
+    }
+    return -1;
+}
+
+QString Roster::field(quint32 offset, quint16 length) const
+{
+    return QString::fromUtf8(arena.constData() + offset, length);
+}
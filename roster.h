@@ -0,0 +1,50 @@
+#ifndef ROSTER_H
+#define ROSTER_H
+
+#include <QByteArray>
+#include <QVector>
+#include <QString>
+
+// CSV/TSV名单：姓名, 学号[, 分组]。
+// 文件内存映射后一次扫描解析，所有字符串存放在同一块arena中，条目只保存偏移
+class Roster
+{
+public:
+    struct Entry {
+        quint32 nameOffset;
+        quint32 idOffset;
+        quint32 groupOffset;
+        quint16 nameLength;
+        quint16 idLength;
+        quint16 groupLength;
+    };
+
+    bool load(const QString &filePath);
+    // 从内存解析，load()内部也使用它
+    bool parse(const char *data, qint64 size);
+    void clear();
+
+    bool isEmpty() const { return entries.isEmpty(); }
+    int size() const { return int(entries.size()); }
+
+    QString name(int index) const;
+    QString studentId(int index) const;
+    QString group(int index) const;
+
+    // 找不到时返回-1
+    int indexOfName(const QString &name) const;
+    int indexOfId(const QString &id) const;
+
+private:
+    quint32 appendField(const char *begin, const char *end, bool quoted, quint16 *length);
+    void buildIndex(QVector<qint32> &table, bool byId);
+    int lookup(const QVector<qint32> &table, const QByteArray &key, bool byId) const;
+    QString field(quint32 offset, quint16 length) const;
+
+    QByteArray arena;
+    QVector<Entry> entries;
+    QVector<qint32> nameIndex;   // 开放寻址哈希表，保存条目下标+1，0表示空位
+    QVector<qint32> idIndex;
+};
+
+#endif // ROSTER_H
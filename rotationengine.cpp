@@ -0,0 +1,52 @@
+#include "rotationengine.h"
+#include "workcalendar.h"
+
+namespace {
+qint64 positiveMod(qint64 value, qint64 modulus)
+{
+    const qint64 result = value % modulus;
+    return result < 0 ? result + modulus : result;
+}
+}
+
+void RotationEngine::setAnchor(const QDate &date, const Pair &pair)
+{
+    anchor = date;
+    anchorIndices = pair;
+}
+
+void RotationEngine::setTotalPersons(int persons)
+{
+    this->persons = qMax(2, persons);
+}
+
+qint64 RotationEngine::stepsTo(const QDate &date) const
+{
+    if (!anchor.isValid() || !date.isValid())
+        return 0;
+    if (calendar)
+        return calendar->workdaysBetween(anchor, date);
+    return WorkCalendar::weekdayRank(date.toJulianDay()) - WorkCalendar::weekdayRank(anchor.toJulianDay());
+}
+
+RotationEngine::Pair RotationEngine::pairAt(qint64 steps) const
+{
+    // 先取模再乘2，避免很大的步数溢出
+    const qint64 shift = positiveMod(2 * positiveMod(steps, persons), persons);
+    Pair pair;
+    pair.first = int(positiveMod(anchorIndices.first + shift, persons));
+    pair.second = int(positiveMod(anchorIndices.second + shift, persons));
+    // 确保两个人不同
+    if (pair.first == pair.second)
+        pair.second = (pair.second + 1) % persons;
+    return pair;
+}
+
+std::optional<qint64> RotationEngine::stepsToPair(const Pair &pair) const
+{
+    for (int steps = 0; steps < persons; ++steps) {
+        if (pairAt(steps) == pair)
+            return steps;
+    }
+    return std::nullopt;
+}
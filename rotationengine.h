@@ -0,0 +1,48 @@
+#ifndef ROTATIONENGINE_H
+#define ROTATIONENGINE_H
+
+#include <QDate>
+#include <optional>
+
+class WorkCalendar;
+
+// 值日轮换的闭式计算：给定锚点日期、锚点当天的两人、总人数和工作日日历，
+// 任意日期的值日组合都可以直接算出，不需要逐日迭代，也不依赖历史状态
+class RotationEngine
+{
+public:
+    struct Pair {
+        int first = 0;
+        int second = 1;
+        bool operator==(const Pair &other) const { return first == other.first && second == other.second; }
+        bool operator!=(const Pair &other) const { return !(*this == other); }
+    };
+
+    void setAnchor(const QDate &date, const Pair &pair);
+    QDate anchorDate() const { return anchor; }
+    Pair anchorPair() const { return anchorIndices; }
+
+    // 不设置日历时按周一到周五计算；日历由调用者持有
+    void setCalendar(const WorkCalendar *calendar) { this->calendar = calendar; }
+
+    void setTotalPersons(int persons);
+    int totalPersons() const { return persons; }
+
+    // 从锚点到date经过的工作日数（date在锚点之前时为负）
+    qint64 stepsTo(const QDate &date) const;
+    // 锚点之后第steps个工作日的组合，每个工作日前进两人
+    Pair pairAt(qint64 steps) const;
+    // offset是手动“上一组/下一组”累计的步数
+    Pair pairFor(const QDate &date, qint64 offset = 0) const { return pairAt(stepsTo(date) + offset); }
+
+    // 从锚点组合走多少步能得到pair，用于迁移旧配置；人数变过等原因找不到时为空
+    std::optional<qint64> stepsToPair(const Pair &pair) const;
+
+private:
+    QDate anchor;
+    Pair anchorIndices;
+    const WorkCalendar *calendar = nullptr;
+    int persons = 47;
+};
+
+#endif // ROTATIONENGINE_H
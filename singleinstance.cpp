@@ -0,0 +1,243 @@
+#include "singleinstance.h"
+#include "headless.h"
+
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QDeadlineTimer>
+#include <QDir>
+#include <QFileInfo>
+#ifdef ONDUTY_HAVE_NETWORK
+#include <QCoreApplication>
+#include <QLocalServer>
+#include <QLocalSocket>
+#endif
+#include <QLockFile>
+#include <QThread>
+#include <cstdio>
+#include <cstring>
+#ifdef Q_OS_WIN
+#include <windows.h>
+#endif
+
+namespace {
+const int kConnectTimeout = 200;  // 本机套接字，连不上说明没有实例在监听
+const int kStartupWait = 3000;    // 持有锁的实例可能还在创建QApplication，等它开始监听
+const int kReplyTimeout = 2000;
+const int kMaxCommandLength = 64;
+
+struct CommandOption {
+    const char *option;
+    const char *command;
+};
+
+const CommandOption kCommands[] = {
+    { "--show", "show" },
+    { "--next", "next" },
+    { "--previous", "previous" },
+    { "--toggle-exam", "toggle-exam" },
+    { "--query", "query" },
+};
+
+#ifdef ONDUTY_HAVE_NETWORK
+bool connectTo(QLocalSocket &socket, const QString &name, int waitMs)
+{
+    const QDeadlineTimer deadline(waitMs);
+    for (;;) {
+        socket.connectToServer(name);
+        if (socket.waitForConnected(kConnectTimeout))
+            return true;
+        socket.abort();
+        if (deadline.hasExpired())
+            return false;
+        QThread::msleep(50);
+    }
+}
+#endif
+}
+
+SingleInstance::SingleInstance(const QString &configPath, QObject *parent)
+    : QObject(parent)
+    , name(serverName(configPath))
+    , lock(new QLockFile(QDir::tempPath() + '/' + name + ".lock"))
+{
+    // 只按进程是否存在判断锁是否失效，运行很久的实例不能被当成失效
+    lock->setStaleLockTime(0);
+}
+
+SingleInstance::~SingleInstance()
+{
+#ifdef ONDUTY_HAVE_NETWORK
+    if (server)
+        server->close();
+#endif
+    delete lock;
+}
+
+int SingleInstance::lockOrForward(const QByteArray &command)
+{
+    if (command == "query") {
+        // 查询不启动实例：锁没有被持有时直接说明，不去连接
+        if (lock->tryLock(0)) {
+            lock->unlock();
+            attachParentConsole();
+#ifdef ONDUTY_HAVE_NETWORK
+            std::fprintf(stderr, "No running instance, use --today instead\n");
+#else
+            std::fprintf(stderr, "Command forwarding is unavailable in the lean build, use --today instead\n");
+#endif
+            return 1;
+        }
+    } else if (lock->tryLock(0)) {
+        return -1;
+    }
+
+    // 锁被另一个实例持有，它一定会开始监听（或已经在监听）
+    QByteArray reply;
+    if (!send(command, &reply, kStartupWait))
+        return reportForwardFailure(command);
+    return printReply(command, reply);
+}
+
+bool SingleInstance::listen()
+{
+    if (!lock->isLocked())
+        return false;
+
+#ifdef ONDUTY_HAVE_NETWORK
+    server = new QLocalServer(this);
+    server->setSocketOptions(QLocalServer::UserAccessOption);
+    // 已经持有锁，遗留的套接字文件一定来自异常退出的进程
+    QLocalServer::removeServer(name);
+    if (!server->listen(name)) {
+        // 监听失败时仍然持有锁，其他进程照样不会再启动一个实例
+        qWarning() << "无法监听本地套接字" << name << server->errorString();
+        return true;
+    }
+    connect(server, &QLocalServer::newConnection, this, &SingleInstance::onNewConnection);
+    // 本对象在QApplication之前创建、之后销毁，套接字要在事件循环结束时先关掉
+    connect(QCoreApplication::instance(), &QCoreApplication::aboutToQuit, this, [this]() {
+        delete server;
+        server = nullptr;
+    });
+#endif
+    return true;
+}
+
+void SingleInstance::setHandler(Handler handler)
+{
+    this->handler = std::move(handler);
+}
+
+bool SingleInstance::send(const QByteArray &command, QByteArray *reply, int waitMs) const
+{
+#ifndef ONDUTY_HAVE_NETWORK
+    // 精简构建没有本地套接字，只靠锁文件保证单实例，命令不能转发
+    Q_UNUSED(command);
+    Q_UNUSED(reply);
+    Q_UNUSED(waitMs);
+    return false;
+#else
+    QLocalSocket socket;
+    if (!connectTo(socket, name, waitMs))
+        return false;
+
+    socket.write(command + '\n');
+    socket.waitForBytesWritten(kReplyTimeout);
+
+    QByteArray received;
+    const QDeadlineTimer deadline(kReplyTimeout);
+    while (!received.contains('\n') && !deadline.hasExpired()) {
+        if (!socket.waitForReadyRead(int(qMax<qint64>(deadline.remainingTime(), 1))))
+            break;
+        received += socket.readAll();
+    }
+    *reply = received.contains('\n') ? received.left(received.indexOf('\n')) : QByteArray("error 没有收到回复");
+    return true;
+#endif
+}
+
+void SingleInstance::onNewConnection()
+{
+#ifdef ONDUTY_HAVE_NETWORK
+    while (QLocalSocket *socket = server->nextPendingConnection()) {
+        connect(socket, &QLocalSocket::disconnected, socket, &QObject::deleteLater);
+        connect(socket, &QLocalSocket::readyRead, this, [this, socket]() {
+            if (!socket->canReadLine()) {
+                if (socket->bytesAvailable() > kMaxCommandLength)
+                    socket->abort();
+                return;
+            }
+            const QByteArray command = socket->readLine(kMaxCommandLength + 1).trimmed();
+            const QByteArray reply = handler ? handler(command) : QByteArray("busy");
+            socket->write(reply + '\n');
+            socket->disconnectFromServer();
+        });
+    }
+#endif
+}
+
+QByteArray SingleInstance::commandFromArguments(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; ++i) {
+        for (const CommandOption &option : kCommands) {
+            if (std::strcmp(argv[i], option.option) == 0)
+                return option.command;
+        }
+    }
+    return "show";
+}
+
+QString SingleInstance::applicationDir(char *argv[])
+{
+#ifdef Q_OS_LINUX
+    // argv[0]可能只是PATH中的程序名
+    const QString exe = QFileInfo(QStringLiteral("/proc/self/exe")).symLinkTarget();
+    if (!exe.isEmpty())
+        return QFileInfo(exe).absolutePath();
+#elif defined(Q_OS_WIN)
+    // 从命令行启动时argv[0]可能是不带目录的程序名
+    wchar_t path[MAX_PATH];
+    const DWORD length = GetModuleFileNameW(nullptr, path, MAX_PATH);
+    if (length > 0 && length < MAX_PATH)
+        return QFileInfo(QDir::fromNativeSeparators(QString::fromWCharArray(path, int(length)))).absolutePath();
+#endif
+    return QFileInfo(QString::fromLocal8Bit(argv[0])).absolutePath();
+}
+
+int SingleInstance::reportForwardFailure(const QByteArray &command)
+{
+    attachParentConsole();
+#ifdef ONDUTY_HAVE_NETWORK
+    std::fprintf(stderr, "Another instance is running but did not accept \"%s\"\n", command.constData());
+#else
+    // 锁文件被另一个实例持有，但精简构建没有本地套接字
+    std::fprintf(stderr, "Another instance is running; command forwarding is unavailable in the lean build (\"%s\" not sent)\n",
+                 command.constData());
+#endif
+    return 1;
+}
+
+int SingleInstance::printReply(const QByteArray &command, const QByteArray &reply)
+{
+    if (command == "query" && !reply.startsWith("error")) {
+        attachParentConsole();
+        std::printf("%s\n", reply.constData());
+        std::fflush(stdout);
+        return 0;
+    }
+    if (reply == "ok")
+        return 0;
+    attachParentConsole();
+    std::fprintf(stderr, "%s\n", reply.constData());
+    return 1;
+}
+
+QString SingleInstance::serverName(const QString &configPath)
+{
+    QString path = QDir::cleanPath(QFileInfo(configPath).absoluteFilePath());
+#ifdef Q_OS_WIN
+    path = path.toLower();
+#endif
+    const QByteArray hash = QCryptographicHash::hash(path.toUtf8(), QCryptographicHash::Sha1).toHex();
+    return QStringLiteral("onduty-") + QString::fromLatin1(hash.left(16));
+}
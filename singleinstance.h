@@ -0,0 +1,56 @@
+#ifndef SINGLEINSTANCE_H
+#define SINGLEINSTANCE_H
+
+#include <QObject>
+#include <QString>
+#include <functional>
+
+class QLocalServer;
+class QLockFile;
+
+// 单实例：同一个配置文件只允许一个窗口程序运行。
+// 进程启动时先取锁：取得锁的是唯一的实例，随后监听本地套接字；锁被持有时把命令转发过去后立即退出。
+// 命令是一行文本：show、next、previous、toggle-exam、query，回复也是一行。
+// 精简构建没有本地套接字，只用锁文件阻止第二个实例，命令不能转发
+class SingleInstance : public QObject
+{
+    Q_OBJECT
+
+public:
+    // 收到命令时调用，返回回复的文本
+    using Handler = std::function<QByteArray(const QByteArray &command)>;
+
+    explicit SingleInstance(const QString &configPath, QObject *parent = nullptr);
+    ~SingleInstance();
+
+    // 在创建QApplication之前调用：取得锁时返回-1，由调用者启动实例并调用listen()；
+    // 锁被其他实例持有时把命令转发给它，返回退出码。query没有实例可问，不取锁，返回1
+    int lockOrForward(const QByteArray &command);
+    // 持有锁后在QApplication创建之后调用，开始监听；没有持有锁时返回false
+    bool listen();
+    // 没有设置处理函数之前收到的命令回复busy
+    void setHandler(Handler handler);
+    // 把命令发给正在运行的实例，waitMs内连不上时重试；没有实例时返回false
+    bool send(const QByteArray &command, QByteArray *reply, int waitMs = 0) const;
+
+    // 命令行中的转发参数，没有时为show
+    static QByteArray commandFromArguments(int argc, char *argv[]);
+    // 程序所在的目录，不需要QCoreApplication，与QCoreApplication::applicationDirPath()相同
+    static QString applicationDir(char *argv[]);
+    // 已有实例但命令没有送达：在stderr说明原因，返回退出码1
+    static int reportForwardFailure(const QByteArray &command);
+    // 打印回复并换算成退出码
+    static int printReply(const QByteArray &command, const QByteArray &reply);
+    // 由配置文件的绝对路径得到套接字名称，不同目录的副本互不影响
+    static QString serverName(const QString &configPath);
+
+private:
+    void onNewConnection();
+
+    QString name;
+    QLockFile *lock;
+    QLocalServer *server = nullptr;
+    Handler handler;
+};
+
+#endif // SINGLEINSTANCE_H
@@ -0,0 +1,143 @@
+#include "startuptrace.h"
+
+#include <QElapsedTimer>
+#include <QDateTime>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QVector>
+#include <QDebug>
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#elif defined(Q_OS_LINUX)
+#include <ctime>
+#include <unistd.h>
+#endif
+
+namespace {
+struct Phase {
+    const char *name;
+    qint64 ns;
+};
+
+struct TraceState {
+    QElapsedTimer timer;
+    qint64 preMainNs = -1;
+    bool print = false;
+    bool finished = false;
+    QVector<Phase> phases;
+};
+
+TraceState &trace()
+{
+    static TraceState state;
+    return state;
+}
+
+// 进程创建到现在经过的时间，取不到时返回-1
+qint64 processAgeNs()
+{
+#ifdef Q_OS_WIN
+    FILETIME creation, exitTime, kernel, user, now;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exitTime, &kernel, &user))
+        return -1;
+    GetSystemTimeAsFileTime(&now);
+    const auto ticks = [](const FILETIME &time) {
+        return (qint64(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+    };
+    return (ticks(now) - ticks(creation)) * 100;
+#elif defined(Q_OS_LINUX)
+    // /proc/self/stat第22个字段是进程启动时距开机的时钟滴答数
+    QFile stat(QStringLiteral("/proc/self/stat"));
+    if (!stat.open(QIODevice::ReadOnly))
+        return -1;
+    const QByteArray data = stat.readAll();
+    const QList<QByteArray> fields = data.mid(data.lastIndexOf(')') + 2).split(' ');
+    if (fields.size() < 20)
+        return -1;
+    timespec now;
+    if (clock_gettime(CLOCK_BOOTTIME, &now) != 0)
+        return -1;
+    const qint64 startNs = fields[19].toLongLong() * 1000000000LL / sysconf(_SC_CLK_TCK);
+    return qint64(now.tv_sec) * 1000000000LL + now.tv_nsec - startNs;
+#else
+    return -1;
+#endif
+}
+
+void printPhase(const char *name, qint64 ns)
+{
+    qInfo().noquote() << QStringLiteral("[startup] %1 ms  %2").arg(ns / 1e6, 8, 'f', 2).arg(QLatin1String(name));
+}
+}
+
+void StartupTrace::start()
+{
+    TraceState &state = trace();
+    state.timer.start();
+    state.preMainNs = processAgeNs();
+    state.phases.reserve(16);
+}
+
+void StartupTrace::setPrintEnabled(bool enabled)
+{
+    TraceState &state = trace();
+    state.print = enabled;
+    if (enabled && state.preMainNs >= 0)
+        printPhase("process-start -> main", -state.preMainNs);
+}
+
+void StartupTrace::mark(const char *phase)
+{
+    TraceState &state = trace();
+    if (state.finished || !state.timer.isValid())
+        return;
+    const qint64 ns = state.timer.nsecsElapsed();
+    state.phases.append({ phase, ns });
+    if (state.print)
+        printPhase(phase, ns);
+}
+
+void StartupTrace::finish(const char *phase, const QString &metricsPath)
+{
+    TraceState &state = trace();
+    if (state.finished)
+        return;
+    mark(phase);
+    state.finished = true;
+    if (state.phases.isEmpty())
+        return;
+
+    // 用数组保持阶段顺序
+    QJsonArray phases;
+    for (const Phase &entry : state.phases)
+        phases.append(QJsonArray{ QLatin1String(entry.name), entry.ns / 1e6 });
+    QJsonObject record;
+    record["time"] = QDateTime::currentDateTime().toString(Qt::ISODate);
+    if (state.preMainNs >= 0)
+        record["preMainMs"] = state.preMainNs / 1e6;
+    record["phases"] = phases;
+    record["totalMs"] = state.phases.last().ns / 1e6;
+
+    // 每次启动追加一行，文件过大时从头开始
+    QFile file(metricsPath);
+    const QIODevice::OpenMode mode = file.size() > 256 * 1024 ? QIODevice::WriteOnly | QIODevice::Truncate
+                                                               : QIODevice::WriteOnly | QIODevice::Append;
+    if (!file.open(mode)) {
+        qWarning() << "Failed to write startup metrics:" << metricsPath << file.errorString();
+        return;
+    }
+    file.write(QJsonDocument(record).toJson(QJsonDocument::Compact) + '\n');
+}
+
+bool StartupTrace::isFinished()
+{
+    return trace().finished;
+}
+
+double StartupTrace::elapsedMs()
+{
+    return trace().timer.isValid() ? trace().timer.nsecsElapsed() / 1e6 : 0.0;
+}
@@ -0,0 +1,23 @@
+#ifndef STARTUPTRACE_H
+#define STARTUPTRACE_H
+
+#include <QString>
+
+// 启动计时：记录各阶段距main()开始的时间（能取到时也记录进程创建到main()的时间）。
+// --trace-startup时逐条打印；finish()时把本次结果追加到指标文件，每次启动一行JSON
+class StartupTrace
+{
+public:
+    // 在main()第一行调用
+    static void start();
+    static void setPrintEnabled(bool enabled);
+
+    static void mark(const char *phase);
+    // 记录最后一个阶段并写入指标文件，之后的mark()和finish()都被忽略
+    static void finish(const char *phase, const QString &metricsPath);
+    static bool isFinished();
+
+    static double elapsedMs();
+};
+
+#endif // STARTUPTRACE_H
@@ -0,0 +1,134 @@
+#include "statejournal.h"
+#include "metrics.h"
+
+#include <QElapsedTimer>
+#include <QtEndian>
+#include <QDebug>
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+// 记录格式（小端）：magic(1) roster<<4|field(1) seq(4) value(8) crc32(4)
+const quint8 kRecordMagic = 0xD7;
+const int kPayloadSize = 14;
+const int kRecordSize = kPayloadSize + 4;
+static_assert(StateJournal::FieldCount <= 0x10, "字段编号只占字段字节的低4位");
+}
+
+StateJournal::StateJournal(const QString &filePath)
+    : file(filePath)
+{
+}
+
+StateJournal::~StateJournal()
+{
+    file.close();
+}
+
+quint32 StateJournal::crc32(const char *data, int size)
+{
+    quint32 crc = 0xFFFFFFFFu;
+    for (int i = 0; i < size; ++i) {
+        crc ^= quint8(data[i]);
+        for (int bit = 0; bit < 8; ++bit)
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+    }
+    return ~crc;
+}
+
+QList<StateJournal::Record> StateJournal::replay(quint32 snapshotSeq, bool repair)
+{
+    QList<Record> records;
+    seq = snapshotSeq;
+    pending = 0;
+
+    file.close();
+    if (!file.open(repair ? QIODevice::ReadWrite : QIODevice::ReadOnly))
+        return records;
+
+    const QByteArray data = file.readAll();
+    qint64 validSize = 0;
+    for (int offset = 0; offset + kRecordSize <= data.size(); offset += kRecordSize) {
+        const char *record = data.constData() + offset;
+        if (quint8(record[0]) != kRecordMagic
+            || qFromLittleEndian<quint32>(record + kPayloadSize) != crc32(record, kPayloadSize)) {
+            break;
+        }
+        validSize = offset + kRecordSize;
+
+        const quint8 field = quint8(record[1]) & 0x0F;
+        const quint8 roster = quint8(record[1]) >> 4;
+        const quint32 recordSeq = qFromLittleEndian<quint32>(record + 2);
+        if (field == 0 || field >= FieldCount)
+            continue;
+        seq = qMax(seq, recordSeq);
+        ++pending;
+        if (recordSeq > snapshotSeq)
+            records.append({ Field(field), roster, recordSeq, qFromLittleEndian<qint64>(record + 6) });
+    }
+
+    if (repair && validSize != data.size()) {
+        qWarning() << "State journal has a damaged tail, discarding" << data.size() - validSize << "bytes";
+        file.resize(validSize);
+    }
+    file.close();
+    return records;
+}
+
+bool StateJournal::append(Field field, qint64 value, int roster)
+{
+    Q_ASSERT(roster >= 0 && roster < MaxRosters);
+    if (!openForAppend())
+        return false;
+
+    QElapsedTimer timer;
+    timer.start();
+    char record[kRecordSize];
+    record[0] = char(kRecordMagic);
+    record[1] = char(roster << 4 | field);
+    qToLittleEndian<quint32>(seq + 1, record + 2);
+    qToLittleEndian<qint64>(value, record + 6);
+    qToLittleEndian<quint32>(crc32(record, kPayloadSize), record + kPayloadSize);
+
+    if (file.write(record, kRecordSize) != kRecordSize || !file.flush()) {
+        qWarning() << "Failed to append to state journal:" << file.errorString();
+        return false;
+    }
+#ifdef Q_OS_WIN
+    _commit(file.handle());
+#else
+    ::fsync(file.handle());
+#endif
+
+    ++seq;
+    ++pending;
+    Metrics::increment(Metrics::JournalAppends);
+    Metrics::increment(Metrics::JournalBytesWritten, kRecordSize);
+    Metrics::record(Metrics::JournalAppendTime, timer.nsecsElapsed() / 1000);
+    return true;
+}
+
+bool StateJournal::truncate()
+{
+    if (!openForAppend())
+        return false;
+    if (!file.resize(0))
+        return false;
+    pending = 0;
+    return true;
+}
+
+bool StateJournal::openForAppend()
+{
+    if (file.isOpen())
+        return true;
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        qWarning() << "Failed to open state journal:" << file.fileName() << file.errorString();
+        return false;
+    }
+    return true;
+}
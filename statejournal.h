@@ -0,0 +1,65 @@
+#ifndef STATEJOURNAL_H
+#define STATEJOURNAL_H
+
+#include <QFile>
+#include <QList>
+#include <QString>
+
+// 值日状态的追加式日志：每次状态变化只追加一条带校验的小记录，
+// 启动时在最近一次快照（配置文件）之上重放，定期合并进快照后清空
+class StateJournal
+{
+public:
+    enum Field : quint8 {
+        DutyIndex1 = 1, // 旧版本的当前编号，只在迁移时读取
+        DutyIndex2,
+        LastUpdate,     // yyyyMMdd
+        OriginIndex1,   // 旧版本的原始编号，只在迁移时读取
+        OriginIndex2,
+        TestingMode,
+        AnchorDate,     // 儒略日
+        AnchorIndex1,
+        AnchorIndex2,
+        ManualOffset,
+        OriginOffset,
+        PinDate,        // 儒略日，学期内手动调整的日子
+        PinSteps,
+        FieldCount
+    };
+
+    // 字段字节的高4位是名单序号，旧日志中都是0
+    static constexpr int MaxRosters = 16;
+
+    struct Record {
+        Field field;
+        quint8 roster;
+        quint32 seq;
+        qint64 value;
+    };
+
+    explicit StateJournal(const QString &filePath);
+    ~StateJournal();
+
+    // 读取序号大于snapshotSeq的记录；遇到损坏或不完整的尾部时截断到最后一条有效记录，
+    // repair为false时只读，不创建也不截断文件
+    QList<Record> replay(quint32 snapshotSeq, bool repair = true);
+
+    bool append(Field field, qint64 value, int roster = 0);
+
+    // 快照已包含lastSeq()之前的全部记录后调用，清空日志但序号继续递增
+    bool truncate();
+
+    quint32 lastSeq() const { return seq; }
+    int pendingRecords() const { return pending; }
+
+    static quint32 crc32(const char *data, int size);
+
+private:
+    bool openForAppend();
+
+    QFile file;
+    quint32 seq = 0;
+    int pending = 0;
+};
+
+#endif // STATEJOURNAL_H
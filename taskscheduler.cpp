@@ -0,0 +1,199 @@
+#include "taskscheduler.h"
+#include "metrics.h"
+#include "virtualclock.h"
+
+#include <QCoreApplication>
+#include <QTimer>
+
+namespace {
+// QTimer的间隔是int毫秒，更远的唤醒时间到点后再重新计算
+const qint64 kMaxTimerInterval = 24LL * 60 * 60 * 1000;
+}
+
+TaskScheduler::TaskScheduler(QObject *parent)
+    : QObject(parent)
+    , clock(Clock::system())
+    , originNs(clock->nsecsElapsed())
+{
+    // 合并由slack完成，定时器本身要准时，不能提前触发
+    timer = new QTimer(this);
+    timer->setSingleShot(true);
+    timer->setTimerType(Qt::PreciseTimer);
+    connect(timer, &QTimer::timeout, this, &TaskScheduler::onTimeout);
+}
+
+TaskScheduler::~TaskScheduler()
+{
+    for (ScheduledTask *task : std::as_const(tasks))
+        task->scheduler = nullptr;
+}
+
+TaskScheduler *TaskScheduler::global()
+{
+    static QPointer<TaskScheduler> instance;
+    if (!instance)
+        instance = new TaskScheduler(QCoreApplication::instance());
+    return instance;
+}
+
+void TaskScheduler::setSuspended(bool suspended)
+{
+    if (this->suspended == suspended)
+        return;
+    this->suspended = suspended;
+    reschedule();
+    emit suspendedChanged(suspended);
+}
+
+void TaskScheduler::setClock(const Clock *clock)
+{
+    this->clock = clock ? clock : Clock::system();
+    originNs = this->clock->nsecsElapsed();
+    timer->stop();
+    reschedule();
+}
+
+qint64 TaskScheduler::now() const
+{
+    return (clock->nsecsElapsed() - originNs) / 1000000;
+}
+
+void TaskScheduler::runDue()
+{
+    if (nextWake >= 0 && now() >= nextWake)
+        onTimeout();
+}
+
+double TaskScheduler::wakeupsPerHour() const
+{
+    return wakeupCount * 3600000.0 / qMax<qint64>(now(), 1);
+}
+
+void TaskScheduler::add(ScheduledTask *task)
+{
+    tasks.append(task);
+}
+
+void TaskScheduler::remove(ScheduledTask *task)
+{
+    tasks.removeOne(task);
+    if (task->active)
+        reschedule();
+}
+
+void TaskScheduler::reschedule()
+{
+    // 分发过程中的启动和停止在分发结束后统一处理
+    if (dispatching)
+        return;
+
+    qint64 wakeAt = -1;
+    for (const ScheduledTask *task : std::as_const(tasks)) {
+        if (!isRunnable(task))
+            continue;
+        const qint64 latest = task->due + task->slackMs;
+        if (wakeAt < 0 || latest < wakeAt)
+            wakeAt = latest;
+    }
+    nextWake = wakeAt;
+    if (wakeAt < 0 || !clock->isSystem()) {
+        timer->stop();
+        return;
+    }
+    timer->start(int(qBound<qint64>(0, wakeAt - now(), kMaxTimerInterval)));
+}
+
+void TaskScheduler::onTimeout()
+{
+    ++wakeupCount;
+    Metrics::increment(Metrics::SchedulerWakeups);
+
+    // 先选出这次到期的任务，回调中可能启动、停止或删除任务
+    const qint64 current = now();
+    QVector<QPointer<ScheduledTask>> due;
+    for (ScheduledTask *task : std::as_const(tasks)) {
+        if (isRunnable(task) && task->due <= current)
+            due.append(task);
+    }
+
+    dispatching = true;
+    for (const QPointer<ScheduledTask> &task : std::as_const(due)) {
+        if (!task || !isRunnable(task) || task->due > current)
+            continue;
+        if (task->single || task->period <= 0) {
+            task->active = false;
+        } else {
+            task->due += task->period;
+            if (task->due <= current)
+                task->due = current + task->period;
+        }
+        emit task->timeout();
+    }
+    dispatching = false;
+    reschedule();
+}
+
+bool TaskScheduler::isRunnable(const ScheduledTask *task) const
+{
+    return task->active && (!suspended || task->whileSuspended);
+}
+
+ScheduledTask::ScheduledTask(const char *name, int slackMs, QObject *parent, TaskScheduler *scheduler)
+    : QObject(parent)
+    , taskName(name)
+    , scheduler(scheduler ? scheduler : TaskScheduler::global())
+    , slackMs(qMax(0, slackMs))
+{
+    this->scheduler->add(this);
+}
+
+ScheduledTask::~ScheduledTask()
+{
+    if (scheduler)
+        scheduler->remove(this);
+}
+
+void ScheduledTask::setSlack(int msec)
+{
+    slackMs = qMax(0, msec);
+    if (active && scheduler)
+        scheduler->reschedule();
+}
+
+void ScheduledTask::setRunWhileSuspended(bool run)
+{
+    whileSuspended = run;
+    if (active && scheduler)
+        scheduler->reschedule();
+}
+
+qint64 ScheduledTask::remainingTime() const
+{
+    if (!active || !scheduler)
+        return -1;
+    return qMax<qint64>(0, due - scheduler->now());
+}
+
+void ScheduledTask::start()
+{
+    if (!scheduler)
+        return;
+    due = scheduler->now() + period;
+    active = true;
+    scheduler->reschedule();
+}
+
+void ScheduledTask::start(int msec)
+{
+    setInterval(msec);
+    start();
+}
+
+void ScheduledTask::stop()
+{
+    if (!active)
+        return;
+    active = false;
+    if (scheduler)
+        scheduler->reschedule();
+}
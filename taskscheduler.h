@@ -0,0 +1,115 @@
+#ifndef TASKSCHEDULER_H
+#define TASKSCHEDULER_H
+
+#include <QObject>
+#include <QPointer>
+#include <QVector>
+
+class Clock;
+class QTimer;
+class ScheduledTask;
+
+// 所有周期任务和定时任务共用的调度器，只有一个定时器。每个任务可以推迟slack毫秒，
+// 唤醒时间取各任务最晚允许时间中最早的一个，届时所有已经到期的任务一起运行，时间窗口重叠的任务只唤醒一次。
+// 暂停时（考试模式下窗口隐藏）只有标记为runWhileSuspended的任务继续运行，恢复后立即补做已经到期的任务。
+// 时间来自Clock，模拟器换成虚拟时钟后不启动定时器，由调用者推进时钟并调用runDue()
+class TaskScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit TaskScheduler(QObject *parent = nullptr);
+    ~TaskScheduler() override;
+
+    // 程序共用的调度器，随QCoreApplication一起销毁
+    static TaskScheduler *global();
+
+    void setSuspended(bool suspended);
+    bool isSuspended() const { return suspended; }
+
+    // 只能在添加任务之前调用，任务的到期时间按原来的时钟计算
+    void setClock(const Clock *clock);
+    // 调度器时间：从创建（或换时钟）起的毫秒数
+    qint64 now() const;
+    // 下一次唤醒的调度器时间，没有可运行的任务时为-1
+    qint64 nextWakeup() const { return nextWake; }
+    // 运行已经到期的任务，与定时器触发相同；还没到唤醒时间时什么也不做
+    void runDue();
+    int taskCount() const { return int(tasks.size()); }
+
+    // 定时器真正触发的次数，以及按创建以来的时间折算的每小时次数
+    quint64 wakeups() const { return wakeupCount; }
+    double wakeupsPerHour() const;
+
+signals:
+    void suspendedChanged(bool suspended);
+
+private:
+    friend class ScheduledTask;
+
+    void add(ScheduledTask *task);
+    void remove(ScheduledTask *task);
+    void reschedule();
+    void onTimeout();
+    bool isRunnable(const ScheduledTask *task) const;
+
+    QVector<ScheduledTask *> tasks;
+    QTimer *timer;
+    const Clock *clock;
+    qint64 originNs = 0;
+    qint64 nextWake = -1;
+    quint64 wakeupCount = 0;
+    bool suspended = false;
+    bool dispatching = false;
+};
+
+// 调度器中的一个任务，用法与QTimer相同：start后到期发出timeout信号。
+// 任务不会提前运行，最多推迟slack毫秒；周期任务按原来的节拍继续，睡眠期间错过的周期不补做
+class ScheduledTask : public QObject
+{
+    Q_OBJECT
+
+public:
+    // scheduler为空时使用TaskScheduler::global()
+    ScheduledTask(const char *name, int slackMs, QObject *parent = nullptr, TaskScheduler *scheduler = nullptr);
+    ~ScheduledTask() override;
+
+    const char *name() const { return taskName; }
+
+    void setSingleShot(bool singleShot) { single = singleShot; }
+    bool isSingleShot() const { return single; }
+    void setInterval(int msec) { period = qMax(0, msec); }
+    int interval() const { return period; }
+    void setSlack(int msec);
+    int slack() const { return slackMs; }
+    // 与显示无关的短任务（延迟写入、网络超时）在调度器暂停时照常运行
+    void setRunWhileSuspended(bool run);
+    bool runsWhileSuspended() const { return whileSuspended; }
+
+    bool isActive() const { return active; }
+    // 距到期的毫秒数，未启动时为-1
+    qint64 remainingTime() const;
+
+public slots:
+    // 从现在起重新计时
+    void start();
+    void start(int msec);
+    void stop();
+
+signals:
+    void timeout();
+
+private:
+    friend class TaskScheduler;
+
+    const char *taskName;
+    QPointer<TaskScheduler> scheduler;
+    qint64 due = 0;  // 调度器时钟的毫秒数
+    int period = 0;
+    int slackMs;
+    bool single = false;
+    bool whileSuspended = false;
+    bool active = false;
+};
+
+#endif // TASKSCHEDULER_H
@@ -0,0 +1,88 @@
+// 淡入淡出控制器：动画对象复用，反复切换后对象数不变；中途反向时从当前透明度继续
+#include "fadecontroller.h"
+
+#include <QWidget>
+#include <QtTest>
+
+class FadeControllerTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void objectCountAfterToggles();
+    void fadeOutHidesWhenDone();
+    void fadeInContinuesFromCurrentOpacity();
+    void fadeToReversesFadeOut();
+    void fadeToKeepsHiddenWindowHidden();
+};
+
+void FadeControllerTest::objectCountAfterToggles()
+{
+    QWidget window;
+    window.resize(240, 140);
+    FadeController *fader = new FadeController(&window);
+    window.show();
+    const qsizetype objectsBefore = window.findChildren<QObject *>().size();
+    for (int i = 0; i < 10000; ++i) {
+        if (i & 1)
+            fader->fadeTo(i % 4 == 1 ? 0.6 : 0.8);
+        else
+            fader->fadeOut();
+    }
+    QCoreApplication::sendPostedEvents(nullptr, QEvent::DeferredDelete);
+    QCOMPARE(window.findChildren<QObject *>().size(), objectsBefore);
+}
+
+void FadeControllerTest::fadeOutHidesWhenDone()
+{
+    QWidget window;
+    FadeController *fader = new FadeController(&window);
+    window.show();
+    fader->fadeOut(50);
+    QVERIFY(!fader->isShown());
+    QTRY_VERIFY(!window.isVisible());
+    QVERIFY(!fader->isAnimating());
+}
+
+void FadeControllerTest::fadeInContinuesFromCurrentOpacity()
+{
+    QWidget window;
+    FadeController *fader = new FadeController(&window, 0.8);
+    window.show();
+    fader->fadeOut(1000);
+    // 动画停在一半时反向
+    window.setWindowOpacity(0.3);
+    fader->fadeIn(1000);
+    QVERIFY(qAbs(window.windowOpacity() - 0.3) < 0.01);
+    QVERIFY(fader->isShown());
+    QTRY_VERIFY(qAbs(window.windowOpacity() - 0.8) < 0.01);
+}
+
+void FadeControllerTest::fadeToReversesFadeOut()
+{
+    QWidget window;
+    FadeController *fader = new FadeController(&window);
+    window.show();
+    fader->fadeOut(1000);
+    window.setWindowOpacity(0.4);
+    // 淡出中途改变目标透明度：不跳变，也不再隐藏
+    fader->fadeTo(0.9, 1000);
+    QVERIFY(qAbs(window.windowOpacity() - 0.4) < 0.01);
+    QVERIFY(fader->isShown());
+    QVERIFY(fader->isAnimating());
+    QTRY_VERIFY(!fader->isAnimating());
+    QVERIFY(window.isVisible());
+    QVERIFY(qAbs(window.windowOpacity() - 0.9) < 0.01);
+}
+
+void FadeControllerTest::fadeToKeepsHiddenWindowHidden()
+{
+    QWidget window;
+    FadeController *fader = new FadeController(&window);
+    fader->fadeTo(0.5);
+    QVERIFY(!window.isVisible());
+    QCOMPARE(fader->visibleOpacity(), 0.5);
+}
+
+QTEST_MAIN(FadeControllerTest)
+#include "fadecontroller_test.moc"
@@ -0,0 +1,195 @@
+// 前台监视：FakeForegroundWatcher推动主窗口的自动隐藏逻辑；XCB后端需要X服务器，
+// 没有窗口管理器时由测试自己设置_NET_ACTIVE_WINDOW和_NET_WM_STATE（ctest中通过xvfb-run运行）
+#include "autohider.h"
+#include "fadecontroller.h"
+#include "foregroundwatcher.h"
+
+#include <QSignalSpy>
+#include <QWidget>
+#include <QtTest>
+
+#ifdef ONDUTY_HAVE_XCB
+#include <xcb/xcb.h>
+#include <cstdlib>
+#endif
+
+class ForegroundWatcherTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+    void fakeEmitsOnlyChanges();
+    void fullscreenHidesAndRestores();
+    void presentationHidesAndRestores();
+    void manualHideStaysHidden();
+    void examModeBlocksRestore();
+    void xcbBackend();
+
+private:
+    QWidget *window = nullptr;
+    FadeController *fader = nullptr;
+    FakeForegroundWatcher *watcher = nullptr;
+    AutoHider *hider = nullptr;
+    QSignalSpy *restores = nullptr;
+    bool examMode = false;
+};
+
+void ForegroundWatcherTest::init()
+{
+    window = new QWidget;
+    window->resize(240, 140);
+    fader = new FadeController(window);
+    watcher = new FakeForegroundWatcher(window);
+    examMode = false;
+    hider = new AutoHider(watcher, fader, [this]() { return !examMode; }, window);
+    restores = new QSignalSpy(hider, &AutoHider::aboutToShow);
+    window->show();
+}
+
+void ForegroundWatcherTest::cleanup()
+{
+    delete restores;
+    delete window;
+}
+
+void ForegroundWatcherTest::fakeEmitsOnlyChanges()
+{
+    QSignalSpy fullscreen(watcher, &ForegroundWatcher::fullscreenChanged);
+    QSignalSpy presentation(watcher, &ForegroundWatcher::presentationChanged);
+    watcher->setFullscreen(true);
+    watcher->setFullscreen(true);
+    watcher->setPresentationShowing(false);
+    QCOMPARE(fullscreen.count(), 1);
+    QCOMPARE(presentation.count(), 0);
+    QVERIFY(watcher->isFullscreen());
+}
+
+void ForegroundWatcherTest::fullscreenHidesAndRestores()
+{
+    watcher->setFullscreen(true);
+    QVERIFY(!fader->isShown());
+    QVERIFY(hider->isHiddenByFullscreen());
+    QTRY_VERIFY(!window->isVisible());
+
+    watcher->setFullscreen(false);
+    QVERIFY(fader->isShown());
+    QVERIFY(!hider->isAutoHidden());
+    QCOMPARE(restores->count(), 1);
+}
+
+void ForegroundWatcherTest::presentationHidesAndRestores()
+{
+    watcher->setPresentationShowing(true);
+    QVERIFY(!fader->isShown());
+    QVERIFY(hider->isHiddenByPresentation());
+
+    // 淡出还没结束时放映就结束了，同样恢复
+    watcher->setPresentationShowing(false);
+    QVERIFY(fader->isShown());
+    QVERIFY(!hider->isAutoHidden());
+    QCOMPARE(restores->count(), 1);
+}
+
+void ForegroundWatcherTest::manualHideStaysHidden()
+{
+    // 手动隐藏的窗口不因全屏结束而出现
+    window->hide();
+    watcher->setFullscreen(true);
+    watcher->setFullscreen(false);
+    QVERIFY(!window->isVisible());
+    QVERIFY(!hider->isAutoHidden());
+    QCOMPARE(restores->count(), 0);
+}
+
+void ForegroundWatcherTest::examModeBlocksRestore()
+{
+    // 放映或全屏期间进入考试模式，结束后不恢复
+    watcher->setPresentationShowing(true);
+    watcher->setFullscreen(true);
+    examMode = true;
+    watcher->setPresentationShowing(false);
+    watcher->setFullscreen(false);
+    QVERIFY(!fader->isShown());
+    QCOMPARE(restores->count(), 0);
+
+    // 退出考试模式时由窗口重新决定是否显示，之前的自动隐藏不再恢复
+    hider->reset();
+    examMode = false;
+    watcher->setFullscreen(true);
+    watcher->setFullscreen(false);
+    QCOMPARE(restores->count(), 0);
+}
+
+#ifdef ONDUTY_HAVE_XCB
+namespace {
+xcb_atom_t internAtom(xcb_connection_t *connection, const char *name)
+{
+    xcb_intern_atom_reply_t *reply = xcb_intern_atom_reply(connection, xcb_intern_atom(connection, 0, quint16(qstrlen(name)), name), nullptr);
+    const xcb_atom_t atom = reply ? reply->atom : xcb_atom_t(XCB_ATOM_NONE);
+    free(reply);
+    return atom;
+}
+}
+#endif
+
+void ForegroundWatcherTest::xcbBackend()
+{
+#ifndef ONDUTY_HAVE_XCB
+    QSKIP("Built without xcb");
+#else
+    if (qEnvironmentVariableIsEmpty("DISPLAY"))
+        QSKIP("DISPLAY is not set, run under xvfb-run");
+
+    XcbForegroundWatcher xcbWatcher;
+    int screenNumber = 0;
+    xcb_connection_t *connection = xcb_connect(nullptr, &screenNumber);
+    QVERIFY(xcbWatcher.isValid());
+    QVERIFY(!xcb_connection_has_error(connection));
+    xcb_screen_iterator_t it = xcb_setup_roots_iterator(xcb_get_setup(connection));
+    for (int i = 0; i < screenNumber && it.rem; ++i)
+        xcb_screen_next(&it);
+    const xcb_window_t root = it.data->root;
+    const xcb_atom_t activeWindowAtom = internAtom(connection, "_NET_ACTIVE_WINDOW");
+    const xcb_atom_t wmStateAtom = internAtom(connection, "_NET_WM_STATE");
+    const xcb_atom_t fullscreenAtom = internAtom(connection, "_NET_WM_STATE_FULLSCREEN");
+
+    // 放映软件的全屏窗口
+    const xcb_window_t presenter = xcb_generate_id(connection);
+    xcb_create_window(connection, XCB_COPY_FROM_PARENT, presenter, root, 0, 0, 64, 48, 0,
+                      XCB_WINDOW_CLASS_INPUT_OUTPUT, it.data->root_visual, 0, nullptr);
+    const char wmClass[] = "soffice\0libreoffice-impress";
+    xcb_change_property(connection, XCB_PROP_MODE_REPLACE, presenter, XCB_ATOM_WM_CLASS, XCB_ATOM_STRING, 8, sizeof(wmClass), wmClass);
+
+    auto setActiveWindow = [&](xcb_window_t active) {
+        xcb_change_property(connection, XCB_PROP_MODE_REPLACE, root, activeWindowAtom, XCB_ATOM_WINDOW, 32, 1, &active);
+        xcb_flush(connection);
+    };
+    auto setFullscreen = [&](bool fullscreen) {
+        if (fullscreen)
+            xcb_change_property(connection, XCB_PROP_MODE_REPLACE, presenter, wmStateAtom, XCB_ATOM_ATOM, 32, 1, &fullscreenAtom);
+        else
+            xcb_delete_property(connection, presenter, wmStateAtom);
+        xcb_flush(connection);
+    };
+
+    setFullscreen(true);
+    setActiveWindow(presenter);
+    QTRY_VERIFY_WITH_TIMEOUT(xcbWatcher.isFullscreen() && xcbWatcher.isPresentationShowing(), 2000);
+
+    setFullscreen(false);
+    QTRY_VERIFY_WITH_TIMEOUT(!xcbWatcher.isFullscreen() && !xcbWatcher.isPresentationShowing(), 2000);
+
+    setFullscreen(true);
+    QTRY_VERIFY_WITH_TIMEOUT(xcbWatcher.isFullscreen(), 2000);
+    setActiveWindow(XCB_WINDOW_NONE);
+    QTRY_VERIFY_WITH_TIMEOUT(!xcbWatcher.isFullscreen(), 2000);
+
+    xcb_destroy_window(connection, presenter);
+    xcb_disconnect(connection);
+#endif
+}
+
+QTEST_MAIN(ForegroundWatcherTest)
+#include "foregroundwatcher_test.moc"
@@ -0,0 +1,176 @@
+#include "timeservice.h"
+#ifdef ONDUTY_HAVE_NETWORK
+#include "ntpclient.h"
+#endif
+#include "metrics.h"
+#include "taskscheduler.h"
+#include "virtualclock.h"
+
+#include <QDebug>
+
+namespace {
+// 系统时间加偏移与锚点推算的时间相差超过这个值，说明系统时间被修改过，需要重新校时
+constexpr qint64 kMaxDivergenceMs = 5000;
+}
+
+TimeService::TimeService(QObject *parent, const Clock *clock)
+    : QObject(parent)
+    , clock(clock ? clock : Clock::system())
+{
+#ifdef ONDUTY_HAVE_NETWORK
+    ntpClient = new NtpClient(this);
+    connect(ntpClient, &NtpClient::finished, this, [this](const QDateTime &utc, const QString &) {
+        onNtpFinished(utc);
+    });
+    connect(ntpClient, &NtpClient::failed, this, &TimeService::onNtpFailed);
+#endif
+
+    // 重新校时早晚几分钟都可以，允许推迟十分之一个间隔
+    resyncTask = new ScheduledTask("resync", resyncMinutes * 60 * 1000 / 10, this);
+    connect(resyncTask, &ScheduledTask::timeout, this, []() { Metrics::increment(Metrics::ResyncWakeups); });
+    connect(resyncTask, &ScheduledTask::timeout, this, &TimeService::sync);
+#ifdef ONDUTY_HAVE_NETWORK
+    resyncTask->start(resyncMinutes * 60 * 1000);
+#endif
+}
+
+bool TimeService::usesSystemClock() const
+{
+    return clock->isSystem();
+}
+
+qint64 TimeService::currentMSecsSinceEpoch() const
+{
+    if (!syncedThisSession)
+        return clock->msecsSinceEpoch() + persistedOffsetMs;
+    // 系统时间可能被改过，同步后只信任锚点和单调时钟
+    return anchorNtpMs + (clock->nsecsElapsed() - anchorSteadyNs) / 1000000;
+}
+
+QDateTime TimeService::currentDateTime() const
+{
+    return QDateTime::fromMSecsSinceEpoch(currentMSecsSinceEpoch());
+}
+
+QDate TimeService::currentDate() const
+{
+    return currentDateTime().date();
+}
+
+qint64 TimeService::offsetMs() const
+{
+    return persistedOffsetMs;
+}
+
+qint64 TimeService::staleness() const
+{
+    if (lastSync.isValid())
+        return qMax<qint64>(0, currentMSecsSinceEpoch() - lastSync.toMSecsSinceEpoch());
+    return -1;
+}
+
+void TimeService::restoreOffset(qint64 offsetMs, const QDateTime &syncedAt)
+{
+    if (syncedThisSession || !syncedAt.isValid())
+        return;
+    persistedOffsetMs = offsetMs;
+    lastSync = syncedAt;
+}
+
+void TimeService::resyncIfDiverged()
+{
+    if (!syncedThisSession)
+        return;
+    const qint64 wallMs = clock->msecsSinceEpoch() + persistedOffsetMs;
+    const qint64 divergenceMs = wallMs - currentMSecsSinceEpoch();
+    if (qAbs(divergenceMs) <= kMaxDivergenceMs)
+        return;
+    // 不知道哪个时钟是对的：锚点不动，由校时成功后的应答重新锚定
+    qDebug() << "System clock diverged from corrected time by" << divergenceMs << "ms, resyncing";
+    sync();
+}
+
+void TimeService::setResyncInterval(int minutes)
+{
+    resyncMinutes = qMax(1, minutes);
+    resyncTask->setSlack(resyncMinutes * 60 * 1000 / 10);
+#ifdef ONDUTY_HAVE_NETWORK
+    resyncTask->start(resyncMinutes * 60 * 1000);
+#endif
+}
+
+void TimeService::requestDate(std::function<void(const QDate &)> callback)
+{
+    if (syncedThisSession || firstAttemptDone || lastSync.isValid()) {
+        callback(currentDate());
+        return;
+    }
+    pendingCallbacks.append(std::move(callback));
+    sync();
+}
+
+void TimeService::sync()
+{
+    if (!clock->isSystem()) {
+        if (!peerFollower) {
+            const QDateTime utc = QDateTime::fromMSecsSinceEpoch(clock->msecsSinceEpoch(), Qt::UTC);
+            QMetaObject::invokeMethod(this, [this, utc]() { onNtpFinished(utc); }, Qt::QueuedConnection);
+        }
+        return;
+    }
+#ifdef ONDUTY_HAVE_NETWORK
+    if (!peerFollower && !ntpClient->isRunning())
+        ntpClient->query(2000);
+#else
+    // 没有网络模块时使用系统时钟加上次保存的偏移；异步结束，与真正的校时失败一样
+    if (!peerFollower)
+        QMetaObject::invokeMethod(this, [this]() { onNtpFailed(); }, Qt::QueuedConnection);
+#endif
+}
+
+void TimeService::setPeerFollower(bool follower)
+{
+    if (peerFollower == follower)
+        return;
+    peerFollower = follower;
+    if (!peerFollower)
+        sync();
+}
+
+void TimeService::applyPeerTime(qint64 utcMs)
+{
+    if (!peerFollower)
+        return;
+    if (syncedThisSession && qAbs(currentMSecsSinceEpoch() - utcMs) < 100)
+        return;
+    onNtpFinished(QDateTime::fromMSecsSinceEpoch(utcMs).toUTC());
+}
+
+void TimeService::onNtpFinished(const QDateTime &utc)
+{
+    anchorSteadyNs = clock->nsecsElapsed();
+    anchorNtpMs = utc.toMSecsSinceEpoch();
+    syncedThisSession = true;
+    firstAttemptDone = true;
+    lastSync = utc;
+    persistedOffsetMs = anchorNtpMs - clock->msecsSinceEpoch();
+    qDebug() << "Clock offset updated:" << persistedOffsetMs << "ms";
+
+    emit synced();
+    flushPending();
+}
+
+void TimeService::onNtpFailed()
+{
+    firstAttemptDone = true;
+    emit syncFailed();
+    flushPending();
+}
+
+void TimeService::flushPending()
+{
+    const QList<std::function<void(const QDate &)>> callbacks = std::exchange(pendingCallbacks, {});
+    const QDate today = currentDate();
+    for (const auto &callback : callbacks)
+        callback(today);
+}
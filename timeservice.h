@@ -0,0 +1,87 @@
+#ifndef TIMESERVICE_H
+#define TIMESERVICE_H
+
+#include <QObject>
+#include <QDateTime>
+#include <QList>
+#include <functional>
+
+class Clock;
+class NtpClient;
+class ScheduledTask;
+
+// 时间服务：同步一次NTP后记住与单调时钟的偏移，之后的日期查询都在本地完成。
+// 精简构建中没有NTP，sync()总是失败，日期由系统时钟加上次保存的偏移得出。
+// 使用虚拟时钟（模拟器）时虚拟时间就是准确时间，sync()不联网，立即以它校时成功
+class TimeService : public QObject
+{
+    Q_OBJECT
+
+public:
+    // clock为空时使用系统时钟
+    explicit TimeService(QObject *parent = nullptr, const Clock *clock = nullptr);
+
+    NtpClient *client() const { return ntpClient; }
+    // 模拟器中为false，这时不监视系统时间的变化
+    bool usesSystemClock() const;
+
+    // 校正后的当前时间，未同步过时为系统时钟加上次保存的偏移。同步后由锚点和单调时钟推算，
+    // 修改系统时间不影响它；锚点只在校时成功后改变
+    qint64 currentMSecsSinceEpoch() const;
+    QDateTime currentDateTime() const;
+    QDate currentDate() const;
+
+    bool isSynced() const { return syncedThisSession; }
+    bool hasOffset() const { return syncedThisSession || lastSync.isValid(); }
+
+    // 同步时刻NTP时间减系统时间（毫秒），用于持久化
+    qint64 offsetMs() const;
+    QDateTime lastSyncTime() const { return lastSync; }
+    // 距上次同步的毫秒数，从未同步过返回-1
+    qint64 staleness() const;
+
+    // 从配置恢复上次的偏移，冷启动无网络时仍能得到校正后的日期
+    void restoreOffset(qint64 offsetMs, const QDateTime &syncedAt);
+
+    // 睡眠唤醒或系统时间变化后调用：系统时间加偏移与校正后的时间相差超过5秒时立即校时
+    void resyncIfDiverged();
+
+    void setResyncInterval(int minutes);
+    int resyncInterval() const { return resyncMinutes; }
+
+    // 跟随局域网内的权威节点时不做NTP校时，时间由applyPeerTime提供；退出跟随时立即校时
+    void setPeerFollower(bool follower);
+    bool isPeerFollower() const { return peerFollower; }
+    // 权威节点广播的UTC毫秒数，与当前校正后的时间相差不到100毫秒时忽略
+    void applyPeerTime(qint64 utcMs);
+
+    // 有可用偏移时立即回调，否则等第一次同步结束（失败时使用系统日期）
+    void requestDate(std::function<void(const QDate &)> callback);
+
+public slots:
+    void sync();
+
+signals:
+    void synced();
+    void syncFailed();
+
+private:
+    void onNtpFinished(const QDateTime &utc);
+    void onNtpFailed();
+    void flushPending();
+
+    NtpClient *ntpClient = nullptr;  // 精简构建（没有Network模块）时为空
+    ScheduledTask *resyncTask;
+    const Clock *clock;
+    qint64 anchorNtpMs = 0;       // 同步时的NTP时间
+    qint64 anchorSteadyNs = 0;    // 同步时的单调时钟读数（包括睡眠的时间）
+    qint64 persistedOffsetMs = 0;
+    QDateTime lastSync;
+    bool syncedThisSession = false;
+    bool firstAttemptDone = false;
+    bool peerFollower = false;
+    int resyncMinutes = 360;
+    QList<std::function<void(const QDate &)>> pendingCallbacks;
+};
+
+#endif // TIMESERVICE_H
@@ -0,0 +1,58 @@
+#include "virtualclock.h"
+
+#include <QDateTime>
+#include <QElapsedTimer>
+
+#if defined(Q_OS_LINUX) || defined(Q_OS_DARWIN)
+#include <time.h>
+#elif defined(Q_OS_WIN)
+#include <windows.h>
+#endif
+
+namespace {
+class SystemClock : public Clock
+{
+public:
+    SystemClock() { steady.start(); }
+
+    qint64 msecsSinceEpoch() const override { return QDateTime::currentMSecsSinceEpoch(); }
+    qint64 nsecsElapsed() const override
+    {
+        // QElapsedTimer在睡眠时可能停走，唤醒后校正后的时间会落后睡眠的时长；这里换成包括睡眠时间的时钟
+#if defined(Q_OS_LINUX)
+        // CLOCK_MONOTONIC在睡眠时停走，CLOCK_BOOTTIME不停
+        timespec ts;
+        if (clock_gettime(CLOCK_BOOTTIME, &ts) == 0)
+            return qint64(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+#elif defined(Q_OS_DARWIN)
+        // mach_absolute_time在睡眠时停走，CLOCK_MONOTONIC不停
+        timespec ts;
+        if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0)
+            return qint64(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+#elif defined(Q_OS_WIN)
+        // 未偏置的中断时间（QueryUnbiasedInterruptTime）不含睡眠和休眠，GetTickCount64含；
+        // 精度约15毫秒，对日期计算足够
+        return qint64(GetTickCount64()) * 1000000;
+#endif
+        return steady.nsecsElapsed();
+    }
+    bool isSystem() const override { return true; }
+
+private:
+    QElapsedTimer steady;
+};
+}
+
+const Clock *Clock::system()
+{
+    static const SystemClock clock;
+    return &clock;
+}
+
+void VirtualClock::advance(qint64 msec)
+{
+    if (msec <= 0)
+        return;
+    wallMs += msec;
+    steadyNs += msec * 1000000;
+}
@@ -0,0 +1,40 @@
+#ifndef VIRTUALCLOCK_H
+#define VIRTUALCLOCK_H
+
+#include <QtGlobal>
+
+// 读取时间的来源：系统时间和单调时钟。程序使用Clock::system()；
+// 模拟器换成VirtualClock，调度器不再启动定时器，换日、校时和延迟写入都在虚拟时间里全速运行
+class Clock
+{
+public:
+    virtual ~Clock() = default;
+
+    // 系统时间（UTC毫秒），可能被用户或校时修改
+    virtual qint64 msecsSinceEpoch() const = 0;
+    // 单调时钟的纳秒数，起点不定，只用来计算间隔；系统时钟在Linux、macOS和Windows上包括睡眠的时间
+    virtual qint64 nsecsElapsed() const = 0;
+    virtual bool isSystem() const { return false; }
+
+    static const Clock *system();
+};
+
+// 由调用者推进的时钟，系统时间和单调时钟一起走
+class VirtualClock : public Clock
+{
+public:
+    explicit VirtualClock(qint64 msecsSinceEpoch = 0) : wallMs(msecsSinceEpoch) {}
+
+    qint64 msecsSinceEpoch() const override { return wallMs; }
+    qint64 nsecsElapsed() const override { return steadyNs; }
+
+    void advance(qint64 msec);
+    // 只改系统时间（用户调整时钟），单调时钟不变
+    void setMSecsSinceEpoch(qint64 msec) { wallMs = msec; }
+
+private:
+    qint64 wallMs;
+    qint64 steadyNs = 0;
+};
+
+#endif // VIRTUALCLOCK_H
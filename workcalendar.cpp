@@ -0,0 +1,292 @@
+#include "workcalendar.h"
+
+#include <QFile>
+#include <QRegularExpression>
+#include <QStringList>
+#include <QtAlgorithms>
+#include <QDebug>
+#include <algorithm>
+
+namespace {
+struct HolidayRule {
+    int year;
+    int month;
+    int day;
+    int days;
+    bool workday;  // true为调休补班，false为放假
+};
+
+// 内置的国务院办公厅节假日安排，节假日文件可以覆盖
+constexpr HolidayRule kBuiltinRules[] = {
+    // 2025
+    { 2025, 1, 1, 1, false },   // 元旦
+    { 2025, 1, 26, 1, true },
+    { 2025, 1, 28, 8, false },  // 春节
+    { 2025, 2, 8, 1, true },
+    { 2025, 4, 4, 3, false },   // 清明节
+    { 2025, 4, 27, 1, true },
+    { 2025, 5, 1, 5, false },   // 劳动节
+    { 2025, 5, 31, 3, false },  // 端午节
+    { 2025, 9, 28, 1, true },
+    { 2025, 10, 1, 8, false },  // 国庆节、中秋节
+    { 2025, 10, 11, 1, true },
+    // 2026
+    { 2026, 1, 1, 3, false },   // 元旦
+    { 2026, 1, 4, 1, true },
+    { 2026, 2, 14, 1, true },
+    { 2026, 2, 15, 9, false },  // 春节
+    { 2026, 2, 28, 1, true },
+    { 2026, 4, 4, 3, false },   // 清明节
+    { 2026, 5, 1, 5, false },   // 劳动节
+    { 2026, 5, 9, 1, true },
+    { 2026, 6, 19, 3, false },  // 端午节
+    { 2026, 9, 20, 1, true },
+    { 2026, 9, 25, 3, false },  // 中秋节
+    { 2026, 10, 1, 7, false },  // 国庆节
+    { 2026, 10, 10, 1, true },
+};
+
+constexpr bool rulesSorted()
+{
+    for (size_t i = 1; i < sizeof(kBuiltinRules) / sizeof(kBuiltinRules[0]); ++i) {
+        const HolidayRule &a = kBuiltinRules[i - 1];
+        const HolidayRule &b = kBuiltinRules[i];
+        if (a.year * 10000 + a.month * 100 + a.day >= b.year * 10000 + b.month * 100 + b.day)
+            return false;
+    }
+    return true;
+}
+static_assert(rulesSorted(), "内置节假日表必须按日期排序");
+
+qint64 floorDiv(qint64 value, qint64 divisor)
+{
+    return value >= 0 ? value / divisor : (value - divisor + 1) / divisor;
+}
+
+// weekdayRank()的反函数：第n个周一到周五
+qint64 weekdaySelect(qint64 n)
+{
+    const qint64 weeks = floorDiv(n - 1, 5);
+    return weeks * 7 + (n - weeks * 5) - 1;
+}
+
+QDate parseDate(const QString &text)
+{
+    static const char *const formats[] = { "yyyy-MM-dd", "yyyyMMdd", "yyyy-M-d", "yyyy/M/d", "yyyy.M.d" };
+    for (const char *format : formats) {
+        const QDate date = QDate::fromString(text, QLatin1String(format));
+        if (date.isValid())
+            return date;
+    }
+    return QDate();
+}
+
+bool isWorkdayWord(const QString &word)
+{
+    return word.contains(QStringLiteral("班")) || word.compare("work", Qt::CaseInsensitive) == 0
+        || word.compare("workday", Qt::CaseInsensitive) == 0;
+}
+
+constexpr qint64 kFirstDay = 2451545;  // 2000-01-01
+constexpr qint64 kLastDay = 2488069;   // 2099-12-31
+constexpr int kDayCount = int(kLastDay - kFirstDay + 1);
+}
+
+WorkCalendar::WorkCalendar()
+{
+    reset();
+}
+
+void WorkCalendar::reset()
+{
+    bits = QVector<quint64>((kDayCount + 63) / 64, 0);
+    for (int i = 0; i < kDayCount; ++i) {
+        // 儒略日0是星期一
+        if ((kFirstDay + i) % 7 < 5)
+            bits[i >> 6] |= quint64(1) << (i & 63);
+    }
+    for (const HolidayRule &rule : kBuiltinRules)
+        setRange(QDate(rule.year, rule.month, rule.day), rule.days, rule.workday);
+    rebuildRanks();
+}
+
+bool WorkCalendar::load(const QString &filePath)
+{
+    reset();
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    const QByteArray data = file.readAll();
+    const int rules = data.contains("BEGIN:VCALENDAR") ? parseIcs(data) : parseTable(data);
+    qDebug() << "Loaded" << rules << "holiday rules from" << filePath;
+    return rules > 0;
+}
+
+int WorkCalendar::parseTable(const QByteArray &data)
+{
+    // 每行：日期[~结束日期] [天数] [休|班]，#或;之后为注释
+    static const QRegularExpression separators(QStringLiteral("[\\s,]+"));
+    int rules = 0;
+    const QStringList lines = QString::fromUtf8(data).split('\n');
+    for (QString line : lines) {
+        const int comment = line.indexOf(QRegularExpression(QStringLiteral("[#;]")));
+        if (comment >= 0)
+            line.truncate(comment);
+        const QStringList tokens = line.split(separators, Qt::SkipEmptyParts);
+        if (tokens.isEmpty())
+            continue;
+
+        const QStringList range = tokens.first().split(QRegularExpression(QStringLiteral("~|\\.\\.")));
+        const QDate first = parseDate(range.first());
+        if (!first.isValid()) {
+            qWarning() << "Ignoring holiday line:" << line;
+            continue;
+        }
+        int days = 1;
+        if (range.size() > 1) {
+            const QDate last = parseDate(range.last());
+            if (last.isValid() && last >= first)
+                days = int(first.daysTo(last)) + 1;
+        }
+        bool workday = false;
+        for (int i = 1; i < tokens.size(); ++i) {
+            bool isNumber = false;
+            const int count = tokens[i].toInt(&isNumber);
+            if (isNumber)
+                days = qMax(1, count);
+            else
+                workday = isWorkdayWord(tokens[i]);
+        }
+
+        setRange(first, days, workday);
+        ++rules;
+    }
+    rebuildRanks();
+    return rules;
+}
+
+int WorkCalendar::parseIcs(const QByteArray &data)
+{
+    // 先展开续行，再逐个读取VEVENT；DTEND不含当天，SUMMARY含“班”的是补班
+    QString text = QString::fromUtf8(data);
+    text.replace(QStringLiteral("\r\n"), QStringLiteral("\n"));
+    text.replace(QRegularExpression(QStringLiteral("\n[ \t]")), QString());
+
+    int rules = 0;
+    QDate start;
+    QDate end;
+    QString summary;
+    const QStringList lines = text.split('\n');
+    for (const QString &line : lines) {
+        const int colon = line.indexOf(':');
+        if (colon < 0)
+            continue;
+        const QString name = line.left(colon).section(';', 0, 0).toUpper();
+        const QString value = line.mid(colon + 1).trimmed();
+
+        if (name == "BEGIN" && value == "VEVENT") {
+            start = end = QDate();
+            summary.clear();
+        } else if (name == "DTSTART") {
+            start = QDate::fromString(value.left(8), "yyyyMMdd");
+        } else if (name == "DTEND") {
+            end = QDate::fromString(value.left(8), "yyyyMMdd");
+        } else if (name == "SUMMARY") {
+            summary = value;
+        } else if (name == "END" && value == "VEVENT" && start.isValid()) {
+            const int days = end.isValid() && end > start ? int(start.daysTo(end)) : 1;
+            setRange(start, days, isWorkdayWord(summary));
+            ++rules;
+        }
+    }
+    rebuildRanks();
+    return rules;
+}
+
+bool WorkCalendar::isWorkday(const QDate &date) const
+{
+    if (!date.isValid())
+        return false;
+    const qint64 day = date.toJulianDay();
+    if (day < kFirstDay || day > kLastDay)
+        return date.dayOfWeek() <= 5;
+    const qint64 i = day - kFirstDay;
+    return (bits[int(i >> 6)] >> (i & 63)) & 1;
+}
+
+qint64 WorkCalendar::rank(const QDate &date) const
+{
+    if (!date.isValid())
+        return 0;
+    const qint64 day = date.toJulianDay();
+    if (day < kFirstDay)
+        return weekdayRank(day);
+    if (day > kLastDay)
+        return endRank + weekdayRank(day) - weekdayRank(kLastDay);
+
+    const qint64 i = day - kFirstDay;
+    const int bit = int(i & 63);
+    const quint64 mask = bit == 63 ? ~quint64(0) : (quint64(2) << bit) - 1;
+    return baseRank + ranks[int(i >> 6)] + qPopulationCount(bits[int(i >> 6)] & mask);
+}
+
+QDate WorkCalendar::select(qint64 n) const
+{
+    if (n <= baseRank)
+        return QDate::fromJulianDay(weekdaySelect(n));
+    if (n > endRank)
+        return QDate::fromJulianDay(weekdaySelect(n - endRank + weekdayRank(kLastDay)));
+
+    // 二分找到所在的字，再在字内取第k个置位
+    const quint32 k = quint32(n - baseRank);
+    const int word = int(std::lower_bound(ranks.constBegin(), ranks.constEnd(), k) - ranks.constBegin()) - 1;
+    quint64 value = bits[word];
+    for (quint32 skip = k - ranks[word]; skip > 1; --skip)
+        value &= value - 1;
+    return QDate::fromJulianDay(kFirstDay + qint64(word) * 64 + qCountTrailingZeroBits(value));
+}
+
+QDate WorkCalendar::firstDate()
+{
+    return QDate::fromJulianDay(kFirstDay);
+}
+
+QDate WorkCalendar::lastDate()
+{
+    return QDate::fromJulianDay(kLastDay);
+}
+
+qint64 WorkCalendar::weekdayRank(qint64 julianDay)
+{
+    // 儒略日0是星期一，每7天有5个工作日
+    const qint64 days = julianDay + 1;
+    const qint64 weeks = floorDiv(days, 7);
+    return weeks * 5 + qMin<qint64>(days - weeks * 7, 5);
+}
+
+void WorkCalendar::setRange(const QDate &first, int days, bool workday)
+{
+    for (qint64 day = first.toJulianDay(); days > 0; ++day, --days) {
+        if (day < kFirstDay || day > kLastDay)
+            continue;
+        const qint64 i = day - kFirstDay;
+        if (workday)
+            bits[int(i >> 6)] |= quint64(1) << (i & 63);
+        else
+            bits[int(i >> 6)] &= ~(quint64(1) << (i & 63));
+    }
+}
+
+void WorkCalendar::rebuildRanks()
+{
+    ranks.resize(bits.size());
+    quint32 count = 0;
+    for (int i = 0; i < bits.size(); ++i) {
+        ranks[i] = count;
+        count += qPopulationCount(bits[i]);
+    }
+    baseRank = weekdayRank(kFirstDay - 1);
+    endRank = baseRank + count;
+}
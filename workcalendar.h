@@ -0,0 +1,51 @@
+#ifndef WORKCALENDAR_H
+#define WORKCALENDAR_H
+
+#include <QByteArray>
+#include <QDate>
+#include <QVector>
+
+// 工作日日历：2000-2099年每天一位，周一到周五为工作日，再叠加法定节假日和调休补班。
+// 每64天一个字附带前缀计数，“是否工作日”和“两天之间有几个工作日”都是O(1)。
+// 范围之外按周一到周五计算，计数保持连续
+class WorkCalendar
+{
+public:
+    WorkCalendar();
+
+    // 恢复为周一到周五加内置节假日表
+    void reset();
+
+    // 读取节假日文件（ICS日历或简单表格），在内置表之上覆盖；返回是否读到了规则
+    bool load(const QString &filePath);
+    // 以下两个函数只添加规则，不会先reset()
+    int parseTable(const QByteArray &data);
+    int parseIcs(const QByteArray &data);
+
+    bool isWorkday(const QDate &date) const;
+    // 从儒略日0到date（含）的工作日数
+    qint64 rank(const QDate &date) const;
+    // (from, to]之间的工作日数，to在from之前时为负
+    qint64 workdaysBetween(const QDate &from, const QDate &to) const { return rank(to) - rank(from); }
+    // rank()等于n的那个工作日
+    QDate select(qint64 n) const;
+    // date之后的第一个工作日
+    QDate nextWorkday(const QDate &date) const { return select(rank(date) + 1); }
+
+    static QDate firstDate();
+    static QDate lastDate();
+
+    // 只按周一到周五计算的rank()
+    static qint64 weekdayRank(qint64 julianDay);
+
+private:
+    void setRange(const QDate &first, int days, bool workday);
+    void rebuildRanks();
+
+    QVector<quint64> bits;   // 第i位对应firstDate()之后第i天
+    QVector<quint32> ranks;  // 每个字之前的工作日数
+    qint64 baseRank = 0;     // firstDate()之前的工作日数
+    qint64 endRank = 0;      // lastDate()（含）之前的工作日数
+};
+
+#endif // WORKCALENDAR_H